@@ -0,0 +1,27 @@
+set_extra_dirs_lib(SQLITE3 sqlite3)
+find_library(SQLITE3_LIBRARY
+  NAMES "sqlite3" "sqlite3-0"
+  HINTS ${HINTS_SQLITE3_LIBDIR}
+  PATHS ${PATHS_SQLITE3_LIBDIR}
+  ${CROSSCOMPILING_NO_CMAKE_SYSTEM_PATH}
+)
+set_extra_dirs_include(SQLITE3 sqlite3 "${SQLITE3_LIBRARY}")
+find_path(SQLITE3_INCLUDEDIR
+  NAMES "sqlite3.h"
+  HINTS ${HINTS_SQLITE3_INCLUDEDIR}
+  PATHS ${PATHS_SQLITE3_INCLUDEDIR}
+  ${CROSSCOMPILING_NO_CMAKE_SYSTEM_PATH}
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(SQLite3 DEFAULT_MSG SQLITE3_LIBRARY SQLITE3_INCLUDEDIR)
+
+mark_as_advanced(SQLITE3_LIBRARY SQLITE3_INCLUDEDIR)
+
+if(SQLITE3_FOUND)
+  set(SQLITE3_LIBRARIES ${SQLITE3_LIBRARY})
+  set(SQLITE3_INCLUDE_DIRS ${SQLITE3_INCLUDEDIR})
+else()
+  set(SQLITE3_LIBRARIES)
+  set(SQLITE3_INCLUDE_DIRS)
+endif()
@@ -1401,10 +1401,49 @@ NETSOCKET net_udp_create(NETADDR bindaddr)
 	return sock;
 }
 
+#if defined(CONF_PLATFORM_LINUX)
+static int priv_net_udp_queue(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
+{
+	NETSENDQUEUE *q = sock.sendqueue;
+	int i;
+	if(q->size == VLEN)
+		net_udp_flush(sock);
+
+	i = q->size++;
+	mem_copy(q->bufs[i], data, size);
+	q->iovecs[i].iov_len = size;
+	q->ipv6[i] = addr->type == NETTYPE_IPV6;
+	if(q->ipv6[i])
+	{
+		netaddr_to_sockaddr_in6(addr, (struct sockaddr_in6 *)&q->sockaddrs[i]);
+		q->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in6);
+	}
+	else
+	{
+		netaddr_to_sockaddr_in(addr, (struct sockaddr_in *)&q->sockaddrs[i]);
+		q->msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	}
+
+	network_stats.sent_bytes += size;
+	network_stats.sent_packets++;
+	return size;
+}
+#endif
+
 int net_udp_send(NETSOCKET sock, const NETADDR *addr, const void *data, int size)
 {
 	int d = -1;
 
+#if defined(CONF_PLATFORM_LINUX)
+	if(sock.sendqueue)
+	{
+		/* plain unicast gets queued, the rest is sent right away after what is queued before it */
+		if(size <= PACKETSIZE && ((addr->type == NETTYPE_IPV4 && sock.ipv4sock >= 0) || (addr->type == NETTYPE_IPV6 && sock.ipv6sock >= 0)))
+			return priv_net_udp_queue(sock, addr, data, size);
+		net_udp_flush(sock);
+	}
+#endif
+
 	if(addr->type & NETTYPE_IPV4)
 	{
 		if(sock.ipv4sock >= 0)
@@ -1490,6 +1529,60 @@ void net_init_mmsgs(MMSGS *m)
 #endif
 }
 
+void net_udp_set_send_queue(NETSOCKET *sock, NETSENDQUEUE *queue)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	int i;
+	queue->size = 0;
+	mem_zero(queue->msgs, sizeof(queue->msgs));
+	for(i = 0; i < VLEN; ++i)
+	{
+		queue->iovecs[i].iov_base = queue->bufs[i];
+		queue->msgs[i].msg_hdr.msg_iov = &(queue->iovecs[i]);
+		queue->msgs[i].msg_hdr.msg_iovlen = 1;
+		queue->msgs[i].msg_hdr.msg_name = &(queue->sockaddrs[i]);
+	}
+	sock->sendqueue = queue;
+#endif
+}
+
+int net_udp_flush(NETSOCKET sock)
+{
+#if defined(CONF_PLATFORM_LINUX)
+	NETSENDQUEUE *q = sock.sendqueue;
+	int start = 0;
+	int sent = 0;
+	if(!q)
+		return 0;
+
+	while(start < q->size)
+	{
+		/* one call for each run of packets going out the same socket */
+		int end = start + 1;
+		int fd;
+		while(end < q->size && q->ipv6[end] == q->ipv6[start])
+			end++;
+		fd = q->ipv6[start] ? sock.ipv6sock : sock.ipv4sock;
+
+		while(start < end)
+		{
+			int n = sendmmsg(fd, &q->msgs[start], end - start, 0);
+			if(n > 0)
+			{
+				sent += n;
+				start += n;
+			}
+			else
+				start++; /* the first one failed, it is lost like with a failed sendto */
+		}
+	}
+	q->size = 0;
+	return sent;
+#else
+	return 0;
+#endif
+}
+
 int net_udp_recv(NETSOCKET sock, NETADDR *addr, void *buffer, int maxsize, MMSGS *m, unsigned char **data)
 {
 	char sockaddrbuf[128];
@@ -665,12 +665,15 @@ int time_season(void);
 int64 time_get_microseconds(void);
 
 /* Group: Network General */
+typedef struct NETSENDQUEUE NETSENDQUEUE;
+
 typedef struct
 {
 	int type;
 	int ipv4sock;
 	int ipv6sock;
 	int web_ipv4sock;
+	NETSENDQUEUE *sendqueue;
 } NETSOCKET;
 
 enum
@@ -827,6 +830,45 @@ typedef struct
 
 void net_init_mmsgs(MMSGS *m);
 
+struct NETSENDQUEUE
+{
+#ifdef CONF_PLATFORM_LINUX
+	int size;
+	int ipv6[VLEN];
+	struct mmsghdr msgs[VLEN];
+	struct iovec iovecs[VLEN];
+	char bufs[VLEN][PACKETSIZE];
+	struct sockaddr_storage sockaddrs[VLEN];
+#else
+	int dummy;
+#endif
+};
+
+/*
+	Function: net_udp_set_send_queue
+		Makes net_udp_send collect the packets of a socket until
+		net_udp_flush sends them with as few system calls as possible.
+		Copies of the socket made afterwards share the queue. Does
+		nothing on platforms without sendmmsg.
+
+	Parameters:
+		sock - Socket to queue the packets of.
+		queue - Queue to use, has to stay around as long as the socket.
+*/
+void net_udp_set_send_queue(NETSOCKET *sock, NETSENDQUEUE *queue);
+
+/*
+	Function: net_udp_flush
+		Sends the packets queued for a socket.
+
+	Parameters:
+		sock - Socket to use.
+
+	Returns:
+		The number of packets sent.
+*/
+int net_udp_flush(NETSOCKET sock);
+
 /*
 	Function: net_udp_recv
 		Receives a packet over an UDP socket.
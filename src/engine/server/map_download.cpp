@@ -0,0 +1,100 @@
+#include "map_download.h"
+
+#include <base/math.h>
+
+void CMapDownloadWindow::Reset(int Initial, int Max, int64 Now, int64 Freq)
+{
+	m_Size = maximum(Initial, 0);
+	m_Max = Max;
+	m_Fixed = Max <= Initial;
+	m_SlowStart = true;
+	m_Acks = 0;
+
+	m_Freq = Freq;
+	m_Rtt = 0;
+	m_MinRtt = 0;
+	m_LastCut = Now;
+
+	m_TimedChunk = -1;
+	m_TimedSend = 0;
+}
+
+void CMapDownloadWindow::OnSend(int Chunk, int64 Now)
+{
+	if(m_TimedChunk < 0)
+	{
+		m_TimedChunk = Chunk;
+		m_TimedSend = Now;
+	}
+}
+
+void CMapDownloadWindow::OnRequest(int Chunk, int64 Now)
+{
+	if(m_TimedChunk >= 0 && Chunk > m_TimedChunk)
+	{
+		const int64 Sample = Now - m_TimedSend;
+		m_MinRtt = m_MinRtt ? minimum(m_MinRtt, Sample) : Sample;
+		m_Rtt = m_Rtt ? (m_Rtt * 7 + Sample) / 8 : Sample;
+		m_TimedChunk = -1;
+	}
+
+	if(m_Fixed)
+		return;
+
+	// chunks wait in a queue somewhere, a few ms of jitter don't count
+	if(m_Rtt > m_MinRtt * 2 + m_Freq / 100)
+		Cut(Now, m_Size * 3 / 4);
+	else if(m_SlowStart)
+		m_Size++;
+	else if(++m_Acks >= m_Size)
+	{
+		m_Acks = 0;
+		m_Size++;
+	}
+	m_Size = minimum(m_Size, m_Max);
+}
+
+void CMapDownloadWindow::OnLoss(int64 Now)
+{
+	if(!m_Fixed)
+		Cut(Now, m_Size / 2);
+}
+
+void CMapDownloadWindow::Cut(int64 Now, int Size)
+{
+	// the requests that come in during the next round trip were sent with the old window
+	if(Now - m_LastCut < m_Rtt)
+		return;
+	m_LastCut = Now;
+	m_SlowStart = false;
+	m_Acks = 0;
+	m_Size = minimum(m_Size, maximum((int)MIN_SIZE, Size));
+}
+
+void CMapDownload::OnRequest(int Chunk, int NumChunks, bool Fast, int Window, int WindowMax, int64 Now, int64 Freq, const std::function<void(int Chunk)> &Send)
+{
+	if(Chunk != m_NextChunk || !Fast)
+	{
+		// asked again, the chunk got lost
+		if(Chunk < m_NextChunk)
+			m_Window.OnLoss(Now);
+		Send(Chunk);
+		return;
+	}
+
+	if(Chunk == 0)
+	{
+		m_Window.Reset(Window, WindowMax, Now, Freq);
+		m_ChunksSent = 0;
+	}
+	else
+		m_Window.OnRequest(Chunk, Now);
+	m_NextChunk++;
+
+	// keep the window full, the chunks past the end get dropped
+	while(m_ChunksSent < m_NextChunk + m_Window.Size() && m_ChunksSent < NumChunks)
+	{
+		m_Window.OnSend(m_ChunksSent, Now);
+		Send(m_ChunksSent++);
+	}
+}
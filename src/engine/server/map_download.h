@@ -0,0 +1,75 @@
+#ifndef ENGINE_SERVER_MAP_DOWNLOAD_H
+#define ENGINE_SERVER_MAP_DOWNLOAD_H
+
+#include <base/system.h>
+
+#include <functional>
+
+/*
+	Send-ahead window of a map download. The client asks for every chunk after
+	it got the one before, so the time from sending a chunk to the request for
+	the next one is a round trip. The window grows while round trips stay close
+	to the fastest one seen and shrinks when they get longer, which means the
+	chunks queue up somewhere, or when the client has to ask for a chunk again.
+*/
+class CMapDownloadWindow
+{
+public:
+	enum
+	{
+		MIN_SIZE = 2,
+	};
+
+	// a fixed window if Max isn't larger than Initial
+	void Reset(int Initial, int Max, int64 Now, int64 Freq);
+
+	int Size() const { return m_Size; }
+	int64 Rtt() const { return m_Rtt; }
+
+	void OnSend(int Chunk, int64 Now);
+	// the client asked for Chunk, so it got the one before
+	void OnRequest(int Chunk, int64 Now);
+	// the client asked for a chunk out of order, it didn't arrive
+	void OnLoss(int64 Now);
+
+private:
+	int m_Size;
+	int m_Max;
+	bool m_Fixed;
+	bool m_SlowStart;
+	int m_Acks;
+
+	int64 m_Freq;
+	int64 m_Rtt;
+	int64 m_MinRtt;
+	int64 m_LastCut;
+
+	// one chunk at a time is timed
+	int m_TimedChunk;
+	int64 m_TimedSend;
+
+	void Cut(int64 Now, int Size);
+};
+
+// map download of one client
+class CMapDownload
+{
+public:
+	// the chunk the client asks for next
+	int m_NextChunk;
+	// chunks sent so far by the 0.6 fast download
+	int m_ChunksSent;
+	CMapDownloadWindow m_Window;
+
+	void Reset()
+	{
+		m_NextChunk = 0;
+		m_ChunksSent = 0;
+	}
+
+	// A 0.6 client asked for Chunk. With fast download, the request for the next chunk keeps the
+	// window full, any other request only sends the chunk asked for. Send is called for every chunk.
+	void OnRequest(int Chunk, int NumChunks, bool Fast, int Window, int WindowMax, int64 Now, int64 Freq, const std::function<void(int Chunk)> &Send);
+};
+
+#endif
@@ -37,6 +37,7 @@
 #include <vector>
 #include <zlib.h>
 #include "register.h"
+#include "sql_connect_pool.h"
 
 #if defined(CONF_FAMILY_WINDOWS)
 #define WIN32_LEAN_AND_MEAN
@@ -218,7 +219,7 @@ void CServer::CClient::Reset()
 	m_LastInputTick = -1;
 	m_SnapRate = CClient::SNAPRATE_INIT;
 	m_Score = 0;
-	m_NextMapChunk = 0;
+	m_MapDownload.Reset();
 	m_Flags = 0;
 	m_DDNetVersion = VERSION_NONE;
 	m_GotDDNetVersionPacket = false;
@@ -267,11 +268,8 @@ CServer::CServer() :
 
 CServer::~CServer()
 {
-	for(auto &pCurrentMapData : m_apCurrentMapData)
-	{
-		if(pCurrentMapData)
-			free(pCurrentMapData);
-	}
+	for(int i = 0; i < 2; i++)
+		FreeMapFile(i);
 }
 
 bool CServer::IsClientNameAvailable(int ClientID, const char *pNameRequest)
@@ -763,20 +761,33 @@ int CServer::SendMsg(CMsgPacker *pMsg, int Flags, int ClientID)
 		if(RepackMsg(pMsg, Pack, m_aClients[ClientID].m_Sixup))
 			return -1;
 
-		Packet.m_ClientID = ClientID;
-		Packet.m_pData = Pack.Data();
-		Packet.m_DataSize = Pack.Size();
+		return SendPackedMsg(Pack.Data(), Pack.Size(), Flags, ClientID);
+	}
 
-		if(!(Flags & MSGFLAG_NORECORD))
-		{
-			m_aDemoRecorder[ClientID].RecordMessage(Pack.Data(), Pack.Size());
-			m_aDemoRecorder[MAX_CLIENTS].RecordMessage(Pack.Data(), Pack.Size());
-		}
+	return 0;
+}
 
-		if(!(Flags & MSGFLAG_NOSEND))
-			m_NetServer.Send(&Packet);
+int CServer::SendPackedMsg(const void *pData, int Size, int Flags, int ClientID)
+{
+	CNetChunk Packet;
+	mem_zero(&Packet, sizeof(CNetChunk));
+	if(Flags & MSGFLAG_VITAL)
+		Packet.m_Flags |= NETSENDFLAG_VITAL;
+	if(Flags & MSGFLAG_FLUSH)
+		Packet.m_Flags |= NETSENDFLAG_FLUSH;
+	Packet.m_ClientID = ClientID;
+	Packet.m_pData = pData;
+	Packet.m_DataSize = Size;
+
+	if(!(Flags & MSGFLAG_NORECORD))
+	{
+		m_aDemoRecorder[ClientID].RecordMessage(pData, Size);
+		m_aDemoRecorder[MAX_CLIENTS].RecordMessage(pData, Size);
 	}
 
+	if(!(Flags & MSGFLAG_NOSEND))
+		m_NetServer.Send(&Packet);
+
 	return 0;
 }
 
@@ -818,7 +829,9 @@ void CServer::DoSnapshot()
 		m_aDemoRecorder[MAX_CLIENTS].RecordSnapshot(Tick(), aData, SnapshotSize);
 	}
 
-	// create snapshots for all clients
+	// the game fills the snapshots one client after another, everything after that runs on the snapshot workers
+	int aSnapClients[MAX_CLIENTS];
+	int NumSnapClients = 0;
 	for(int i = 0; i < MAX_CLIENTS; i++)
 	{
 		// client must be ingame to receive snapshots
@@ -833,111 +846,165 @@ void CServer::DoSnapshot()
 		if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_INIT && (Tick() % 10) != 0)
 			continue;
 
-		{
-			char aData[CSnapshot::MAX_SIZE];
-			CSnapshot *pData = (CSnapshot *)aData; // Fix compiler warning for strict-aliasing
-			char aDeltaData[CSnapshot::MAX_SIZE];
-			char aCompData[CSnapshot::MAX_SIZE];
-			int SnapshotSize;
-			int Crc;
-			static CSnapshot s_EmptySnap;
-			CSnapshot *pDeltashot = &s_EmptySnap;
-			int DeltashotSize;
-			int DeltaTick = -1;
-			int DeltaSize;
+		char aData[CSnapshot::MAX_SIZE];
+		m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
 
-			m_SnapshotBuilder.Init(m_aClients[i].m_Sixup);
+		GameServer()->OnSnap(i);
 
-			GameServer()->OnSnap(i);
+		// finish snapshot
+		const int SnapshotSize = m_SnapshotBuilder.Finish(aData);
 
-			// finish snapshot
-			SnapshotSize = m_SnapshotBuilder.Finish(pData);
+		if(m_aDemoRecorder[i].IsRecording())
+		{
+			// write snapshot
+			m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
+		}
 
-			if(m_aDemoRecorder[i].IsRecording())
-			{
-				// write snapshot
-				m_aDemoRecorder[i].RecordSnapshot(Tick(), aData, SnapshotSize);
-			}
+		// only grows, so there is no allocation once every client had its biggest snapshot
+		m_aSnapJobs[i].m_vSnapshot.assign(aData, aData + SnapshotSize);
+		aSnapClients[NumSnapClients++] = i;
+	}
 
-			Crc = pData->Crc();
+	// one delta per protocol, so the workers don't have to switch the static sizes
+	m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, false);
+	m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, false);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, true);
+	m_SnapshotDeltaSixup.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, true);
+	m_SnapshotWorkers.Run(NumSnapClients, [this, &aSnapClients](int Job) { PrepareSnapshotDelta(aSnapClients[Job]); });
 
-			// remove old snapshos
-			// keep 3 seconds worth of snapshots
-			m_aClients[i].m_Snapshots.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
+	// Clients with the same snapshot and the same delta base get the same packets, e.g. spectators
+	// following one player. The crc is only a sum of the data, so equal ones still get compared.
+	int aDeltaClients[MAX_CLIENTS];
+	int NumDeltaClients = 0;
+	for(int j = 0; j < NumSnapClients; j++)
+	{
+		CSnapJob &Job = m_aSnapJobs[aSnapClients[j]];
+		Job.m_Source = aSnapClients[j];
+		for(int k = 0; k < NumDeltaClients; k++)
+		{
+			const CSnapJob &Other = m_aSnapJobs[aDeltaClients[k]];
+			if(Other.m_Crc == Job.m_Crc && Other.m_vSnapshot.size() == Job.m_vSnapshot.size() &&
+				Other.m_DeltashotSize == Job.m_DeltashotSize && Other.m_DeltashotCrc == Job.m_DeltashotCrc &&
+				Other.m_DeltaTick == Job.m_DeltaTick && m_aClients[aDeltaClients[k]].m_Sixup == m_aClients[aSnapClients[j]].m_Sixup &&
+				mem_comp(Other.m_vSnapshot.data(), Job.m_vSnapshot.data(), Job.m_vSnapshot.size()) == 0 &&
+				mem_comp(Other.m_pDeltashot, Job.m_pDeltashot, Job.m_DeltashotSize) == 0)
+			{
+				Job.m_Source = aDeltaClients[k];
+				break;
+			}
+		}
+		if(Job.m_Source == aSnapClients[j])
+			aDeltaClients[NumDeltaClients++] = aSnapClients[j];
+	}
+	m_SnapshotWorkers.Run(NumDeltaClients, [this, &aDeltaClients](int Job) { DoSnapshotDelta(aDeltaClients[Job]); });
 
-			// save it the snapshot
-			m_aClients[i].m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
+	// send in client order, like before the work was split up
+	for(int j = 0; j < NumSnapClients; j++)
+	{
+		const int i = aSnapClients[j];
+		const CSnapJob &Job = m_aSnapJobs[m_aSnapJobs[i].m_Source];
 
-			// find snapshot that we can perform delta against
-			s_EmptySnap.Clear();
+		if(!Job.m_vCompressed.empty())
+		{
+			const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
+			const int SnapshotSize = Job.m_vCompressed.size();
+			const int NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
 
+			for(int n = 0, Left = SnapshotSize; Left > 0; n++)
 			{
-				DeltashotSize = m_aClients[i].m_Snapshots.Get(m_aClients[i].m_LastAckedSnapshot, 0, &pDeltashot, 0);
-				if(DeltashotSize >= 0)
-					DeltaTick = m_aClients[i].m_LastAckedSnapshot;
+				int Chunk = Left < MaxSize ? Left : MaxSize;
+				Left -= Chunk;
+
+				if(NumPackets == 1)
+				{
+					CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
+					const int aHeader[] = {m_CurrentGameTick, m_CurrentGameTick - Job.m_DeltaTick, Job.m_Crc, Chunk};
+					Msg.AddInts(aHeader, sizeof(aHeader) / sizeof(aHeader[0]));
+					Msg.AddRaw(&Job.m_vCompressed[n * MaxSize], Chunk);
+					SendMsg(&Msg, MSGFLAG_FLUSH, i);
+				}
 				else
 				{
-					// no acked package found, force client to recover rate
-					if(m_aClients[i].m_SnapRate == CClient::SNAPRATE_FULL)
-						m_aClients[i].m_SnapRate = CClient::SNAPRATE_RECOVER;
+					CMsgPacker Msg(NETMSG_SNAP, true);
+					const int aHeader[] = {m_CurrentGameTick, m_CurrentGameTick - Job.m_DeltaTick, NumPackets, n, Job.m_Crc, Chunk};
+					Msg.AddInts(aHeader, sizeof(aHeader) / sizeof(aHeader[0]));
+					Msg.AddRaw(&Job.m_vCompressed[n * MaxSize], Chunk);
+					SendMsg(&Msg, MSGFLAG_FLUSH, i);
 				}
 			}
+		}
+		else
+		{
+			CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
+			Msg.AddInt(m_CurrentGameTick);
+			Msg.AddInt(m_CurrentGameTick - Job.m_DeltaTick);
+			SendMsg(&Msg, MSGFLAG_FLUSH, i);
+		}
+	}
 
-			// create delta
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_SOUNDWORLD, m_aClients[i].m_Sixup);
-			m_SnapshotDelta.SetStaticsize(protocol7::NETEVENTTYPE_DAMAGE, m_aClients[i].m_Sixup);
-			DeltaSize = m_SnapshotDelta.CreateDelta(pDeltashot, pData, aDeltaData);
+	GameServer()->OnPostSnap();
+}
 
-			if(DeltaSize)
-			{
-				// compress it
-				int SnapshotSize;
-				const int MaxSize = MAX_SNAPSHOT_PACKSIZE;
-				int NumPackets;
+// these run on the snapshot workers and only touch the client's own snapshot storage and job
+void CServer::PrepareSnapshotDelta(int ClientID)
+{
+	static CSnapshot s_EmptySnap; // zero initialized, so it has no items
 
-				SnapshotSize = CVariableInt::Compress(aDeltaData, DeltaSize, aCompData, sizeof(aCompData));
-				NumPackets = (SnapshotSize + MaxSize - 1) / MaxSize;
+	CClient &Client = m_aClients[ClientID];
+	CSnapJob &Job = m_aSnapJobs[ClientID];
+	CSnapshot *pData = (CSnapshot *)Job.m_vSnapshot.data();
+	const int SnapshotSize = Job.m_vSnapshot.size();
+	CSnapshot *pDeltashot = &s_EmptySnap;
 
-				for(int n = 0, Left = SnapshotSize; Left > 0; n++)
-				{
-					int Chunk = Left < MaxSize ? Left : MaxSize;
-					Left -= Chunk;
+	Job.m_Crc = pData->Crc();
+	Job.m_DeltaTick = -1;
+	Job.m_DeltashotSize = 0;
 
-					if(NumPackets == 1)
-					{
-						CMsgPacker Msg(NETMSG_SNAPSINGLE, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-					else
-					{
-						CMsgPacker Msg(NETMSG_SNAP, true);
-						Msg.AddInt(m_CurrentGameTick);
-						Msg.AddInt(m_CurrentGameTick - DeltaTick);
-						Msg.AddInt(NumPackets);
-						Msg.AddInt(n);
-						Msg.AddInt(Crc);
-						Msg.AddInt(Chunk);
-						Msg.AddRaw(&aCompData[n * MaxSize], Chunk);
-						SendMsg(&Msg, MSGFLAG_FLUSH, i);
-					}
-				}
-			}
-			else
-			{
-				CMsgPacker Msg(NETMSG_SNAPEMPTY, true);
-				Msg.AddInt(m_CurrentGameTick);
-				Msg.AddInt(m_CurrentGameTick - DeltaTick);
-				SendMsg(&Msg, MSGFLAG_FLUSH, i);
-			}
-		}
+	// remove old snapshos
+	// keep 3 seconds worth of snapshots
+	Client.m_Snapshots.PurgeUntil(m_CurrentGameTick - SERVER_TICK_SPEED * 3);
+
+	// save it the snapshot
+	Client.m_Snapshots.Add(m_CurrentGameTick, time_get(), SnapshotSize, pData, 0);
+
+	// find snapshot that we can perform delta against
+	const int DeltashotSize = Client.m_Snapshots.Get(Client.m_LastAckedSnapshot, 0, &pDeltashot, 0);
+	if(DeltashotSize >= 0)
+	{
+		Job.m_DeltaTick = Client.m_LastAckedSnapshot;
+		Job.m_DeltashotSize = DeltashotSize;
 	}
+	else
+	{
+		pDeltashot = &s_EmptySnap;
+		// no acked package found, force client to recover rate
+		if(Client.m_SnapRate == CClient::SNAPRATE_FULL)
+			Client.m_SnapRate = CClient::SNAPRATE_RECOVER;
+	}
+	Job.m_pDeltashot = pDeltashot;
+	Job.m_DeltashotCrc = pDeltashot->Crc();
+}
 
-	GameServer()->OnPostSnap();
+void CServer::DoSnapshotDelta(int ClientID)
+{
+	// scratch space of the worker thread
+	static thread_local char s_aDeltaData[CSnapshot::MAX_SIZE];
+	static thread_local char s_aCompData[CSnapshot::MAX_SIZE];
+
+	CSnapJob &Job = m_aSnapJobs[ClientID];
+	CSnapshot *pData = (CSnapshot *)Job.m_vSnapshot.data();
+
+	// create delta, the event sizes differ between the protocols
+	CSnapshotDelta &Delta = m_aClients[ClientID].m_Sixup ? m_SnapshotDeltaSixup : m_SnapshotDelta;
+	const int DeltaSize = Delta.CreateDelta(Job.m_pDeltashot, pData, s_aDeltaData);
+
+	// compress it
+	Job.m_vCompressed.clear();
+	if(DeltaSize)
+	{
+		const int CompSize = CVariableInt::Compress(s_aDeltaData, DeltaSize, s_aCompData, sizeof(s_aCompData));
+		Job.m_vCompressed.assign(s_aCompData, s_aCompData + CompSize);
+	}
 }
 
 int CServer::ClientRejoinCallback(int ClientID, void *pUser)
@@ -1070,6 +1137,8 @@ int CServer::DelClientCallback(int ClientID, const char *pReason, void *pUser)
 		pThis->GameServer()->OnClientDrop(ClientID, pReason);
 
 	pThis->m_aClients[ClientID].m_State = CClient::STATE_EMPTY;
+	// a client dropped during a map change must not hand its data to the next one in the slot
+	pThis->m_aClients[ClientID].m_HasPersistentData = false;
 	pThis->m_aClients[ClientID].m_SupportsMapSha256 = false;
 	pThis->m_aClients[ClientID].m_aName[0] = 0;
 	pThis->m_aClients[ClientID].m_aClan[0] = 0;
@@ -1141,45 +1210,84 @@ void CServer::SendMap(int ClientID)
 		SendMsg(&Msg, MSGFLAG_VITAL | MSGFLAG_FLUSH, ClientID);
 	}
 
-	m_aClients[ClientID].m_NextMapChunk = 0;
+	m_aClients[ClientID].m_MapDownload.Reset();
 }
 
 void CServer::SendMapData(int ClientID, int Chunk)
 {
 	int Sixup = IsSixup(ClientID);
-	unsigned int ChunkSize = 1024 - 128;
-	unsigned int Offset = Chunk * ChunkSize;
-	int Last = 0;
 
 	// drop faulty map data requests
-	if(Chunk < 0 || Offset > m_aCurrentMapSize[Sixup])
+	const std::vector<int> &vOffsets = m_avMapChunkOffsets[Sixup];
+	if(Chunk < 0 || Chunk + 1 >= (int)vOffsets.size())
 		return;
 
-	if(Offset + ChunkSize >= m_aCurrentMapSize[Sixup])
-	{
-		ChunkSize = m_aCurrentMapSize[Sixup] - Offset;
-		Last = 1;
-	}
-
-	CMsgPacker Msg(NETMSG_MAP_DATA, true);
-	if(!Sixup)
-	{
-		Msg.AddInt(Last);
-		Msg.AddInt(m_aCurrentMapCrc[SIX]);
-		Msg.AddInt(Chunk);
-		Msg.AddInt(ChunkSize);
-	}
-	Msg.AddRaw(&m_apCurrentMapData[Sixup][Offset], ChunkSize);
-	SendMsg(&Msg, MSGFLAG_VITAL | MSGFLAG_FLUSH, ClientID);
+	const int Size = vOffsets[Chunk + 1] - vOffsets[Chunk];
+	SendPackedMsg(&m_avMapChunkMsgs[Sixup][vOffsets[Chunk]], Size, MSGFLAG_VITAL | MSGFLAG_FLUSH, ClientID);
 
 	if(g_Config.m_Debug)
 	{
 		char aBuf[256];
-		str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, ChunkSize);
+		str_format(aBuf, sizeof(aBuf), "sending chunk %d with size %d", Chunk, Size);
 		Console()->Print(IConsole::OUTPUT_LEVEL_DEBUG, "server", aBuf);
 	}
 }
 
+void CServer::LoadMapFile(int Version, IOHANDLE File)
+{
+	// a private copy, the file may be replaced while the map is running
+	FreeMapFile(Version);
+	m_aCurrentMapSize[Version] = (unsigned int)io_length(File);
+	m_apCurrentMapData[Version] = (unsigned char *)malloc(m_aCurrentMapSize[Version]);
+	io_read(File, m_apCurrentMapData[Version], m_aCurrentMapSize[Version]);
+}
+
+void CServer::FreeMapFile(int Version)
+{
+	free(m_apCurrentMapData[Version]);
+	m_apCurrentMapData[Version] = 0;
+	m_aCurrentMapSize[Version] = 0;
+	m_avMapChunkMsgs[Version].clear();
+	m_avMapChunkOffsets[Version].clear();
+}
+
+void CServer::PackMapChunks(int Version)
+{
+	// every download sends the same messages, so they are packed once here
+	const unsigned int MaxChunkSize = 1024 - 128;
+	std::vector<unsigned char> &vMsgs = m_avMapChunkMsgs[Version];
+	std::vector<int> &vOffsets = m_avMapChunkOffsets[Version];
+	vMsgs.clear();
+	vOffsets.clear();
+	vMsgs.reserve(m_aCurrentMapSize[Version] + (m_aCurrentMapSize[Version] / MaxChunkSize + 1) * 16);
+
+	// a map of whole chunks ends with an empty one
+	for(unsigned int Chunk = 0, Offset = 0; Offset <= m_aCurrentMapSize[Version]; Chunk++, Offset += MaxChunkSize)
+	{
+		unsigned int ChunkSize = MaxChunkSize;
+		int Last = 0;
+		if(Offset + ChunkSize >= m_aCurrentMapSize[Version])
+		{
+			ChunkSize = m_aCurrentMapSize[Version] - Offset;
+			Last = 1;
+		}
+
+		CMsgPacker Msg(NETMSG_MAP_DATA, true);
+		if(Version == SIX)
+		{
+			const int aHeader[] = {Last, (int)m_aCurrentMapCrc[SIX], (int)Chunk, (int)ChunkSize};
+			Msg.AddInts(aHeader, sizeof(aHeader) / sizeof(aHeader[0]));
+		}
+		Msg.AddRaw(&m_apCurrentMapData[Version][Offset], ChunkSize);
+
+		CPacker Pack;
+		RepackMsg(&Msg, Pack, Version == SIXUP);
+		vOffsets.push_back(vMsgs.size());
+		vMsgs.insert(vMsgs.end(), Pack.Data(), Pack.Data() + Pack.Size());
+	}
+	vOffsets.push_back(vMsgs.size());
+}
+
 void CServer::SendConnectionReady(int ClientID)
 {
 	CMsgPacker Msg(NETMSG_CON_READY, true);
@@ -1414,27 +1522,15 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 			{
 				for(int i = 0; i < g_Config.m_SvMapWindow; i++)
 				{
-					SendMapData(ClientID, m_aClients[ClientID].m_NextMapChunk++);
+					SendMapData(ClientID, m_aClients[ClientID].m_MapDownload.m_NextChunk++);
 				}
 				return;
 			}
 
-			int Chunk = Unpacker.GetInt();
-			if(Chunk != m_aClients[ClientID].m_NextMapChunk || !g_Config.m_SvFastDownload)
-			{
-				SendMapData(ClientID, Chunk);
-				return;
-			}
-
-			if(Chunk == 0)
-			{
-				for(int i = 0; i < g_Config.m_SvMapWindow; i++)
-				{
-					SendMapData(ClientID, i);
-				}
-			}
-			SendMapData(ClientID, g_Config.m_SvMapWindow + m_aClients[ClientID].m_NextMapChunk);
-			m_aClients[ClientID].m_NextMapChunk++;
+			const int Chunk = Unpacker.GetInt();
+			const int NumChunks = (int)m_avMapChunkOffsets[SIX].size() - 1;
+			m_aClients[ClientID].m_MapDownload.OnRequest(Chunk, NumChunks, g_Config.m_SvFastDownload, g_Config.m_SvMapWindow, g_Config.m_SvMapWindowMax, time_get(), time_freq(),
+				[this, ClientID](int SendChunk) { SendMapData(ClientID, SendChunk); });
 		}
 		else if(Msg == NETMSG_READY)
 		{
@@ -1519,8 +1615,7 @@ void CServer::ProcessClientPacket(CNetChunk *pPacket)
 
 			pInput->m_GameTick = IntendedTick;
 
-			for(int i = 0; i < Size / 4; i++)
-				pInput->m_aData[i] = Unpacker.GetInt();
+			Unpacker.GetInts(pInput->m_aData, Size / 4);
 
 			mem_copy(m_aClients[ClientID].m_LatestInput.m_aData, pInput->m_aData, MAX_INPUT_SIZE * sizeof(int));
 
@@ -2279,11 +2374,9 @@ int CServer::LoadMap(const char *pMapName)
 	// load complete map into memory for download
 	{
 		IOHANDLE File = Storage()->OpenFile(aBuf, IOFLAG_READ, IStorage::TYPE_ALL);
-		m_aCurrentMapSize[SIX] = (unsigned int)io_length(File);
-		free(m_apCurrentMapData[SIX]);
-		m_apCurrentMapData[SIX] = (unsigned char *)malloc(m_aCurrentMapSize[SIX]);
-		io_read(File, m_apCurrentMapData[SIX], m_aCurrentMapSize[SIX]);
+		LoadMapFile(SIX, File);
 		io_close(File);
+		PackMapChunks(SIX);
 	}
 
 	// load sixup version of the map
@@ -2299,11 +2392,9 @@ int CServer::LoadMap(const char *pMapName)
 		}
 		else
 		{
-			m_aCurrentMapSize[SIXUP] = (unsigned int)io_length(File);
-			free(m_apCurrentMapData[SIXUP]);
-			m_apCurrentMapData[SIXUP] = (unsigned char *)malloc(m_aCurrentMapSize[SIXUP]);
-			io_read(File, m_apCurrentMapData[SIXUP], m_aCurrentMapSize[SIXUP]);
+			LoadMapFile(SIXUP, File);
 			io_close(File);
+			PackMapChunks(SIXUP);
 
 			m_aCurrentMapSha256[SIXUP] = sha256(m_apCurrentMapData[SIXUP], m_aCurrentMapSize[SIXUP]);
 			m_aCurrentMapCrc[SIXUP] = crc32(0, m_apCurrentMapData[SIXUP], m_aCurrentMapSize[SIXUP]);
@@ -2377,12 +2468,23 @@ int CServer::Run()
 	if(Port == 0)
 		spdlog::info(FMT "Using port {}", BindAddr.port);
 
+	if(g_Config.m_SvNetThread)
+		m_NetServer.StartRecvThread();
+
 #if defined(CONF_UPNP)
 	m_UPnP.Open(BindAddr);
 #endif
 
 	m_NetServer.SetCallbacks(NewClientCallback, NewClientNoAuthCallback, ClientRejoinCallback, DelClientCallback, this);
 
+	{
+		// the main thread works on the snapshots too
+		int SnapThreads = g_Config.m_SvSnapThreads;
+		if(!SnapThreads)
+			SnapThreads = minimum((int)std::thread::hardware_concurrency(), 8);
+		m_SnapshotWorkers.Init(maximum(SnapThreads, 1) - 1);
+	}
+
 	m_Econ.Init(Config(), Console(), &m_ServerBan);
 
 #if defined(CONF_FAMILY_UNIX)
@@ -2586,6 +2688,9 @@ int CServer::Run()
 			if(!NonActive)
 				PumpNetwork(PacketWaiting);
 
+			// everything of this round in as few system calls as possible
+			m_NetServer.Flush();
+
 			NonActive = true;
 
 			for(auto &Client : m_aClients)
@@ -2609,7 +2714,7 @@ int CServer::Run()
 				if(g_Config.m_SvShutdownWhenEmpty)
 					m_RunServer = STOPPING;
 				else
-					PacketWaiting = net_socket_read_wait(m_NetServer.Socket(), 1000000);
+					PacketWaiting = m_NetServer.Wait(1000000);
 			}
 			else
 			{
@@ -2619,7 +2724,7 @@ int CServer::Run()
 				int64 t = time_get();
 				int x = (TickStartTime(m_CurrentGameTick + 1) - t) * 1000000 / time_freq() + 1;
 
-				PacketWaiting = x > 0 ? net_socket_read_wait(m_NetServer.Socket(), x) : true;
+				PacketWaiting = x > 0 ? m_NetServer.Wait(x) : true;
 			}
 		}
 	}
@@ -2635,6 +2740,7 @@ int CServer::Run()
 		if(m_aClients[i].m_State != CClient::STATE_EMPTY)
 			m_NetServer.Drop(i, pDisconnectReason);
 	}
+	m_NetServer.Close();
 
 	m_Econ.Shutdown();
 
@@ -3106,6 +3212,14 @@ void CServer::ConLogout(IConsole::IResult *pResult, void *pUser)
 	}
 }
 
+void CServer::ConSqlStats(IConsole::IResult *pResult, void *pUser)
+{
+	CServer *pThis = (CServer *)pUser;
+	CConnectionPool::PrintStats([pThis](const char *pLine) {
+		pThis->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "sql", pLine);
+	});
+}
+
 void CServer::ConShowIps(IConsole::IResult *pResult, void *pUser)
 {
 	CServer *pServer = (CServer *)pUser;
@@ -3309,6 +3423,7 @@ void CServer::RegisterCommands()
 	Console()->Register("shutdown", "", CFGFLAG_SERVER, ConShutdown, this, "Shut down");
 	Console()->Register("logout", "", CFGFLAG_SERVER, ConLogout, this, "Logout of rcon");
 	Console()->Register("show_ips", "?i[show]", CFGFLAG_SERVER, ConShowIps, this, "Show IP addresses in rcon commands (1 = on, 0 = off)");
+	Console()->Register("sql_stats", "", CFGFLAG_SERVER, ConSqlStats, this, "Show query counts, latencies and queue state of the SQL pool");
 
 	Console()->Register("record", "?s[file]", CFGFLAG_SERVER | CFGFLAG_STORE, ConRecord, this, "Record to a file");
 	Console()->Register("stoprecord", "", CFGFLAG_SERVER, ConStopRecord, this, "Stop recording");
@@ -3370,6 +3485,7 @@ void *CServer::SnapNewItem(int Type, int ID, int Size)
 void CServer::SnapSetStaticsize(int ItemType, int Size)
 {
 	m_SnapshotDelta.SetStaticsize(ItemType, Size);
+	m_SnapshotDeltaSixup.SetStaticsize(ItemType, Size);
 }
 
 static CServer *CreateServer() { return new CServer(); }
@@ -17,6 +17,7 @@
 #include <engine/shared/fifo.h>
 #include <engine/shared/netban.h>
 #include <engine/shared/network.h>
+#include <engine/shared/parallel.h>
 #include <engine/shared/protocol.h>
 #include <engine/shared/snapshot.h>
 #include <engine/shared/uuid_manager.h>
@@ -24,9 +25,11 @@
 #include <base/tl/array.h>
 
 #include <list>
+#include <vector>
 
 #include "antibot.h"
 #include "authmanager.h"
+#include "map_download.h"
 #include "name_ban.h"
 
 #if defined(CONF_UPNP)
@@ -165,7 +168,7 @@ public:
 		int m_Authed;
 		int m_AuthKey;
 		int m_AuthTries;
-		int m_NextMapChunk;
+		CMapDownload m_MapDownload;
 		int m_Flags;
 		bool m_ShowIps;
 
@@ -196,7 +199,25 @@ public:
 	int m_aIdMap[MAX_CLIENTS * VANILLA_MAX_CLIENTS];
 
 	CSnapshotDelta m_SnapshotDelta;
+	CSnapshotDelta m_SnapshotDeltaSixup;
 	CSnapshotBuilder m_SnapshotBuilder;
+
+	// what DoSnapshotDelta leaves for sending, kept per client so the buffers are reused
+	class CSnapJob
+	{
+	public:
+		std::vector<char> m_vSnapshot;
+		std::vector<char> m_vCompressed; // empty if nothing changed since the delta tick
+		int m_Crc;
+		int m_DeltaTick;
+		CSnapshot *m_pDeltashot; // the acked snapshot the delta is made against
+		int m_DeltashotSize;
+		int m_DeltashotCrc;
+		int m_Source; // client whose m_vCompressed is sent, another one with an identical snapshot and base
+	};
+	CSnapJob m_aSnapJobs[MAX_CLIENTS];
+	// delta and compression of the client snapshots, sized by sv_snap_threads
+	CParallelFor m_SnapshotWorkers;
 	CSnapIDPool m_IDPool;
 	CNetServer m_NetServer;
 	CEcon m_Econ;
@@ -239,6 +260,9 @@ public:
 	unsigned m_aCurrentMapCrc[2];
 	unsigned char *m_apCurrentMapData[2];
 	unsigned int m_aCurrentMapSize[2];
+	// the NETMSG_MAP_DATA messages of the current map, packed and one after another
+	std::vector<unsigned char> m_avMapChunkMsgs[2];
+	std::vector<int> m_avMapChunkOffsets[2];
 
 	CDemoRecorder m_aDemoRecorder[MAX_CLIENTS + 1];
 	CRegister m_Register;
@@ -297,8 +321,11 @@ public:
 	int DistinctClientCount() const;
 
 	virtual int SendMsg(CMsgPacker *pMsg, int Flags, int ClientID);
+	int SendPackedMsg(const void *pData, int Size, int Flags, int ClientID);
 
 	void DoSnapshot();
+	void PrepareSnapshotDelta(int ClientID);
+	void DoSnapshotDelta(int ClientID);
 
 	static int NewClientCallback(int ClientID, void *pUser, bool Sixup);
 	static int NewClientNoAuthCallback(int ClientID, void *pUser);
@@ -310,6 +337,9 @@ public:
 	void SendCapabilities(int ClientID);
 	void SendMap(int ClientID);
 	void SendMapData(int ClientID, int Chunk);
+	void LoadMapFile(int Version, IOHANDLE File);
+	void FreeMapFile(int Version);
+	void PackMapChunks(int Version);
 	void SendConnectionReady(int ClientID);
 	void SendRconLine(int ClientID, const char *pLine);
 	static void SendRconLineAuthed(const char *pLine, void *pUser, ColorRGBA PrintColor = {1, 1, 1, 1});
@@ -377,6 +407,7 @@ public:
 	static void ConMapReload(IConsole::IResult *pResult, void *pUser);
 	static void ConLogout(IConsole::IResult *pResult, void *pUser);
 	static void ConShowIps(IConsole::IResult *pResult, void *pUser);
+	static void ConSqlStats(IConsole::IResult *pResult, void *pUser);
 
 	static void ConAuthAdd(IConsole::IResult *pResult, void *pUser);
 	static void ConAuthAddHashed(IConsole::IResult *pResult, void *pUser);
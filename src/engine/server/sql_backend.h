@@ -0,0 +1,84 @@
+#ifndef ENGINE_SERVER_SQL_BACKEND_H
+#define ENGINE_SERVER_SQL_BACKEND_H
+
+#include <cppconn/exception.h>
+
+#include <base/system.h>
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+// raw bytes, bound as a blob
+struct SqlBlob
+{
+	SqlBlob(const void *pData, int Size) :
+		m_Data((const char *)pData, Size) {}
+	std::string m_Data;
+
+	bool operator<(const SqlBlob &Other) const { return m_Data < Other.m_Data; }
+	bool operator==(const SqlBlob &Other) const { return m_Data == Other.m_Data; }
+};
+
+// a parameter of a prepared statement, copied so the query can run on an SQL worker
+typedef std::variant<int, int64, double, std::string, SqlBlob> SqlValue;
+typedef std::vector<SqlValue> SqlValues;
+
+// Rows of a query. Columns are numbered from 1 or looked up by name,
+// a blob stream stays valid until the next call on the result.
+class ISqlResult
+{
+public:
+	virtual ~ISqlResult() {}
+
+	virtual bool next() = 0;
+	virtual int getInt(unsigned int Column) = 0;
+	virtual int getInt(const std::string &Column) = 0;
+	virtual int64 getInt64(unsigned int Column) = 0;
+	virtual int64 getInt64(const std::string &Column) = 0;
+	virtual double getDouble(unsigned int Column) = 0;
+	virtual double getDouble(const std::string &Column) = 0;
+	virtual std::string getString(unsigned int Column) = 0;
+	virtual std::string getString(const std::string &Column) = 0;
+	virtual std::istream *getBlob(unsigned int Column) = 0;
+	virtual std::istream *getBlob(const std::string &Column) = 0;
+};
+typedef std::unique_ptr<ISqlResult> ResultPtr;
+
+// One connection of a backend, used by one thread at a time.
+// All errors are thrown as sql::SQLException, whatever the backend.
+class ISqlConnection
+{
+public:
+	virtual ~ISqlConnection() {}
+
+	virtual bool IsClosed() = 0;
+	// checks that the database still answers and reconnects if it doesn't, throws if that fails
+	virtual void Ping() = 0;
+	// pResult receives the rows of a SELECT, pass nullptr for other statements
+	virtual void Execute(const std::string &Query, ResultPtr *pResult) = 0;
+	// binds vValues to the ? in Query in order, statements are prepared once per connection and query text.
+	// A result is only valid until the next query on this connection.
+	virtual void ExecutePrepared(const std::string &Query, const SqlValues &vValues, ResultPtr *pResult) = 0;
+};
+
+class ISqlBackend
+{
+public:
+	virtual ~ISqlBackend() {}
+
+	virtual const char *Name() const = 0;
+	// throws sql::SQLException if the database can't be reached
+	virtual ISqlConnection *Connect() = 0;
+	// every thread that uses connections calls these once
+	virtual void ThreadInit() {}
+	virtual void ThreadEnd() {}
+};
+
+ISqlBackend *CreateMySqlBackend();
+// returns nullptr if the server was built without SQLite
+ISqlBackend *CreateSqliteBackend();
+
+#endif
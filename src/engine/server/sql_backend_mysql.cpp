@@ -0,0 +1,179 @@
+#include <sstream>
+#include <unordered_map>
+#include <mysql_connection.h>
+#include <cppconn/driver.h>
+#include <cppconn/prepared_statement.h>
+#include <cppconn/resultset.h>
+#include <cppconn/statement.h>
+#include <engine/shared/config.h>
+#include "sql_backend.h"
+
+#include "spdlog/spdlog.h"
+
+#define FMT "[SQL] "
+
+// #####################################################
+// MYSQL RESULT
+// #####################################################
+class CMySqlResult : public ISqlResult
+{
+	// plain queries own their statement, prepared ones belong to the connection's cache
+	std::unique_ptr<sql::Statement> m_pStatement;
+	std::unique_ptr<sql::ResultSet> m_pResult;
+	std::unique_ptr<std::istream> m_pBlob;
+
+public:
+	CMySqlResult(sql::Statement *pStatement, sql::ResultSet *pResult) :
+		m_pStatement(pStatement), m_pResult(pResult) {}
+
+	bool next() override { return m_pResult->next(); }
+	int getInt(unsigned int Column) override { return m_pResult->getInt(Column); }
+	int getInt(const std::string &Column) override { return m_pResult->getInt(Column); }
+	int64 getInt64(unsigned int Column) override { return m_pResult->getInt64(Column); }
+	int64 getInt64(const std::string &Column) override { return m_pResult->getInt64(Column); }
+	double getDouble(unsigned int Column) override { return m_pResult->getDouble(Column); }
+	double getDouble(const std::string &Column) override { return m_pResult->getDouble(Column); }
+	std::string getString(unsigned int Column) override { return m_pResult->getString(Column); }
+	std::string getString(const std::string &Column) override { return m_pResult->getString(Column); }
+	std::istream *getBlob(unsigned int Column) override
+	{
+		m_pBlob.reset(m_pResult->getBlob(Column));
+		return m_pBlob.get();
+	}
+	std::istream *getBlob(const std::string &Column) override
+	{
+		m_pBlob.reset(m_pResult->getBlob(Column));
+		return m_pBlob.get();
+	}
+};
+
+// #####################################################
+// MYSQL CONNECTION
+// #####################################################
+class CMySqlConnection : public ISqlConnection
+{
+	std::unique_ptr<sql::Connection> m_pConnection;
+	// prepared statements of this connection, keyed by query text
+	std::unordered_map<std::string, std::unique_ptr<sql::PreparedStatement>> m_Statements;
+
+	sql::PreparedStatement *GetStatement(const std::string &Query)
+	{
+		auto It = m_Statements.find(Query);
+		if(It == m_Statements.end())
+			It = m_Statements.emplace(Query, std::unique_ptr<sql::PreparedStatement>(m_pConnection->prepareStatement(Query.c_str()))).first;
+		else
+			It->second->clearParameters();
+		return It->second.get();
+	}
+
+public:
+	CMySqlConnection(sql::Connection *pConnection) :
+		m_pConnection(pConnection) {}
+
+	~CMySqlConnection()
+	{
+		m_Statements.clear();
+		try
+		{
+			m_pConnection->close();
+		}
+		catch(sql::SQLException &e)
+		{
+			spdlog::error(FMT "{}", e.what());
+		}
+	}
+
+	bool IsClosed() override { return m_pConnection->isClosed(); }
+
+	void Ping() override
+	{
+		if(m_pConnection->isValid())
+			return;
+		// the prepared statements belong to the lost session
+		m_Statements.clear();
+		if(!m_pConnection->reconnect())
+			throw sql::SQLException("connection lost and reconnecting failed");
+	}
+
+	void Execute(const std::string &Query, ResultPtr *pResult) override
+	{
+		std::unique_ptr<sql::Statement> pStmt(m_pConnection->createStatement());
+		if(pResult)
+		{
+			sql::ResultSet *pResultSet = pStmt->executeQuery(Query.c_str());
+			pResult->reset(new CMySqlResult(pStmt.release(), pResultSet));
+		}
+		else
+			pStmt->executeUpdate(Query.c_str());
+	}
+
+	void ExecutePrepared(const std::string &Query, const SqlValues &vValues, ResultPtr *pResult) override
+	{
+		try
+		{
+			sql::PreparedStatement *pStmt = GetStatement(Query);
+
+			// blob streams are read when the statement runs
+			std::vector<std::unique_ptr<std::istringstream>> vpBlobs;
+			for(size_t i = 0; i < vValues.size(); i++)
+			{
+				const unsigned int Index = i + 1;
+				const SqlValue &Value = vValues[i];
+				if(const int *pInt = std::get_if<int>(&Value))
+					pStmt->setInt(Index, *pInt);
+				else if(const int64 *pInt64 = std::get_if<int64>(&Value))
+					pStmt->setInt64(Index, *pInt64);
+				else if(const double *pDouble = std::get_if<double>(&Value))
+					pStmt->setDouble(Index, *pDouble);
+				else if(const std::string *pString = std::get_if<std::string>(&Value))
+					pStmt->setString(Index, *pString);
+				else if(const SqlBlob *pBlob = std::get_if<SqlBlob>(&Value))
+				{
+					vpBlobs.emplace_back(new std::istringstream(pBlob->m_Data));
+					pStmt->setBlob(Index, vpBlobs.back().get());
+				}
+			}
+
+			if(pResult)
+				pResult->reset(new CMySqlResult(nullptr, pStmt->executeQuery()));
+			else
+				pStmt->executeUpdate();
+		}
+		catch(sql::SQLException &)
+		{
+			// might be left over from a lost connection, prepare it again next time
+			m_Statements.erase(Query);
+			throw;
+		}
+	}
+};
+
+// #####################################################
+// MYSQL BACKEND
+// #####################################################
+class CMySqlBackend : public ISqlBackend
+{
+	sql::Driver *m_pDriver;
+
+public:
+	CMySqlBackend() :
+		m_pDriver(get_driver_instance()) {}
+
+	const char *Name() const override { return "mysql"; }
+
+	ISqlConnection *Connect() override
+	{
+		std::unique_ptr<sql::Connection> pConnection(m_pDriver->connect(g_Config.m_SvMySqlHost, g_Config.m_SvMySqlLogin, g_Config.m_SvMySqlPassword));
+		pConnection->setClientOption("OPT_CHARSET_NAME", "utf8mb4");
+		pConnection->setSchema(g_Config.m_SvMySqlDatabase);
+		return new CMySqlConnection(pConnection.release());
+	}
+
+	void ThreadInit() override { m_pDriver->threadInit(); }
+	void ThreadEnd() override { m_pDriver->threadEnd(); }
+};
+
+ISqlBackend *CreateMySqlBackend()
+{
+	return new CMySqlBackend();
+}
@@ -0,0 +1,247 @@
+#include "sql_backend.h"
+
+#if defined(CONF_SQLITE)
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <sqlite3.h>
+#include <engine/shared/config.h>
+
+#include "spdlog/spdlog.h"
+
+#define FMT "[SQL] "
+
+/*
+	SQLite is meant for small servers and tests, it needs no database server.
+	The database runs in WAL mode, so every pool connection can read while
+	one of them writes. Statements that write are serialized by the backend,
+	SQLite would otherwise make concurrent writers wait on its file lock.
+*/
+
+// #####################################################
+// SQLITE RESULT
+// #####################################################
+// rows are copied out of the statement, so the result stays valid after the connection is released
+class CSqliteResult : public ISqlResult
+{
+	struct CCell
+	{
+		int m_Type;
+		int64 m_Int;
+		double m_Double;
+		std::string m_Data;
+	};
+	std::vector<std::string> m_vColumns;
+	std::vector<std::vector<CCell>> m_vRows;
+	int m_Row;
+	std::unique_ptr<std::istringstream> m_pBlob;
+
+	const CCell &Cell(unsigned int Column) const
+	{
+		if(m_Row < 0 || m_Row >= (int)m_vRows.size())
+			throw sql::SQLException("no current row");
+		if(Column < 1 || Column > m_vColumns.size())
+			throw sql::SQLException("column index out of range");
+		return m_vRows[m_Row][Column - 1];
+	}
+
+	unsigned int Index(const std::string &Column) const
+	{
+		for(unsigned int i = 0; i < m_vColumns.size(); i++)
+		{
+			if(!str_comp_nocase(m_vColumns[i].c_str(), Column.c_str()))
+				return i + 1;
+		}
+		throw sql::SQLException("unknown column " + Column);
+	}
+
+public:
+	CSqliteResult(sqlite3_stmt *pStmt) :
+		m_Row(-1)
+	{
+		const int NumColumns = sqlite3_column_count(pStmt);
+		for(int i = 0; i < NumColumns; i++)
+			m_vColumns.emplace_back(sqlite3_column_name(pStmt, i));
+	}
+
+	void AddRow(sqlite3_stmt *pStmt)
+	{
+		std::vector<CCell> &vRow = m_vRows.emplace_back(m_vColumns.size());
+		for(size_t i = 0; i < vRow.size(); i++)
+		{
+			CCell &Cell = vRow[i];
+			Cell.m_Type = sqlite3_column_type(pStmt, i);
+			Cell.m_Int = sqlite3_column_int64(pStmt, i);
+			Cell.m_Double = sqlite3_column_double(pStmt, i);
+			if(Cell.m_Type == SQLITE_TEXT || Cell.m_Type == SQLITE_BLOB)
+			{
+				const char *pData = (const char *)sqlite3_column_blob(pStmt, i);
+				Cell.m_Data.assign(pData ? pData : "", sqlite3_column_bytes(pStmt, i));
+			}
+			else if(Cell.m_Type != SQLITE_NULL)
+				Cell.m_Data = (const char *)sqlite3_column_text(pStmt, i);
+		}
+	}
+
+	bool next() override { return ++m_Row < (int)m_vRows.size(); }
+	int getInt(unsigned int Column) override { return Cell(Column).m_Int; }
+	int getInt(const std::string &Column) override { return getInt(Index(Column)); }
+	int64 getInt64(unsigned int Column) override { return Cell(Column).m_Int; }
+	int64 getInt64(const std::string &Column) override { return getInt64(Index(Column)); }
+	double getDouble(unsigned int Column) override { return Cell(Column).m_Double; }
+	double getDouble(const std::string &Column) override { return getDouble(Index(Column)); }
+	std::string getString(unsigned int Column) override { return Cell(Column).m_Data; }
+	std::string getString(const std::string &Column) override { return getString(Index(Column)); }
+	std::istream *getBlob(unsigned int Column) override
+	{
+		m_pBlob.reset(new std::istringstream(Cell(Column).m_Data));
+		return m_pBlob.get();
+	}
+	std::istream *getBlob(const std::string &Column) override { return getBlob(Index(Column)); }
+};
+
+// #####################################################
+// SQLITE CONNECTION
+// #####################################################
+class CSqliteConnection : public ISqlConnection
+{
+	sqlite3 *m_pDb;
+	std::mutex *m_pWriteLock;
+	// prepared statements of this connection, keyed by query text
+	std::unordered_map<std::string, sqlite3_stmt *> m_Statements;
+
+	[[noreturn]] void Fail() const
+	{
+		throw sql::SQLException(sqlite3_errmsg(m_pDb));
+	}
+
+	sqlite3_stmt *Prepare(const std::string &Query)
+	{
+		sqlite3_stmt *pStmt = nullptr;
+		if(sqlite3_prepare_v2(m_pDb, Query.c_str(), Query.size(), &pStmt, nullptr) != SQLITE_OK)
+			Fail();
+		return pStmt;
+	}
+
+	void Step(sqlite3_stmt *pStmt, ResultPtr *pResult)
+	{
+		// readers never wait for each other, writers take turns
+		std::unique_lock<std::mutex> WriteLock(*m_pWriteLock, std::defer_lock);
+		if(!sqlite3_stmt_readonly(pStmt))
+			WriteLock.lock();
+
+		CSqliteResult *pRows = pResult ? new CSqliteResult(pStmt) : nullptr;
+		if(pResult)
+			pResult->reset(pRows);
+
+		int Result;
+		while((Result = sqlite3_step(pStmt)) == SQLITE_ROW)
+		{
+			if(pRows)
+				pRows->AddRow(pStmt);
+		}
+		sqlite3_reset(pStmt);
+		if(Result != SQLITE_DONE)
+		{
+			if(pResult)
+				pResult->reset();
+			Fail();
+		}
+	}
+
+public:
+	CSqliteConnection(sqlite3 *pDb, std::mutex *pWriteLock) :
+		m_pDb(pDb), m_pWriteLock(pWriteLock) {}
+
+	~CSqliteConnection()
+	{
+		for(auto &Statement : m_Statements)
+			sqlite3_finalize(Statement.second);
+		sqlite3_close(m_pDb);
+	}
+
+	bool IsClosed() override { return false; }
+
+	void Ping() override
+	{
+		ResultPtr pResult;
+		Execute("SELECT 1;", &pResult);
+	}
+
+	void Execute(const std::string &Query, ResultPtr *pResult) override
+	{
+		std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt *)> pStmt(Prepare(Query), sqlite3_finalize);
+		Step(pStmt.get(), pResult);
+	}
+
+	void ExecutePrepared(const std::string &Query, const SqlValues &vValues, ResultPtr *pResult) override
+	{
+		auto It = m_Statements.find(Query);
+		if(It == m_Statements.end())
+			It = m_Statements.emplace(Query, Prepare(Query)).first;
+		sqlite3_stmt *pStmt = It->second;
+
+		sqlite3_clear_bindings(pStmt);
+		for(size_t i = 0; i < vValues.size(); i++)
+		{
+			const int Index = i + 1;
+			const SqlValue &Value = vValues[i];
+			int Result = SQLITE_OK;
+			if(const int *pInt = std::get_if<int>(&Value))
+				Result = sqlite3_bind_int(pStmt, Index, *pInt);
+			else if(const int64 *pInt64 = std::get_if<int64>(&Value))
+				Result = sqlite3_bind_int64(pStmt, Index, *pInt64);
+			else if(const double *pDouble = std::get_if<double>(&Value))
+				Result = sqlite3_bind_double(pStmt, Index, *pDouble);
+			else if(const std::string *pString = std::get_if<std::string>(&Value))
+				Result = sqlite3_bind_text(pStmt, Index, pString->c_str(), pString->size(), SQLITE_TRANSIENT);
+			else if(const SqlBlob *pBlob = std::get_if<SqlBlob>(&Value))
+				Result = sqlite3_bind_blob(pStmt, Index, pBlob->m_Data.data(), pBlob->m_Data.size(), SQLITE_TRANSIENT);
+			if(Result != SQLITE_OK)
+				Fail();
+		}
+
+		Step(pStmt, pResult);
+	}
+};
+
+// #####################################################
+// SQLITE BACKEND
+// #####################################################
+class CSqliteBackend : public ISqlBackend
+{
+	std::mutex m_WriteLock;
+
+public:
+	const char *Name() const override { return "sqlite"; }
+
+	ISqlConnection *Connect() override
+	{
+		sqlite3 *pDb = nullptr;
+		const int Flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX;
+		if(sqlite3_open_v2(g_Config.m_SvSqliteFile, &pDb, Flags, nullptr) != SQLITE_OK)
+		{
+			sql::SQLException Error(pDb ? sqlite3_errmsg(pDb) : "out of memory");
+			sqlite3_close(pDb);
+			throw Error;
+		}
+
+		// the write lock already orders writers, the timeout covers other processes using the file
+		sqlite3_busy_timeout(pDb, 5000);
+		std::unique_ptr<CSqliteConnection> pConnection(new CSqliteConnection(pDb, &m_WriteLock));
+		pConnection->Execute("PRAGMA journal_mode = WAL;", nullptr);
+		pConnection->Execute("PRAGMA synchronous = NORMAL;", nullptr);
+		return pConnection.release();
+	}
+};
+
+ISqlBackend *CreateSqliteBackend()
+{
+	return new CSqliteBackend();
+}
+#else
+ISqlBackend *CreateSqliteBackend()
+{
+	return nullptr;
+}
+#endif
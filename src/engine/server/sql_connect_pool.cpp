@@ -1,9 +1,9 @@
+#include <algorithm>
+#include <cctype>
+#include <iterator>
 #include <mutex>
 #include <thread>
-#include <sstream>
 #include <stdarg.h>
-#include <mysql_connection.h>
-#include <cppconn/driver.h>
 #include <base/system.h>
 #include <engine/shared/config.h>
 #include "sql_connect_pool.h"
@@ -24,139 +24,890 @@
 	 but in fact it is and is created as a reserve when running
 	 <tlock>
 
-	 Usage is performed in turn following synchronously 
-	 working running through each request in order
+	 Every query takes a connection out of the list for as long as
+	 it runs, so queries on different connections run in parallel
 
 	 @kurosio
 */
 // sql pool connections mutex
 std::mutex SqlConnectionLock;
-// multithread mutex :: warning recursive
-std::recursive_mutex SqlThreadRecursiveLock;
 
 // #####################################################
 // SQL CONNECTION POOL
 // #####################################################
 std::shared_ptr<CConnectionPool> CConnectionPool::m_Instance;
-CConnectionPool::CConnectionPool()
+std::mutex CConnectionPool::ms_CompletionLock;
+std::vector<std::function<void()>> CConnectionPool::ms_vCompletions;
+static ISqlBackend *CreateConfiguredBackend()
 {
-	try
-	{
-		m_pDriver = get_driver_instance();
-
-		SqlConnectionLock.lock();
-
-		for(int i = 0; i < g_Config.m_SvMySqlPoolSize; ++i) 
-			this->CreateConnection();
+	if(!str_comp(g_Config.m_SvSqlBackend, "sqlite"))
+		return CreateSqliteBackend();
+	if(!str_comp(g_Config.m_SvSqlBackend, "mysql"))
+		return CreateMySqlBackend();
+	return nullptr;
+}
 
-		SqlConnectionLock.unlock();
-	}
-	catch(SQLException &e) 
-	{ 
-		spdlog::error(FMT "{}", e.what());
+CConnectionPool::CConnectionPool(ISqlBackend *pBackend) :
+	m_pBackend(pBackend), m_Timers(TimerTick())
+{
+	if(!m_pBackend)
+	{
+		spdlog::error(FMT "backend '{}' is not available in this build", g_Config.m_SvSqlBackend);
 		exit(0);
 	}
+
+	// an unreachable database does not keep the server from starting, the recovery thread connects later
+	m_NumConnections = 0;
+	m_NumReconnects = 0;
+	m_DatabaseDown = false;
+	for(int i = 0; i < g_Config.m_SvMySqlPoolSize; ++i)
+	{
+		ISqlConnection *pConnection = CreateConnection();
+		if(!pConnection)
+			break;
+		ReleaseConnection(pConnection);
+	}
+
+	for(auto &Stats : m_aStats)
+		Stats.m_Errors = 0;
+	m_InFlight = 0;
+	m_NumBufferedWrites = 0;
+	m_LastFlush = time_get();
+	m_Shutdown = false;
+	for(int i = 0; i < g_Config.m_SvMySqlPoolSize; ++i)
+		m_vWorkers.emplace_back(&CConnectionPool::WorkerThread, this);
+	m_TimerShutdown = false;
+	m_TimerThread = std::thread(&CConnectionPool::TimerThread, this);
+	m_RecoveryShutdown = false;
+	m_RecoveryPending = false;
+	m_RecoveryThread = std::thread(&CConnectionPool::RecoveryThread, this);
 }
 
 CConnectionPool::~CConnectionPool()
 {
+	// suspended queries are not lost on shutdown, they just run early
+	std::vector<CTimerWheel::FTimer> vDelayed;
+	{
+		std::unique_lock<std::mutex> Lock(m_TimerLock);
+		m_TimerShutdown = true;
+	}
+	m_TimerChanged.notify_all();
+	m_TimerThread.join();
+	{
+		std::unique_lock<std::mutex> Lock(m_TimerLock);
+		m_Timers.TakeAll(vDelayed);
+	}
+	for(auto &Func : vDelayed)
+		Func();
+
+	{
+		std::unique_lock<std::mutex> Lock(m_RecoveryLock);
+		m_RecoveryShutdown = true;
+	}
+	m_RecoveryWake.notify_all();
+	m_RecoveryThread.join();
+
+	FlushBufferedWrites(true);
+
+	{
+		std::unique_lock<std::mutex> Lock(m_QueueLock);
+		m_Shutdown = true;
+	}
+	m_QueueNotEmpty.notify_all();
+	m_QueueNotFull.notify_all();
+
+	// workers drain whatever is still queued before they exit
+	for(auto &Worker : m_vWorkers)
+		Worker.join();
+
 	DisconnectConnectionHeap();
 }
 
 CConnectionPool& CConnectionPool::GetInstance()
 {
 	if (m_Instance.get() == nullptr)
-		m_Instance.reset(new CConnectionPool());
+		m_Instance.reset(new CConnectionPool(CreateConfiguredBackend()));
 	return *m_Instance.get();
 }
 
-Connection* CConnectionPool::CreateConnection()
+ISqlConnection *CConnectionPool::CreateConnection()
 {
-	Connection *pConnection = nullptr;
-	while(pConnection == nullptr)
+	try
+	{
+		ISqlConnection *pConnection = m_pBackend->Connect();
+		m_NumConnections++;
+		return pConnection;
+	}
+	catch(SQLException &e) 
 	{
+		SetDatabaseDown(e.what());
+	}
+	return nullptr;
+}
+
+ISqlConnection *CConnectionPool::GetConnection()
+{
+	// fail fast, reconnecting is up to the recovery thread
+	if(m_DatabaseDown)
+		return nullptr;
+
+	ISqlConnection *pConnection = nullptr;
+	SqlConnectionLock.lock();
+	if(!m_ConnList.empty())
+	{
+		pConnection = m_ConnList.front();
+		m_ConnList.pop_front();
+	}
+	SqlConnectionLock.unlock();
+
+	if(pConnection && pConnection->IsClosed())
+	{
+		delete pConnection;
+		m_NumConnections--;
+		pConnection = nullptr;
+	}
+
+	// connecting happens outside the lock, so other threads still get the idle connections
+	if(!pConnection)
+		pConnection = CreateConnection();
+	return pConnection;
+}
+
+void CConnectionPool::ReleaseConnection(ISqlConnection *pConnection, bool Failed)
+{
+	if(!pConnection)
+		return;
+
+	if(Failed && pConnection->IsClosed())
+	{
+		spdlog::warn(FMT "lost a connection");
+		delete pConnection;
+		m_NumConnections--;
+		WakeRecovery();
+		return;
+	}
+
+	SqlConnectionLock.lock();
+	m_ConnList.push_back(pConnection);
+	SqlConnectionLock.unlock();
+}
+
+void CConnectionPool::DisconnectConnection(ISqlConnection *pConnection)
+{
+	// the backend closes the connection and its statements
+	m_ConnList.remove(pConnection);
+	delete pConnection;
+	m_NumConnections--;
+}
+
+// #####################################################
+// CONNECTION RECOVERY
+// #####################################################
+void CConnectionPool::SetDatabaseDown(const char *pError)
+{
+	bool WasDown = false;
+	if(m_DatabaseDown.compare_exchange_strong(WasDown, true))
+	{
+		spdlog::error(FMT "database is unreachable, queries are held back until it is back: {}", pError);
+		WakeRecovery();
+	}
+	else
+		spdlog::debug(FMT "{}", pError);
+}
+
+void CConnectionPool::WakeRecovery()
+{
+	{
+		std::unique_lock<std::mutex> Lock(m_RecoveryLock);
+		m_RecoveryPending = true;
+	}
+	m_RecoveryWake.notify_one();
+}
+
+void CConnectionPool::RecoveryThread()
+{
+	m_pBackend->ThreadInit();
+	int Backoff = RECONNECT_MIN_MS;
+	int64 LastPing = time_get();
+	while(true)
+	{
+		{
+			// once a second for keepalive pings, after the backoff while the database is down
+			std::unique_lock<std::mutex> Lock(m_RecoveryLock);
+			const int Wait = m_DatabaseDown ? Backoff : 1000;
+			m_RecoveryWake.wait_for(Lock, std::chrono::milliseconds(Wait), [this]() { return m_RecoveryShutdown || (m_RecoveryPending && !m_DatabaseDown); });
+			if(m_RecoveryShutdown)
+				break;
+			m_RecoveryPending = false;
+		}
+
+		// refill the pool, the first connection that works closes the circuit breaker again.
+		// While it is open, connect at least once even if the pool is full of dead connections.
+		bool Connected = true;
+		bool Probe = m_DatabaseDown;
+		while(Probe || m_NumConnections < g_Config.m_SvMySqlPoolSize)
+		{
+			Probe = false;
+			ISqlConnection *pConnection = nullptr;
+			try
+			{
+				pConnection = m_pBackend->Connect();
+				m_NumConnections++;
+			}
+			catch(SQLException &e)
+			{
+				SetDatabaseDown(e.what());
+				Connected = false;
+				break;
+			}
+			ReleaseConnection(pConnection);
+		}
+
+		if(!Connected)
+		{
+			Backoff = std::min(Backoff * 2, (int)RECONNECT_MAX_MS);
+			continue;
+		}
+		Backoff = RECONNECT_MIN_MS;
+		if(m_DatabaseDown)
+		{
+			m_NumReconnects++;
+			size_t Queued;
+			{
+				// under the queue lock, so no worker misses the wake up
+				std::unique_lock<std::mutex> Lock(m_QueueLock);
+				m_DatabaseDown = false;
+				Queued = m_QueryQueue.size();
+			}
+			m_QueueNotEmpty.notify_all();
+			spdlog::info(FMT "database is reachable again, running {} held back queries", Queued);
+		}
+
+		if(g_Config.m_SvMySqlKeepalive && time_get() - LastPing >= time_freq() * g_Config.m_SvMySqlKeepalive)
+		{
+			LastPing = time_get();
+			PingIdleConnections();
+		}
+	}
+	m_pBackend->ThreadEnd();
+}
+
+void CConnectionPool::PingIdleConnections()
+{
+	// one at a time, the others stay available to the workers
+	SqlConnectionLock.lock();
+	size_t NumIdle = m_ConnList.size();
+	SqlConnectionLock.unlock();
+
+	for(; NumIdle > 0; NumIdle--)
+	{
+		SqlConnectionLock.lock();
+		if(m_ConnList.empty())
+		{
+			SqlConnectionLock.unlock();
+			break;
+		}
+		ISqlConnection *pConnection = m_ConnList.front();
+		m_ConnList.pop_front();
+		SqlConnectionLock.unlock();
+
 		try
 		{
-			pConnection = m_pDriver->connect(g_Config.m_SvMySqlHost, g_Config.m_SvMySqlLogin, g_Config.m_SvMySqlPassword);
-			pConnection->setClientOption("OPT_CHARSET_NAME", "utf8mb4");
-			pConnection->setSchema(g_Config.m_SvMySqlDatabase);
+			pConnection->Ping();
 		}
-		catch(SQLException &e) 
+		catch(SQLException &e)
 		{
-			spdlog::error(FMT "{}", e.what());
-			DisconnectConnection(pConnection);
+			// a connection that doesn't answer is dropped, the recovery thread replaces it
+			spdlog::warn(FMT "keepalive failed: {}", e.what());
+			delete pConnection;
+			m_NumConnections--;
+			WakeRecovery();
+			continue;
 		}
+		ReleaseConnection(pConnection);
 	}
-	m_ConnList.push_back(pConnection);
-	return pConnection;
 }
 
-Connection* CConnectionPool::GetConnection()
+void CConnectionPool::DisconnectConnectionHeap()
 {
 	SqlConnectionLock.lock();
 
-	Connection* pConnection = nullptr;
-	if(m_ConnList.empty())
+	// DisconnectConnection removes the connection from the list
+	while(!m_ConnList.empty())
+		DisconnectConnection(m_ConnList.front());
+
+	SqlConnectionLock.unlock();
+}
+
+// #####################################################
+// SQL WORKERS
+// #####################################################
+// set on pool workers, so callbacks that queue more queries never wait on their own queue
+static thread_local bool s_IsSqlWorker = false;
+
+void CConnectionPool::WorkerThread()
+{
+	s_IsSqlWorker = true;
+	m_pBackend->ThreadInit();
+	while(true)
 	{
-		pConnection = CreateConnection();
+		SQueuedJob Job;
+		{
+			std::unique_lock<std::mutex> Lock(m_QueueLock);
+			// queued jobs wait while the database is down, unless the pool shuts down
+			m_QueueNotEmpty.wait(Lock, [this]() { return m_Shutdown || (!m_QueryQueue.empty() && !m_DatabaseDown); });
+			if(m_QueryQueue.empty())
+				break;
+
+			Job = std::move(m_QueryQueue.front());
+			m_QueryQueue.pop_front();
+		}
+		m_QueueNotFull.notify_one();
 
-		SqlConnectionLock.unlock();
-		return pConnection;
+		m_QueueWait.Add((time_get() - Job.m_QueuedAt) * 1000000 / time_freq());
+		m_InFlight++;
+		Job.m_Job();
+		m_InFlight--;
 	}
+	m_pBackend->ThreadEnd();
+}
 
-	pConnection = m_ConnList.front();
-	m_ConnList.pop_front();
-	if(pConnection->isClosed())
+int64 CConnectionPool::PushJob(int Milliseconds, FQueryJob Job)
+{
+	if(Milliseconds <= 0)
 	{
-		delete pConnection;
-		pConnection = nullptr;
-		pConnection = CreateConnection();
+		EnqueueJob(std::move(Job));
+		return 0;
 	}
 
-	SqlConnectionLock.unlock();
-	return pConnection;
+	// delayed jobs only wait in the wheel, the query itself still goes through the worker queue
+	const int64 Due = TimerTick() + (Milliseconds + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+	int64 ID;
+	{
+		std::unique_lock<std::mutex> Lock(m_TimerLock);
+		ID = m_Timers.Add(Due, [this, Job]() { EnqueueJob(Job); });
+	}
+	m_TimerChanged.notify_one();
+	return ID;
+}
+
+// #####################################################
+// DELAYED QUERIES
+// #####################################################
+int64 CConnectionPool::TimerTick()
+{
+	return time_get() * (1000 / TIMER_TICK_MS) / time_freq();
 }
 
-void CConnectionPool::ReleaseConnection(Connection* pConnection)
+void CConnectionPool::TimerThread()
 {
-	SqlConnectionLock.lock();
+	std::vector<CTimerWheel::FTimer> vDue;
+	std::unique_lock<std::mutex> Lock(m_TimerLock);
+	while(!m_TimerShutdown)
+	{
+		// sleeps until something gets added while there is nothing to wait for
+		if(m_Timers.Num())
+			m_TimerChanged.wait_for(Lock, std::chrono::milliseconds(TIMER_TICK_MS));
+		else
+			m_TimerChanged.wait(Lock);
+
+		m_Timers.Advance(TimerTick(), vDue);
+		if(vDue.empty())
+			continue;
+
+		// queuing can block on a full queue, PushJob must not wait for that
+		Lock.unlock();
+		for(auto &Func : vDue)
+			Func();
+		vDue.clear();
+		Lock.lock();
+	}
+}
 
-	if(pConnection)
+std::string CConnectionPool::TakeDelayedUpdate(std::map<std::string, SDelayedUpdate>::iterator It)
+{
+	const SDelayedUpdate &Update = It->second;
+	std::string Set;
+	for(const auto &Column : Update.m_Columns)
+		Set += (Set.empty() ? "" : ", ") + Column.first + " = " + Column.second.back().m_Value;
+	for(int64 ID : Update.m_vIDs)
 	{
-		m_ConnList.push_back(pConnection);
+		m_Timers.Cancel(ID);
+		m_DelayedUpdateKeys.erase(ID);
 	}
+	std::string Query("UPDATE " + Update.m_Table + " SET " + Set + Update.m_Where + ";");
+	m_DelayedUpdates.erase(It);
+	return Query;
+}
 
-	SqlConnectionLock.unlock();
+void CConnectionPool::RunDelayedUpdate(const std::string &Key, int64 ID)
+{
+	std::string Query;
+	{
+		std::unique_lock<std::mutex> Lock(m_TimerLock);
+		// the UDS of this timer may have been cancelled after it fired
+		auto KeyIt = m_DelayedUpdateKeys.find(ID);
+		if(KeyIt == m_DelayedUpdateKeys.end())
+			return;
+		Query = TakeDelayedUpdate(m_DelayedUpdates.find(Key));
+	}
+	EnqueueJob([this, Query]() { ExecuteUpdate(Query); });
 }
 
-void CConnectionPool::DisconnectConnection(Connection* pConnection)
+bool CConnectionPool::CancelDelayed(int64 ID)
 {
+	std::unique_lock<std::mutex> Lock(m_TimerLock);
+	bool Cancelled = m_Timers.Cancel(ID);
+
+	// a merged UDS, also if its timer already fired but the update was not queued yet
+	auto KeyIt = m_DelayedUpdateKeys.find(ID);
+	if(KeyIt == m_DelayedUpdateKeys.end())
+		return Cancelled;
+	auto It = m_DelayedUpdates.find(KeyIt->second);
+	m_DelayedUpdateKeys.erase(KeyIt);
+	SDelayedUpdate &Update = It->second;
+	Update.m_vIDs.erase(std::find(Update.m_vIDs.begin(), Update.m_vIDs.end(), ID));
+	for(auto Column = Update.m_Columns.begin(); Column != Update.m_Columns.end();)
+	{
+		auto &vValues = Column->second;
+		vValues.erase(std::remove_if(vValues.begin(), vValues.end(), [ID](const SDelayedAssignment &Value) { return Value.m_ID == ID; }), vValues.end());
+		if(vValues.empty())
+			Column = Update.m_Columns.erase(Column);
+		else
+			++Column;
+	}
+	if(Update.m_vIDs.empty())
+		m_DelayedUpdates.erase(It);
+	return true;
+}
+
+void CConnectionPool::EnqueueJob(FQueryJob Job)
+{
+	{
+		std::unique_lock<std::mutex> Lock(m_QueueLock);
+		const size_t MaxQueued = (size_t)g_Config.m_SvMySqlQueueSize;
+		if(m_QueryQueue.size() >= MaxQueued && !m_Shutdown)
+		{
+			if(s_IsSqlWorker)
+			{
+				Lock.unlock();
+				Job();
+				return;
+			}
+
+			// waiting or running it here would stall the caller until the database is back
+			if(m_DatabaseDown)
+			{
+				spdlog::error(FMT "database is down and the queue is full ({} queries), query dropped", MaxQueued);
+				return;
+			}
+
+			switch(g_Config.m_SvMySqlQueueOverflow)
+			{
+			case OVERFLOW_SYNC:
+				Lock.unlock();
+				spdlog::warn(FMT "queue is full ({} queries), running query on the caller thread", MaxQueued);
+				m_pBackend->ThreadInit();
+				Job();
+				m_pBackend->ThreadEnd();
+				return;
+			case OVERFLOW_DROP:
+				spdlog::error(FMT "queue is full ({} queries), query dropped", MaxQueued);
+				return;
+			default:
+				m_QueueNotFull.wait(Lock, [this, MaxQueued]() { return m_Shutdown || m_QueryQueue.size() < MaxQueued; });
+			}
+		}
+		m_QueryQueue.push_back(SQueuedJob{std::move(Job), time_get()});
+	}
+	m_QueueNotEmpty.notify_one();
+}
+
+void CConnectionPool::ExecuteUpdate(const std::string &Query)
+{
+	ISqlConnection *pConnection = GetConnection();
+	if(!pConnection)
+	{
+		CountUnavailable(STAT_WRITE, Query);
+		return;
+	}
+	const int64 Start = time_get();
+	bool Success = true;
+	try
+	{
+		pConnection->Execute(Query, nullptr);
+	}
+	catch(SQLException &e)
+	{
+		spdlog::error(FMT "{}", e.what());
+		Success = false;
+	}
+	CountQuery(STAT_WRITE, Query, Start, Success);
+	ReleaseConnection(pConnection, !Success);
+}
+
+void CConnectionPool::ExecuteSelect(const std::string &Query, const std::function<void(ResultPtr)> &func)
+{
+	ResultPtr pResult = nullptr;
+	ISqlConnection *pConnection = GetConnection();
+	int64 Start = time_get();
+	bool Success = pConnection != nullptr;
+	if(!pConnection)
+		CountUnavailable(STAT_SELECT, Query);
+	else
+	{
+		try
+		{
+			pConnection->Execute(Query, &pResult);
+		}
+		catch(SQLException &e)
+		{
+			spdlog::error(FMT "{}", e.what());
+			Success = false;
+		}
+		CountQuery(STAT_SELECT, Query, Start, Success);
+	}
+
+	// callers have to learn about failed queries too, e.g. to answer a waiting player
+	Start = time_get();
+	try
+	{
+		func(std::move(pResult));
+	}
+	catch(SQLException &e)
+	{
+		spdlog::error(FMT "{}", e.what());
+	}
+	CountCallback(Start);
+	ReleaseConnection(pConnection, !Success);
+}
+
+// runs Query on a connection the caller holds, pResult is set for selects
+bool CConnectionPool::RunPrepared(ISqlConnection *pConnection, int Stat, const std::string &Query, const SqlValues &vValues, ResultPtr *pResult)
+{
+	const int64 Start = time_get();
+	bool Success = true;
+	try
+	{
+		pConnection->ExecutePrepared(Query, vValues, pResult);
+	}
+	catch(SQLException &e)
+	{
+		spdlog::error(FMT "{}", e.what());
+		Success = false;
+	}
+	CountQuery(Stat, Query, Start, Success);
+	return Success;
+}
+
+bool CConnectionPool::ExecutePrepared(const std::string &Query, const SqlValues &vValues, const std::function<void(ResultPtr)> *pSelectFunc)
+{
+	if(!s_IsSqlWorker)
+		m_pBackend->ThreadInit();
+	ISqlConnection *pConnection = GetConnection();
+
+	ResultPtr pResult = nullptr;
+	const int Stat = pSelectFunc ? STAT_SELECT : STAT_WRITE;
+	bool Success = false;
 	if(pConnection)
+		Success = RunPrepared(pConnection, Stat, Query, vValues, pSelectFunc ? &pResult : nullptr);
+	else
+		CountUnavailable(Stat, Query);
+
+	// the result belongs to the cached statement, so it is only handed out while we hold the connection
+	if(pSelectFunc)
 	{
+		const int64 Start = time_get();
 		try
 		{
-			pConnection->close();
+			(*pSelectFunc)(std::move(pResult));
 		}
-		catch(SQLException& e)
+		catch(SQLException &e)
 		{
 			spdlog::error(FMT "{}", e.what());
 		}
+		CountCallback(Start);
 	}
-	m_ConnList.remove(pConnection);
-	delete pConnection;
-	pConnection = nullptr;
+
+	ReleaseConnection(pConnection, !Success);
+	if(!s_IsSqlWorker)
+		m_pBackend->ThreadEnd();
+	return Success;
 }
 
-void CConnectionPool::DisconnectConnectionHeap()
+// #####################################################
+// STATISTICS
+// #####################################################
+CConnectionPool::CLatency::CLatency()
 {
-	SqlConnectionLock.lock();
+	for(auto &Bucket : m_aBuckets)
+		Bucket = 0;
+	m_Count = 0;
+	m_TotalMicros = 0;
+	m_MaxMicros = 0;
+}
 
-	for(auto& iconn : m_ConnList)
-		DisconnectConnection(iconn);
-		
-	m_ConnList.clear();
+void CConnectionPool::CLatency::Add(int64 Micros)
+{
+	int Bucket = 0;
+	while(Bucket < NUM_BUCKETS - 1 && Micros >= ((int64)1 << Bucket))
+		Bucket++;
+	m_aBuckets[Bucket]++;
+	m_Count++;
+	m_TotalMicros += Micros;
+
+	int64 Max = m_MaxMicros;
+	while(Micros > Max && !m_MaxMicros.compare_exchange_weak(Max, Micros))
+		;
+}
 
-	SqlConnectionLock.unlock();
+int64 CConnectionPool::CLatency::Percentile(int Percent) const
+{
+	const int64 Wanted = (m_Count * Percent + 99) / 100;
+	int64 Seen = 0;
+	for(int i = 0; i < NUM_BUCKETS - 1; i++)
+	{
+		Seen += m_aBuckets[i];
+		if(Seen >= Wanted)
+			return std::min((int64)1 << i, m_MaxMicros.load());
+	}
+	return m_MaxMicros;
+}
+
+void CConnectionPool::CLatency::Format(char *pBuffer, int BufferSize) const
+{
+	const int64 Count = m_Count;
+	if(!Count)
+	{
+		str_copy(pBuffer, "-", BufferSize);
+		return;
+	}
+	str_format(pBuffer, BufferSize, "n=%lld avg=%.2fms p50<=%.2fms p99<=%.2fms max=%.2fms",
+		Count, m_TotalMicros / 1000.0 / Count, Percentile(50) / 1000.0, Percentile(99) / 1000.0, m_MaxMicros / 1000.0);
+}
+
+void CConnectionPool::CountQuery(int Stat, const std::string &Query, int64 Start, bool Success)
+{
+	const int64 Micros = (time_get() - Start) * 1000000 / time_freq();
+	m_aStats[Stat].m_Execution.Add(Micros);
+	if(!Success)
+		m_aStats[Stat].m_Errors++;
+
+	if(g_Config.m_SvMySqlSlowQuery && Micros >= g_Config.m_SvMySqlSlowQuery * (int64)1000)
+		spdlog::warn(FMT "slow query ({:.1f}ms): {}", Micros / 1000.0, Query);
+}
+
+void CConnectionPool::CountCallback(int64 Start)
+{
+	m_Callback.Add((time_get() - Start) * 1000000 / time_freq());
+}
+
+void CConnectionPool::CountUnavailable(int Stat, const std::string &Query)
+{
+	m_aStats[Stat].m_Errors++;
+	spdlog::error(FMT "database is down, query failed: {}", Query);
+}
+
+void CConnectionPool::PrintStats(const std::function<void(const char *pLine)> &Print)
+{
+	// don't connect just to print zeros
+	if(!m_Instance)
+	{
+		Print("not connected");
+		return;
+	}
+
+	CConnectionPool *pPool = m_Instance.get();
+	size_t Queued;
+	{
+		std::unique_lock<std::mutex> Lock(pPool->m_QueueLock);
+		Queued = pPool->m_QueryQueue.size();
+	}
+	int Buffered;
+	{
+		std::unique_lock<std::mutex> Lock(pPool->m_WriteLock);
+		Buffered = pPool->m_NumBufferedWrites;
+	}
+
+	char aBuf[256];
+	str_format(aBuf, sizeof(aBuf), "backend=%s workers=%d queued=%d in_flight=%d buffered_writes=%d connections=%d database=%s reconnects=%lld",
+		pPool->m_pBackend->Name(), (int)pPool->m_vWorkers.size(), (int)Queued, pPool->m_InFlight.load(), Buffered,
+		pPool->m_NumConnections.load(), pPool->m_DatabaseDown ? "down" : "up", pPool->m_NumReconnects.load());
+	Print(aBuf);
+
+	static const char *s_apNames[NUM_STATS] = {"select", "write", "batch"};
+	char aLatency[128];
+	for(int i = 0; i < NUM_STATS; i++)
+	{
+		pPool->m_aStats[i].m_Execution.Format(aLatency, sizeof(aLatency));
+		str_format(aBuf, sizeof(aBuf), "%s: errors=%lld %s", s_apNames[i], pPool->m_aStats[i].m_Errors.load(), aLatency);
+		Print(aBuf);
+	}
+
+	pPool->m_QueueWait.Format(aLatency, sizeof(aLatency));
+	str_format(aBuf, sizeof(aBuf), "queue wait: %s", aLatency);
+	Print(aBuf);
+	pPool->m_Callback.Format(aLatency, sizeof(aLatency));
+	str_format(aBuf, sizeof(aBuf), "callback: %s", aLatency);
+	Print(aBuf);
+}
+
+void CConnectionPool::Complete(std::function<void()> Func)
+{
+	std::unique_lock<std::mutex> Lock(ms_CompletionLock);
+	ms_vCompletions.push_back(std::move(Func));
+}
+
+void CConnectionPool::RunCompletions()
+{
+	std::vector<std::function<void()>> vCompletions;
+	{
+		std::unique_lock<std::mutex> Lock(ms_CompletionLock);
+		if(ms_vCompletions.empty())
+			return;
+		vCompletions.swap(ms_vCompletions);
+	}
+
+	for(auto &Func : vCompletions)
+		Func();
+}
+
+// #####################################################
+// WRITE BEHIND
+// #####################################################
+void CConnectionPool::BufferUpdateValue(const char *pTable, const char *pKeyColumn, SqlValue Key, const char *pColumn, SqlValue Value)
+{
+	{
+		std::unique_lock<std::mutex> Lock(m_WriteLock);
+		BufferedColumns &vColumns = m_BufferedUpdates[SBufferedRow{pTable, pKeyColumn, std::move(Key)}];
+		auto It = std::find_if(vColumns.begin(), vColumns.end(), [pColumn](const std::pair<std::string, SqlValue> &Column) { return Column.first == pColumn; });
+		if(It != vColumns.end())
+		{
+			It->second = std::move(Value);
+			return;
+		}
+
+		vColumns.emplace_back(pColumn, std::move(Value));
+		if(++m_NumBufferedWrites < g_Config.m_SvMySqlFlushSize)
+			return;
+	}
+	FlushBufferedWrites(true);
+}
+
+void CConnectionPool::BufferInsertValues(const char *pTable, const char *pColumns, SqlValues vValues)
+{
+	const int NumColumns = std::count(pColumns, pColumns + str_length(pColumns), ',') + 1;
+	if((int)vValues.size() != NumColumns)
+	{
+		spdlog::error(FMT "buffered insert into {} has {} values for {} columns", pTable, vValues.size(), NumColumns);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> Lock(m_WriteLock);
+		m_BufferedInserts[std::make_pair(std::string(pTable), std::string(pColumns))].push_back(std::move(vValues));
+		if(++m_NumBufferedWrites < g_Config.m_SvMySqlFlushSize)
+			return;
+	}
+	FlushBufferedWrites(true);
+}
+
+void CConnectionPool::FlushWrites(bool Force)
+{
+	// nothing can be buffered before the pool exists
+	if(m_Instance)
+		m_Instance->FlushBufferedWrites(Force);
+}
+
+void CConnectionPool::FlushBufferedWrites(bool Force)
+{
+	std::map<SBufferedRow, BufferedColumns> Updates;
+	std::map<std::pair<std::string, std::string>, std::vector<SqlValues>> Inserts;
+	{
+		std::unique_lock<std::mutex> Lock(m_WriteLock);
+		const int64 Now = time_get();
+		if(!Force && Now < m_LastFlush + time_freq() * g_Config.m_SvMySqlFlushInterval / 1000)
+			return;
+
+		m_LastFlush = Now;
+		if(!m_NumBufferedWrites)
+			return;
+
+		m_NumBufferedWrites = 0;
+		Updates.swap(m_BufferedUpdates);
+		Inserts.swap(m_BufferedInserts);
+	}
+
+	// inserts go first, so updates can refer to rows inserted in the same window
+	StatementBatch vStatements;
+	for(auto &Insert : Inserts)
+	{
+		const std::string &Table = Insert.first.first;
+		const std::string &Columns = Insert.first.second;
+		std::vector<SqlValues> &vRows = Insert.second;
+		const int NumColumns = vRows.front().size();
+
+		std::string Row("(?");
+		for(int i = 1; i < NumColumns; i++)
+			Row += ", ?";
+		Row += ")";
+
+		for(size_t First = 0; First < vRows.size(); First += MAX_INSERT_ROWS)
+		{
+			const size_t Last = std::min(First + MAX_INSERT_ROWS, vRows.size());
+			std::string Query("INSERT INTO " + Table + " (" + Columns + ") VALUES ");
+			SqlValues vValues;
+			vValues.reserve((Last - First) * NumColumns);
+			for(size_t i = First; i < Last; i++)
+			{
+				Query += i == First ? Row : ", " + Row;
+				std::move(vRows[i].begin(), vRows[i].end(), std::back_inserter(vValues));
+			}
+			Query += ";";
+			vStatements.emplace_back(std::move(Query), std::move(vValues));
+		}
+	}
+
+	for(auto &Update : Updates)
+	{
+		const SBufferedRow &Key = Update.first;
+		std::string Query("UPDATE " + Key.m_Table + " SET ");
+		SqlValues vValues;
+		vValues.reserve(Update.second.size() + 1);
+		for(auto &Column : Update.second)
+		{
+			if(!vValues.empty())
+				Query += ", ";
+			Query += Column.first + " = ?";
+			vValues.push_back(std::move(Column.second));
+		}
+		Query += " WHERE " + Key.m_KeyColumn + " = ?;";
+		vValues.push_back(Key.m_Key);
+		vStatements.emplace_back(std::move(Query), std::move(vValues));
+	}
+
+	// one job on one connection keeps the order of the statements
+	PushJob(0, [this, vStatements]() { ExecuteBatch(vStatements); });
+}
+
+void CConnectionPool::ExecuteBatch(const StatementBatch &vStatements)
+{
+	if(!s_IsSqlWorker)
+		m_pBackend->ThreadInit();
+	ISqlConnection *pConnection = GetConnection();
+
+	bool Success = true;
+	for(const auto &Statement : vStatements)
+	{
+		if(!pConnection)
+			CountUnavailable(STAT_BATCH, Statement.first);
+		else if(!RunPrepared(pConnection, STAT_BATCH, Statement.first, Statement.second, nullptr))
+			Success = false;
+	}
+
+	ReleaseConnection(pConnection, !Success);
+	if(!s_IsSqlWorker)
+		m_pBackend->ThreadEnd();
 }
 
 // #####################################################
@@ -170,15 +921,16 @@ void CConnectionPool::ID(const char *Table, const char *Buffer, ...)
 	va_end(Arguments);
 }
 
-void CConnectionPool::IDS(int Milliseconds, const char *Table, const char *Buffer, ...)
+int64 CConnectionPool::IDS(int Milliseconds, const char *Table, const char *Buffer, ...)
 {
 	va_list Arguments;
 	va_start(Arguments, Buffer);
-	InsertFormated(Milliseconds, Table, Buffer, Arguments);
-	va_end(Arguments);	
+	const int64 ID = InsertFormated(Milliseconds, Table, Buffer, Arguments);
+	va_end(Arguments);
+	return ID;
 }
 
-void CConnectionPool::InsertFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args)
+int64 CConnectionPool::InsertFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args)
 {
 	char aBuf[1024];
 	#if defined(CONF_FAMILY_WINDOWS)
@@ -188,34 +940,7 @@ void CConnectionPool::InsertFormated(int Milliseconds, const char *Table, const
 	#endif
 	aBuf[sizeof(aBuf) - 1] = '\0';
 	std::string Query("INSERT INTO " + std::string(Table) + " " + std::string(aBuf) + ";");
-	std::thread Thread([this, Query, Milliseconds]()
-	{
-		if(Milliseconds > 0)
-			std::this_thread::sleep_for(std::chrono::milliseconds(Milliseconds));
-
-		const char* pError = nullptr;
-
-		SqlThreadRecursiveLock.lock();
-		m_pDriver->threadInit();
-		Connection* pConnection = SJK.GetConnection();
-		try
-		{
-			std::unique_ptr<Statement> pStmt(pConnection->createStatement());
-			pStmt->executeUpdate(Query.c_str());
-			pStmt->close();
-		}
-		catch (SQLException & e)
-		{
-			pError = e.what();
-		}
-		SJK.ReleaseConnection(pConnection);
-		m_pDriver->threadEnd();
-		SqlThreadRecursiveLock.unlock();
-
-		if(pError != nullptr)
-			spdlog::error(FMT "{}", pError);
-	});
-	Thread.detach();
+	return PushJob(Milliseconds, [this, Query]() { ExecuteUpdate(Query); });
 }
 
 // #####################################################
@@ -229,15 +954,107 @@ void CConnectionPool::UD(const char *Table, const char *Buffer, ...)
 	va_end(Arguments);
 }
 
-void CConnectionPool::UDS(int Milliseconds, const char *Table, const char *Buffer, ...)
+int64 CConnectionPool::UDS(int Milliseconds, const char *Table, const char *Buffer, ...)
 {
 	va_list Arguments;
 	va_start(Arguments, Buffer);
-	UpdateFormated(Milliseconds, Table, Buffer, Arguments);
+	const int64 ID = UpdateFormated(Milliseconds, Table, Buffer, Arguments);
 	va_end(Arguments);
+	return ID;
+}
+
+// skips a quoted string or name starting at pText, returns where it ends or nullptr if it doesn't
+static const char *SkipQuoted(const char *pText)
+{
+	const char Quote = *pText++;
+	for(; *pText; pText++)
+	{
+		if(*pText == '\\' && pText[1])
+			pText++;
+		else if(*pText == Quote)
+		{
+			// doubled quotes are part of the string
+			if(pText[1] != Quote)
+				return pText + 1;
+			pText++;
+		}
+	}
+	return nullptr;
+}
+
+static bool IsQuote(char c)
+{
+	return c == '\'' || c == '"' || c == '`';
 }
 
-void CConnectionPool::UpdateFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args)
+// the " WHERE " of an UPDATE, not one inside a string
+static const char *FindWhere(const char *pText)
+{
+	while(*pText)
+	{
+		if(IsQuote(*pText))
+		{
+			pText = SkipQuoted(pText);
+			if(!pText)
+				return nullptr;
+		}
+		else if(str_comp_nocase_num(pText, " WHERE ", 7) == 0)
+			return pText;
+		else
+			pText++;
+	}
+	return nullptr;
+}
+
+// splits "a = '1', b = 2" into columns and values, false unless every value is a plain literal
+static bool ParseLiteralAssignments(const std::string &Set, std::vector<std::pair<std::string, std::string>> &vAssignments)
+{
+	const char *p = Set.c_str();
+	while(true)
+	{
+		p = str_skip_whitespaces_const(p);
+		const char *pColumn = p;
+		while(isalnum((unsigned char)*p) || *p == '_' || *p == '.' || *p == '`')
+			p++;
+		if(p == pColumn)
+			return false;
+		std::string Column(pColumn, p - pColumn);
+
+		p = str_skip_whitespaces_const(p);
+		if(*p++ != '=')
+			return false;
+		p = str_skip_whitespaces_const(p);
+
+		const char *pValue = p;
+		if(*p == '\'' || *p == '"')
+		{
+			p = SkipQuoted(p);
+			if(!p)
+				return false;
+		}
+		else if(str_comp_nocase_num(p, "NULL", 4) == 0 && !isalnum((unsigned char)p[4]) && p[4] != '_')
+			p += 4;
+		else
+		{
+			if(*p == '-' || *p == '+')
+				p++;
+			const char *pDigits = p;
+			while(isdigit((unsigned char)*p) || *p == '.')
+				p++;
+			if(p == pDigits)
+				return false;
+		}
+		vAssignments.emplace_back(Column, std::string(pValue, p - pValue));
+
+		p = str_skip_whitespaces_const(p);
+		if(!*p)
+			return true;
+		if(*p++ != ',')
+			return false;
+	}
+}
+
+int64 CConnectionPool::UpdateFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args)
 {
 	char aBuf[1024];
 	#if defined(CONF_FAMILY_WINDOWS)
@@ -246,35 +1063,61 @@ void CConnectionPool::UpdateFormated(int Milliseconds, const char *Table, const
 	vsnprintf(aBuf, sizeof(aBuf), Buffer, args);
 	#endif
 	aBuf[sizeof(aBuf) - 1] = '\0';
-	std::string Query("UPDATE " + std::string(Table) + " SET " + std::string(aBuf) + ";");
-	std::thread Thread([this, Query, Milliseconds]()
-	{
-		if(Milliseconds > 0)
-			std::this_thread::sleep_for(std::chrono::milliseconds(Milliseconds));
-		
-		const char* pError = nullptr;
 
-		SqlThreadRecursiveLock.lock();
-		m_pDriver->threadInit();
-		Connection* pConnection = SJK.GetConnection();
-		try
-		{
-			std::unique_ptr<Statement> pStmt(pConnection->createStatement());
-			pStmt->executeUpdate(Query.c_str());
-			pStmt->close();
-		}
-		catch(SQLException& e)
+	// "Column = Value, ... WHERE ...", the WHERE part tells which rows get updated
+	const char *pWhere = FindWhere(aBuf);
+	const std::string Set(aBuf, pWhere ? pWhere - aBuf : str_length(aBuf));
+	const std::string Where(pWhere ? pWhere : "");
+	const std::string Key = std::string(Table) + Where;
+	const std::string Query("UPDATE " + std::string(Table) + " SET " + std::string(aBuf) + ";");
+	std::vector<std::pair<std::string, std::string>> vAssignments;
+	const bool Literal = ParseLiteralAssignments(Set, vAssignments);
+
+	std::unique_lock<std::mutex> Lock(m_TimerLock);
+	auto It = m_DelayedUpdates.find(Key);
+	if(Milliseconds <= 0)
+	{
+		if(It == m_DelayedUpdates.end())
 		{
-			pError = e.what();
+			Lock.unlock();
+			PushJob(0, [this, Query]() { ExecuteUpdate(Query); });
+			return 0;
 		}
-		SJK.ReleaseConnection(pConnection);
-		m_pDriver->threadEnd();
-		SqlThreadRecursiveLock.unlock();
 
-		if(pError != nullptr)
-			spdlog::error(FMT "{}", pError);
-	});
-	Thread.detach();
+		// the pending one would overwrite this update later, send it first in the same job
+		const std::string Pending = TakeDelayedUpdate(It);
+		Lock.unlock();
+		PushJob(0, [this, Pending, Query]() {
+			ExecuteUpdate(Pending);
+			ExecuteUpdate(Query);
+		});
+		return 0;
+	}
+
+	if(!Literal)
+	{
+		Lock.unlock();
+		return PushJob(Milliseconds, [this, Query]() { ExecuteUpdate(Query); });
+	}
+
+	const int64 Due = TimerTick() + (Milliseconds + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+	// the timer needs its own id to tell whether its UDS was cancelled
+	std::shared_ptr<int64> pID = std::make_shared<int64>(0);
+	const int64 ID = m_Timers.Add(Due, [this, Key, pID]() { RunDelayedUpdate(Key, *pID); });
+	*pID = ID;
+	SDelayedUpdate &Update = m_DelayedUpdates[Key];
+	if(Update.m_vIDs.empty())
+	{
+		Update.m_Table = Table;
+		Update.m_Where = Where;
+	}
+	Update.m_vIDs.push_back(ID);
+	for(const auto &Assignment : vAssignments)
+		Update.m_Columns[Assignment.first].push_back(SDelayedAssignment{ID, Assignment.second});
+	m_DelayedUpdateKeys[ID] = Key;
+	Lock.unlock();
+	m_TimerChanged.notify_one();
+	return ID;
 }
 
 // #####################################################
@@ -288,15 +1131,16 @@ void CConnectionPool::DD(const char *Table, const char *Buffer, ...)
 	va_end(Arguments);
 }
 
-void CConnectionPool::DDS(int Milliseconds, const char *Table, const char *Buffer, ...)
+int64 CConnectionPool::DDS(int Milliseconds, const char *Table, const char *Buffer, ...)
 {
 	va_list Arguments;
 	va_start(Arguments, Buffer);
-	DeleteFormated(Milliseconds, Table, Buffer, Arguments);
+	const int64 ID = DeleteFormated(Milliseconds, Table, Buffer, Arguments);
 	va_end(Arguments);
+	return ID;
 }
 
-void CConnectionPool::DeleteFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args)
+int64 CConnectionPool::DeleteFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args)
 {
 	char aBuf[256];
 	#if defined(CONF_FAMILY_WINDOWS)
@@ -306,34 +1150,7 @@ void CConnectionPool::DeleteFormated(int Milliseconds, const char *Table, const
 	#endif
 	aBuf[sizeof(aBuf) - 1] = '\0';
 	std::string Query("DELETE FROM " + std::string(Table) + " " + std::string(aBuf) + ";");
-	std::thread Thread([this, Query, Milliseconds]()
-	{
-		if(Milliseconds > 0)
-			std::this_thread::sleep_for(std::chrono::milliseconds(Milliseconds));
-
-		const char* pError = nullptr;
-
-		SqlThreadRecursiveLock.lock();
-		m_pDriver->threadInit();
-		Connection* pConnection = SJK.GetConnection();
-		try
-		{
-			std::unique_ptr<Statement> pStmt(pConnection->createStatement());
-			pStmt->executeUpdate(Query.c_str());
-			pStmt->close();
-		}
-		catch (SQLException& e)
-		{
-			pError = e.what();
-		}
-		SJK.ReleaseConnection(pConnection);
-		m_pDriver->threadEnd();
-		SqlThreadRecursiveLock.unlock();
-
-		if(pError != nullptr)
-			spdlog::error(FMT "{}", pError);
-	});
-	Thread.detach();
+	return PushJob(Milliseconds, [this, Query]() { ExecuteUpdate(Query); });
 }
 
 /*
@@ -362,24 +1179,31 @@ ResultPtr CConnectionPool::SSD(const char* Select, const char* Table, const char
 
 	const char* pError = nullptr;
 
-	SqlThreadRecursiveLock.lock();
 	std::string Query("SELECT " + std::string(Select) + " FROM " + std::string(Table) + " " + std::string(aBuf) + ";");
-	m_pDriver->threadInit();
-	Connection* pConnection = SJK.GetConnection();
+	if(!s_IsSqlWorker)
+		m_pBackend->ThreadInit();
+	ISqlConnection *pConnection = GetConnection();
 	ResultPtr pResult = nullptr;
-	try
-	{
-		std::unique_ptr<Statement> pStmt(pConnection->createStatement());
-		pResult.reset(pStmt->executeQuery(Query.c_str()));
-		pStmt->close();
-	}
-	catch(SQLException& e)
+	const int64 Start = time_get();
+	std::string Error;
+	if(!pConnection)
+		CountUnavailable(STAT_SELECT, Query);
+	else
 	{
-		pError = e.what();
+		try
+		{
+			pConnection->Execute(Query, &pResult);
+		}
+		catch(SQLException& e)
+		{
+			Error = e.what();
+			pError = Error.c_str();
+		}
+		CountQuery(STAT_SELECT, Query, Start, pError == nullptr);
 	}
-	SJK.ReleaseConnection(pConnection);
-	m_pDriver->threadEnd();
-	SqlThreadRecursiveLock.unlock();
+	ReleaseConnection(pConnection, pError != nullptr);
+	if(!s_IsSqlWorker)
+		m_pBackend->ThreadEnd();
 
 	if(pError != nullptr)
 		spdlog::error(FMT "{}", pError);
@@ -400,34 +1224,10 @@ void CConnectionPool::ASD(std::function<void(ResultPtr)> func, const char *Selec
 	va_end(VarArgs);
 	aBuf[sizeof(aBuf) - 1] = '\0';
 	const std::string Query("SELECT " + std::string(Select) + " FROM " + std::string(Table) + " " + std::string(aBuf) + ";");
-	std::thread Thread([this, Query, func]()
-	{
-		const char* pError = nullptr;
-
-		SqlThreadRecursiveLock.lock();
-		m_pDriver->threadInit();
-		Connection* pConnection = SJK.GetConnection();
-		try
-		{
-			std::unique_ptr<Statement> pStmt(pConnection->createStatement());
-			ResultPtr pResult(pStmt->executeQuery(Query.c_str()));
-			func(std::move(pResult));
-		}
-		catch(SQLException& e)
-		{
-			pError = e.what();
-		}
-		SJK.ReleaseConnection(pConnection);
-		m_pDriver->threadEnd();
-		SqlThreadRecursiveLock.unlock();
-
-		if(pError != nullptr)
-			spdlog::error(FMT "{}", pError);
-	});
-	Thread.detach();
+	PushJob(0, [this, Query, func]() { ExecuteSelect(Query, func); });
 }
 
-void CConnectionPool::ASDS(int Milliseconds, std::function<void(ResultPtr)> func, const char *Select, const char *Table, const char *Buffer, ...)
+int64 CConnectionPool::ASDS(int Milliseconds, std::function<void(ResultPtr)> func, const char *Select, const char *Table, const char *Buffer, ...)
 {
 	char aBuf[1024];
 	va_list VarArgs;
@@ -440,109 +1240,5 @@ void CConnectionPool::ASDS(int Milliseconds, std::function<void(ResultPtr)> func
 	va_end(VarArgs);
 	aBuf[sizeof(aBuf) - 1] = '\0';
 	const std::string Query("SELECT " + std::string(Select) + " FROM " + std::string(Table) + " " + std::string(aBuf) + ";");
-	std::thread Thread([this, Query, Milliseconds, func]() {
-		if(Milliseconds > 0)
-			std::this_thread::sleep_for(std::chrono::milliseconds(Milliseconds));
-
-		const char *pError = nullptr;
-
-		SqlThreadRecursiveLock.lock();
-		m_pDriver->threadInit();
-		Connection *pConnection = SJK.GetConnection();
-		try
-		{
-			std::unique_ptr<Statement> pStmt(pConnection->createStatement());
-			ResultPtr pResult(pStmt->executeQuery(Query.c_str()));
-			func(std::move(pResult));
-		}
-		catch(SQLException &e)
-		{
-			pError = e.what();
-		}
-		SJK.ReleaseConnection(pConnection);
-		m_pDriver->threadEnd();
-		SqlThreadRecursiveLock.unlock();
-
-		if(pError != nullptr)
-			spdlog::error(FMT "{}", pError);
-	});
-	Thread.detach();
-}
-
-void CConnectionPool::SPS(const char* T, SqlArgs A)
-{
-	const char *pError = nullptr;
-
-	SqlThreadRecursiveLock.lock();
-	m_pDriver->threadInit();
-	Connection *pConnection = SJK.GetConnection();
-	ResultPtr pResult = nullptr;
-	PreparedStatement* pPS;
-
-	// TODO: idiotic way, use boost or fmt eblan
-	std::string QS;
-
-	QS.append("INSERT INTO ");
-	QS.append(T);
-	QS.append("(");
-
-	for (int i = 0; i < A.Size(); i++)
-	{
-		QS.append(A.GetKey(i));
-		if (i + 1 != A.Size())
-		{
-			QS.append(", ");
-		}
-	}
-
-	QS.append(") VALUES (");
-
-	for(int i = 0; i < A.Size(); i++)
-	{
-		if(i + 1 != A.Size())
-		{
-			QS.append("?, ");
-		}
-		else
-		{
-			QS.append("?)");
-		}
-	}
-
-	try
-	{
-		pPS = pConnection->prepareStatement(QS.c_str());
-
-		for (int i = 0; i < A.Size(); i++)
-		{
-			std::any V = A.GetValue(i);
-			if(V.type() == typeid(std::string))
-			{
-				pPS->setString(i + 1, std::any_cast<std::string>(V).c_str());
-			}
-			else if(A.GetValue(i).type() == typeid(std::istream *))
-			{
-				pPS->setBlob(i + 1, std::any_cast<std::istream *>(V));
-			}
-			else if(A.GetValue(i).type() == typeid(int))
-			{
-				pPS->setInt(i + 1, std::any_cast<int>(V));
-			}
-		}
-
-		pPS->execute();
-
-		delete pPS;
-	}
-	catch(SQLException &e)
-	{
-		pError = e.what();
-	}
-
-	SJK.ReleaseConnection(pConnection);
-	m_pDriver->threadEnd();
-	SqlThreadRecursiveLock.unlock();
-
-	if(pError != nullptr)
-		spdlog::error(FMT "{}", pError);
+	return PushJob(Milliseconds, [this, Query, func]() { ExecuteSelect(Query, func); });
 }
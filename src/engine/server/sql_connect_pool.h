@@ -2,100 +2,316 @@
 #define ENGINE_SERVER_SQL_CONNECTIONPOOL_H
 
 #include <boost/scoped_ptr.hpp>
-#include <cppconn/statement.h>
-#include <cppconn/prepared_statement.h>
 
-#include <base/tl/array.h>
+#include <base/system.h>
+#include <engine/shared/timer_wheel.h>
 
+#include "sql_backend.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <list>
 #include <map>
-#include <any>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 using namespace sql;
 #define SJK CConnectionPool::GetInstance()
-typedef std::unique_ptr<ResultSet> ResultPtr;
 
-template <typename T, typename R>
-struct SPseudoMap
+inline SqlValue ToSqlValue(int Value) { return Value; }
+inline SqlValue ToSqlValue(bool Value) { return (int)Value; }
+inline SqlValue ToSqlValue(int64 Value) { return Value; }
+inline SqlValue ToSqlValue(double Value) { return Value; }
+inline SqlValue ToSqlValue(const char *pValue) { return std::string(pValue); }
+inline SqlValue ToSqlValue(const std::string &Value) { return Value; }
+inline SqlValue ToSqlValue(const SqlBlob &Value) { return Value; }
+inline SqlValue ToSqlValue(const SqlValue &Value) { return Value; }
+
+class CConnectionPool 
 {
-	SPseudoMap(int Size)
+	static std::shared_ptr<CConnectionPool> m_Instance;
+
+	static std::mutex ms_CompletionLock;
+	static std::vector<std::function<void()>> ms_vCompletions;
+
+	std::list<ISqlConnection *> m_ConnList;
+	// selected by sv_sql_backend
+	std::unique_ptr<ISqlBackend> m_pBackend;
+	// open connections, idle or in use
+	std::atomic<int> m_NumConnections;
+
+	// Circuit breaker: once connecting fails, queries fail fast and queued jobs wait instead of
+	// stalling their threads. The recovery thread reconnects with exponential backoff, refills
+	// the pool after lost connections and pings idle ones every sv_sql_keepalive seconds.
+	enum
 	{
-		Keys.set_size(Size);
-		Values.set_size(Size);
-	}
+		RECONNECT_MIN_MS = 500,
+		RECONNECT_MAX_MS = 30000,
+	};
+	std::atomic<bool> m_DatabaseDown;
+	std::atomic<int64> m_NumReconnects;
+	std::mutex m_RecoveryLock;
+	std::condition_variable m_RecoveryWake;
+	std::thread m_RecoveryThread;
+	bool m_RecoveryShutdown;
+	bool m_RecoveryPending;
 
-	SPseudoMap() {}
+	void SetDatabaseDown(const char *pError);
+	void WakeRecovery();
+	void RecoveryThread();
+	void PingIdleConnections();
 
-	void Add(T Key, R Value)
+	// fixed set of workers fed from a bounded queue, sized by sv_sql_pool_size and sv_sql_queue_size
+	typedef std::function<void()> FQueryJob;
+	struct SQueuedJob
 	{
-		Keys.add(Key);
-		Values.add(Value);
-	}
+		FQueryJob m_Job;
+		int64 m_QueuedAt;
+	};
+	std::vector<std::thread> m_vWorkers;
+	std::deque<SQueuedJob> m_QueryQueue;
+	std::mutex m_QueueLock;
+	std::condition_variable m_QueueNotEmpty;
+	std::condition_variable m_QueueNotFull;
+	bool m_Shutdown;
 
-	T GetKey(int Index) const
+	// statistics for sql_stats, updated by the workers without taking a lock
+	class CLatency
 	{
-		return Keys[Index];
-	}
+	public:
+		enum
+		{
+			NUM_BUCKETS = 24, // bucket i counts durations below 2^i microseconds, the last one all longer ones
+		};
+		std::atomic<int64> m_aBuckets[NUM_BUCKETS];
+		std::atomic<int64> m_Count;
+		std::atomic<int64> m_TotalMicros;
+		std::atomic<int64> m_MaxMicros;
 
-	R GetValue(int Index) const
+		CLatency();
+		void Add(int64 Micros);
+		// upper bound of the bucket that holds the given percentile
+		int64 Percentile(int Percent) const;
+		void Format(char *pBuffer, int BufferSize) const;
+	};
+
+	enum
 	{
-		return Values[Index];
-	}
+		STAT_SELECT = 0,
+		STAT_WRITE,
+		STAT_BATCH, // statements of buffered writes
+		NUM_STATS
+	};
+	struct SOperationStats
+	{
+		std::atomic<int64> m_Errors;
+		CLatency m_Execution;
+	};
+	SOperationStats m_aStats[NUM_STATS];
+	CLatency m_QueueWait;
+	CLatency m_Callback;
+	std::atomic<int> m_InFlight;
 
-	int Size() const
+	// Start is the time_get() before the query ran, slow queries are logged
+	void CountQuery(int Stat, const std::string &Query, int64 Start, bool Success);
+	void CountCallback(int64 Start);
+	// for queries that did not get a connection because the database is down
+	void CountUnavailable(int Stat, const std::string &Query);
+
+	bool RunPrepared(ISqlConnection *pConnection, int Stat, const std::string &Query, const SqlValues &vValues, ResultPtr *pResult);
+	bool ExecutePrepared(const std::string &Query, const SqlValues &vValues, const std::function<void(ResultPtr)> *pSelectFunc);
+
+	// write-behind buffer, flushed by FlushWrites after sv_sql_flush_interval or sv_sql_flush_size writes
+	struct SBufferedRow
 	{
-		return Keys.size();
-	}
+		std::string m_Table;
+		std::string m_KeyColumn;
+		SqlValue m_Key;
 
-	array<T> Keys;
-	array<R> Values;
-};
+		bool operator<(const SBufferedRow &Other) const
+		{
+			return std::tie(m_Table, m_KeyColumn, m_Key) < std::tie(Other.m_Table, Other.m_KeyColumn, Other.m_Key);
+		}
+	};
+	enum
+	{
+		MAX_INSERT_ROWS = 64, // rows per multi-row INSERT
+	};
+	typedef std::vector<std::pair<std::string, SqlValue>> BufferedColumns;
+	typedef std::vector<std::pair<std::string, SqlValues>> StatementBatch;
+	std::mutex m_WriteLock;
+	std::map<SBufferedRow, BufferedColumns> m_BufferedUpdates;
+	std::map<std::pair<std::string, std::string>, std::vector<SqlValues>> m_BufferedInserts;
+	int m_NumBufferedWrites;
+	int64 m_LastFlush;
 
-typedef SPseudoMap<std::string, std::any> SqlArgs;
+	void BufferUpdateValue(const char *pTable, const char *pKeyColumn, SqlValue Key, const char *pColumn, SqlValue Value);
+	void BufferInsertValues(const char *pTable, const char *pColumns, SqlValues vValues);
+	void ExecuteBatch(const StatementBatch &vStatements);
+	void FlushBufferedWrites(bool Force);
 
-class CConnectionPool 
-{
-	CConnectionPool();
-	
-	static std::shared_ptr<CConnectionPool> m_Instance;
+	// delayed jobs wait in one timer wheel, the timer thread moves them to the worker queue when due
+	enum
+	{
+		TIMER_TICK_MS = 10,
+	};
+	struct SDelayedAssignment
+	{
+		int64 m_ID;
+		std::string m_Value;
+	};
+	struct SDelayedUpdate
+	{
+		std::string m_Table;
+		std::string m_Where;
+		// the timers of all UDS merged into this one, the first one due sends it
+		std::vector<int64> m_vIDs;
+		// every value a column was given in order, the last one that wasn't cancelled is written
+		std::map<std::string, std::vector<SDelayedAssignment>> m_Columns;
+	};
+	std::mutex m_TimerLock;
+	std::condition_variable m_TimerChanged;
+	CTimerWheel m_Timers;
+	std::thread m_TimerThread;
+	bool m_TimerShutdown;
+	// pending UDS keyed by table and WHERE clause, newer updates of the same rows are merged into them
+	std::map<std::string, SDelayedUpdate> m_DelayedUpdates;
+	// the pending update each merged UDS is in
+	std::map<int64, std::string> m_DelayedUpdateKeys;
+
+	static int64 TimerTick();
+	void TimerThread();
+	void RunDelayedUpdate(const std::string &Key, int64 ID);
+	// takes the update out of the pending ones and returns its query
+	std::string TakeDelayedUpdate(std::map<std::string, SDelayedUpdate>::iterator It);
 
-	std::list<class Connection*>m_ConnList;
-	class Driver *m_pDriver;
+	void WorkerThread();
+	// returns the timer id of a delayed job, 0 if it was queued right away
+	int64 PushJob(int Milliseconds, FQueryJob Job);
+	void EnqueueJob(FQueryJob Job);
 
-	void InsertFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args);
-	void UpdateFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args);
-	void DeleteFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args);
+	void ExecuteUpdate(const std::string &Query);
+	void ExecuteSelect(const std::string &Query, const std::function<void(ResultPtr)> &func);
+
+	int64 InsertFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args);
+	int64 UpdateFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args);
+	int64 DeleteFormated(int Milliseconds, const char *Table, const char *Buffer, va_list args);
 
 public:
+	// takes ownership of pBackend, the server uses the instance of GetInstance() instead
+	explicit CConnectionPool(ISqlBackend *pBackend);
 	~CConnectionPool();
 
-	class Connection* GetConnection();
-	class Connection* CreateConnection();
-	void ReleaseConnection(class Connection* pConnection);
-	void DisconnectConnection(class Connection* pConnection);
+	enum
+	{
+		OVERFLOW_WAIT = 0, // block the caller until a worker frees a slot
+		OVERFLOW_SYNC, // run the query on the caller thread
+		OVERFLOW_DROP, // discard the query
+	};
+
+	// returns nullptr while the database is down
+	ISqlConnection *GetConnection();
+	// connects once, returns nullptr and opens the circuit breaker on failure
+	ISqlConnection *CreateConnection();
+	// Failed drops the connection if a query failed because it was lost
+	void ReleaseConnection(ISqlConnection *pConnection, bool Failed = false);
+	void DisconnectConnection(ISqlConnection *pConnection);
 	void DisconnectConnectionHeap();
 	static CConnectionPool& GetInstance();
 
+	// The suspended (...S) variants return a handle for CancelDelayed, 0 if the query was queued right away.
+
 	// simply inserts data
 	void ID(const char *Table, const char *Buffer, ...);
-	void IDS(int Milliseconds, const char *Table, const char *Buffer, ...);
+	int64 IDS(int Milliseconds, const char *Table, const char *Buffer, ...);
 	
 	// simply update the data that will be specified
+	// A UDS that only assigns literals (column = 'text', number or NULL) to rows that already have
+	// such an update pending is merged into it. The merged update runs when the first of them is due,
+	// a later value for a column replaces the earlier one, and CancelDelayed takes back only the
+	// values of the UDS it is given. A UD sends the pending one along right away. Rows are matched
+	// by table and WHERE clause text. Other updates, like a = a + 1, are never merged.
 	void UD(const char *Table, const char *Buffer, ...);
-	void UDS(int Milliseconds, const char *Table, const char *Buffer, ...);
+	int64 UDS(int Milliseconds, const char *Table, const char *Buffer, ...);
 	
 	// simply deletes the data that will be specified
 	void DD(const char *Table, const char *Buffer, ...);
-	void DDS(int Milliseconds, const char *Table, const char *Buffer, ...);
+	int64 DDS(int Milliseconds, const char *Table, const char *Buffer, ...);
 
 	// Synchronous SELECT data
 	ResultPtr SSD(const char *Select, const char *Table, const char *Buffer = "", ...);
-	// Asynchronous SELECT data
+	// Asynchronous SELECT data, func runs on an SQL worker and gets nullptr if the query failed
 	void ASD(std::function<void(ResultPtr)> func, const char *Select, const char *Table, const char *Buffer = "", ...);
 	// Asynchronous SELECT data suspended
-	void ASDS(int Milliseconds, std::function<void(ResultPtr)> func, const char *Select, const char *Table, const char *Buffer = "", ...);
+	int64 ASDS(int Milliseconds, std::function<void(ResultPtr)> func, const char *Select, const char *Table, const char *Buffer = "", ...);
+
+	// drops a suspended query that did not run yet, returns false if it already ran or was cancelled
+	bool CancelDelayed(int64 ID);
+
+	// Prepared statements, every ? in Query is bound from Args in order (ints, strings, SqlBlob).
+	// Statements are cached per connection, so the same query text is only parsed once.
+	// They run on MySQL and SQLite alike, so stick to SQL both of them understand.
+	// Results passed to func are only valid inside func.
+	template<typename... Ts>
+	void PreparedUpdate(const char *pQuery, const Ts &... Args)
+	{
+		std::string Query(pQuery);
+		SqlValues vValues{ToSqlValue(Args)...};
+		PushJob(0, [this, Query, vValues]() { ExecutePrepared(Query, vValues, nullptr); });
+	}
+
+	template<typename... Ts>
+	bool PreparedUpdateSync(const char *pQuery, const Ts &... Args)
+	{
+		return ExecutePrepared(pQuery, SqlValues{ToSqlValue(Args)...}, nullptr);
+	}
+
+	template<typename... Ts>
+	void PreparedSelect(std::function<void(ResultPtr)> func, const char *pQuery, const Ts &... Args)
+	{
+		std::string Query(pQuery);
+		SqlValues vValues{ToSqlValue(Args)...};
+		PushJob(0, [this, Query, vValues, func]() { ExecutePrepared(Query, vValues, &func); });
+	}
+
+	template<typename... Ts>
+	bool PreparedSelectSync(const std::function<void(ResultPtr)> &func, const char *pQuery, const Ts &... Args)
+	{
+		return ExecutePrepared(pQuery, SqlValues{ToSqlValue(Args)...}, &func);
+	}
+
+	// Write-behind, the row is only written on the next flush. Later values for the same
+	// (Table, KeyColumn, Key, Column) replace earlier ones, so a row gets one UPDATE per flush.
+	// Buffered inserts are flushed before buffered updates, don't mix them with direct queries on the same rows.
+	template<typename TKey, typename TValue>
+	void BufferUpdate(const char *pTable, const char *pKeyColumn, const TKey &Key, const char *pColumn, const TValue &Value)
+	{
+		BufferUpdateValue(pTable, pKeyColumn, ToSqlValue(Key), pColumn, ToSqlValue(Value));
+	}
+
+	// Write-behind, rows with the same table and column list are sent as one multi-row INSERT.
+	// pColumns is the comma separated column list, e.g. "UserID, Type, Value"
+	template<typename... Ts>
+	void BufferInsert(const char *pTable, const char *pColumns, const Ts &... Args)
+	{
+		BufferInsertValues(pTable, pColumns, SqlValues{ToSqlValue(Args)...});
+	}
+
+	// one line per statistic, for the sql_stats command
+	static void PrintStats(const std::function<void(const char *pLine)> &Print);
+
+	// sends buffered writes once sv_sql_flush_interval elapsed, Force sends them now (disconnect, shutdown)
+	static void FlushWrites(bool Force);
 
-	void SPS(const char *T, SqlArgs A); // wtf is that, do you really want to use it
+	// hands work from SQL workers back to the game thread, which calls RunCompletions once per tick
+	static void Complete(std::function<void()> Func);
+	static void RunCompletions();
 };
 
 #endif
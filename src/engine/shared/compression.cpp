@@ -4,6 +4,8 @@
 
 #include "compression.h"
 
+#include <cstring>
+
 // Format: ESDDDDDD EDDDDDDD EDD... Extended, Data, Sign
 unsigned char *CVariableInt::Pack(unsigned char *pDst, int i)
 {
@@ -63,12 +65,79 @@ const unsigned char *CVariableInt::Unpack(const unsigned char *pSrc, int *pInOut
 	return pSrc;
 }
 
+// the same format with the bytes of a whole word at once instead of a loop, needs 8 bytes at pDst and pSrc
+static inline unsigned char *PackWord(unsigned char *pDst, int i)
+{
+	const uint64 Sign = (i >> 25) & 0x40;
+	const uint64 Value = i ^ (i >> 31);
+
+	// 6 bits in the first byte, 7 in every other one
+	const int Num = 1 + (Value >= (1 << 6)) + (Value >= (1 << 13)) + (Value >= (1 << 20)) + (Value >= (1 << 27));
+	uint64 Word = Sign | (Value & 0x3f) | ((Value << 2) & 0x7f00) | ((Value << 3) & 0x7f0000) | ((Value << 4) & 0x7f000000) | ((Value << 5) & 0x7f00000000ull);
+	// extend bits on all but the last byte
+	Word |= 0x8080808080ull & ((1ull << ((Num - 1) * 8)) - 1);
+
+	memcpy(pDst, &Word, sizeof(Word)); // not mem_copy, this has to become a single store
+	return pDst + Num;
+}
+
+static inline const unsigned char *UnpackWord(const unsigned char *pSrc, int *pInOut)
+{
+	uint64 Word;
+	memcpy(&Word, pSrc, sizeof(Word)); // a single load
+
+	// the first byte without extend bit ends it, the fifth one always does
+	const unsigned Extend0 = (Word >> 7) & 1;
+	const unsigned Extend1 = Extend0 & (Word >> 15);
+	const unsigned Extend2 = Extend1 & (Word >> 23);
+	const unsigned Extend3 = Extend2 & (Word >> 31);
+	const int Num = 1 + Extend0 + Extend1 + Extend2 + Extend3;
+	Word &= (1ull << (Num * 8)) - 1;
+
+	const int Sign = (Word >> 6) & 1;
+	const unsigned Value = (Word & 0x3f) | ((Word >> 2) & 0x1fc0) | ((Word >> 3) & 0xfe000) | ((Word >> 4) & 0x7f00000) | ((Word >> 5) & 0xf8000000);
+	*pInOut = (int)Value ^ -Sign;
+	return pSrc + Num;
+}
+
+unsigned char *CVariableInt::PackFast(unsigned char *pDst, int i)
+{
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	return PackWord(pDst, i);
+#else
+	return Pack(pDst, i);
+#endif
+}
+
+const unsigned char *CVariableInt::UnpackFast(const unsigned char *pSrc, int *pInOut)
+{
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	return UnpackWord(pSrc, pInOut);
+#else
+	return Unpack(pSrc, pInOut);
+#endif
+}
+
 long CVariableInt::Decompress(const void *pSrc_, int Size, void *pDst_, int DstSize)
 {
 	const unsigned char *pSrc = (unsigned char *)pSrc_;
 	const unsigned char *pEnd = pSrc + Size;
 	int *pDst = (int *)pDst_;
 	int *pDstEnd = pDst + DstSize / 4;
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	// as long as a whole word is left, deltas are mostly zeros and other small values that take a byte
+	while(pEnd - pSrc >= 8 && pDst < pDstEnd)
+	{
+		const int Byte = *pSrc;
+		if(Byte < 0x80)
+		{
+			*pDst++ = (Byte & 0x3f) ^ -(Byte >> 6);
+			pSrc++;
+		}
+		else
+			pSrc = UnpackWord(pSrc, pDst++);
+	}
+#endif
 	while(pSrc < pEnd)
 	{
 		if(pDst >= pDstEnd)
@@ -85,6 +154,17 @@ long CVariableInt::Compress(const void *pSrc_, int Size, void *pDst_, int DstSiz
 	unsigned char *pDst = (unsigned char *)pDst_;
 	unsigned char *pDstEnd = pDst + DstSize;
 	Size /= 4;
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+	// the same with room for a whole word
+	for(; Size && pDstEnd - pDst >= 8; Size--, pSrc++)
+	{
+		const int i = *pSrc;
+		if((unsigned)i + 64 < 128)
+			*pDst++ = ((i >> 25) & 0x40) | ((i ^ (i >> 31)) & 0x3f);
+		else
+			pDst = PackWord(pDst, i);
+	}
+#endif
 	while(Size)
 	{
 		if(pDstEnd - pDst < 6)
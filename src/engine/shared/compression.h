@@ -8,6 +8,10 @@ class CVariableInt
 public:
 	static unsigned char *Pack(unsigned char *pDst, int i);
 	static const unsigned char *Unpack(const unsigned char *pSrc, int *pInOut);
+	// same as Pack and Unpack, but they may touch 8 bytes at pDst and pSrc
+	static unsigned char *PackFast(unsigned char *pDst, int i);
+	static const unsigned char *UnpackFast(const unsigned char *pSrc, int *pInOut);
+	// whole int arrays, Size and DstSize are in bytes
 	static long Compress(const void *pSrc, int Size, void *pDst, int DstSize);
 	static long Decompress(const void *pSrc, int Size, void *pDst, int DstSize);
 };
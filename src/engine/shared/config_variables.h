@@ -15,6 +15,8 @@ MACRO_CONFIG_STR(SvMap, sv_map, 128, "2xp_std", CFGFLAG_SERVER, "Map to use on t
 MACRO_CONFIG_INT(SvMaxClients, sv_max_clients, MAX_CLIENTS, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients that are allowed on a server")
 MACRO_CONFIG_INT(SvMaxClientsPerIP, sv_max_clients_per_ip, 4, 1, MAX_CLIENTS, CFGFLAG_SERVER, "Maximum number of clients with the same IP that can connect to the server")
 MACRO_CONFIG_INT(SvHighBandwidth, sv_high_bandwidth, 1, 0, 1, CFGFLAG_SERVER, "Use high bandwidth mode. Doubles the bandwidth required for the server. LAN use only")
+MACRO_CONFIG_INT(SvNetThread, sv_net_thread, 1, 0, 1, CFGFLAG_SERVER, "Receive and decode packets on a separate thread (needs restart)")
+MACRO_CONFIG_INT(SvSnapThreads, sv_snap_threads, 0, 0, 32, CFGFLAG_SERVER, "Threads that build snapshot deltas, including the main thread (0 = one per core, needs restart)")
 MACRO_CONFIG_INT(SvRegister, sv_register, 1, 0, 1, CFGFLAG_SERVER, "Register server with master server for public listing")
 MACRO_CONFIG_STR(SvRconPassword, sv_rcon_password, 32, "", CFGFLAG_SERVER | CFGFLAG_NONTEEHISTORIC, "Remote console password (full access)")
 MACRO_CONFIG_INT(SvRconMaxTries, sv_rcon_max_tries, 16, 0, 100, CFGFLAG_SERVER, "Maximum number of tries for remote console authentication")
@@ -78,6 +80,7 @@ MACRO_CONFIG_INT(SvVoteVetoTime, sv_vote_veto_time, 20, 0, 1000, CFGFLAG_SERVER,
 MACRO_CONFIG_INT(SvKillDelay, sv_kill_delay, 1, 0, 9999, CFGFLAG_SERVER, "The minimum time in seconds between kills")
 
 MACRO_CONFIG_INT(SvMapWindow, sv_map_window, 15, 0, 100, CFGFLAG_SERVER, "Map downloading send-ahead window")
+MACRO_CONFIG_INT(SvMapWindowMax, sv_map_window_max, 15, 0, 30, CFGFLAG_SERVER, "Largest send-ahead window when it adapts to the connection, starting at sv_map_window (not above it = fixed, large windows can overrun the resend buffer)")
 MACRO_CONFIG_INT(SvFastDownload, sv_fast_download, 1, 0, 1, CFGFLAG_SERVER, "Enables fast download of maps")
 
 #if defined(CONF_UPNP)
@@ -98,6 +101,7 @@ MACRO_CONFIG_INT(SvMaxAfkVoteTime, sv_max_afk_vote_time, 300, 0, 9999, CFGFLAG_S
 MACRO_CONFIG_INT(SvPlasmaRange, sv_plasma_range, 700, 1, 99999, CFGFLAG_SERVER | CFGFLAG_GAME, "How far will the plasma gun track tees")
 MACRO_CONFIG_INT(SvPlasmaPerSec, sv_plasma_per_sec, 3, 0, 50, CFGFLAG_SERVER | CFGFLAG_GAME, "How many shots does the plasma gun fire per seconds")
 MACRO_CONFIG_INT(SvDraggerRange, sv_dragger_range, 700, 1, 99999, CFGFLAG_SERVER | CFGFLAG_GAME, "How far will the dragger track tees")
+MACRO_CONFIG_INT(SvSweptMoveBox, sv_swept_movebox, 0, 0, 1, CFGFLAG_SERVER | CFGFLAG_GAME, "Move tees to the first wall they hit in one go (cheaper, but clients predict slightly different positions)")
 MACRO_CONFIG_INT(SvVotePause, sv_vote_pause, 1, 0, 1, CFGFLAG_SERVER, "Allow voting to pause players (instead of moving to spectators)")
 MACRO_CONFIG_INT(SvVotePauseTime, sv_vote_pause_time, 10, 0, 360, CFGFLAG_SERVER, "The time (in seconds) players have to wait in pause when paused by vote")
 MACRO_CONFIG_INT(SvTuneReset, sv_tune_reset, 1, 0, 1, CFGFLAG_SERVER, "Whether tuning is reset after each map change or not")
@@ -150,12 +154,20 @@ MACRO_CONFIG_INT(DbgFocus, dbg_focus, 0, 0, 1, CFGFLAG_CLIENT, "")
 MACRO_CONFIG_INT(DbgTuning, dbg_tuning, 0, 0, 1, CFGFLAG_CLIENT, "")
 
 // mysql
+MACRO_CONFIG_STR(SvSqlBackend, sv_sql_backend, 16, "mysql", CFGFLAG_SERVER, "Database backend (mysql, sqlite)")
+MACRO_CONFIG_STR(SvSqliteFile, sv_sqlite_file, 128, "2xp.sqlite", CFGFLAG_SERVER, "SQLite database file, used with sv_sql_backend sqlite")
 MACRO_CONFIG_STR(SvMySqlHost, sv_sql_host, 32, "localhost", CFGFLAG_SERVER, "MySQL Host")
 MACRO_CONFIG_STR(SvMySqlDatabase, sv_sql_database, 32, "2xp", CFGFLAG_SERVER, "MySQL Database")
 MACRO_CONFIG_STR(SvMySqlLogin, sv_sql_login, 32, "root", CFGFLAG_SERVER, "MySQL Login")
 MACRO_CONFIG_STR(SvMySqlPassword, sv_sql_password, 32, "root", CFGFLAG_SERVER, "MySQL Password")
 MACRO_CONFIG_INT(SvMySqlPort, sv_sql_port, 3306, 0, 65000, CFGFLAG_SERVER, "MySQL Port")
 MACRO_CONFIG_INT(SvMySqlPoolSize, sv_sql_pool_size, 3, 1, 12, CFGFLAG_SERVER, "MySQL Pool size");
+MACRO_CONFIG_INT(SvMySqlQueueSize, sv_sql_queue_size, 512, 16, 65536, CFGFLAG_SERVER, "Maximum number of queries waiting for a MySQL worker")
+MACRO_CONFIG_INT(SvMySqlQueueOverflow, sv_sql_queue_overflow, 0, 0, 2, CFGFLAG_SERVER, "What to do when the MySQL queue is full (0 = wait, 1 = run on caller thread, 2 = drop query)")
+MACRO_CONFIG_INT(SvMySqlKeepalive, sv_sql_keepalive, 60, 0, 3600, CFGFLAG_SERVER, "Seconds between pings of idle MySQL connections (0 = off)")
+MACRO_CONFIG_INT(SvMySqlSlowQuery, sv_sql_slow_query, 100, 0, 60000, CFGFLAG_SERVER, "Log MySQL queries that take longer than this many milliseconds (0 = off)")
+MACRO_CONFIG_INT(SvMySqlFlushInterval, sv_sql_flush_interval, 1000, 0, 60000, CFGFLAG_SERVER, "Milliseconds buffered MySQL writes are held to merge them (0 = flush every tick)")
+MACRO_CONFIG_INT(SvMySqlFlushSize, sv_sql_flush_size, 256, 1, 8192, CFGFLAG_SERVER, "Number of buffered MySQL writes that triggers a flush")
 
 #if defined(CONF_FAMILY_UNIX)
 MACRO_CONFIG_STR(SvConnLoggingServer, sv_conn_logging_server, 128, "", CFGFLAG_SERVER, "Unix socket server for IP address logging")
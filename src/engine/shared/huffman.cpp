@@ -3,6 +3,8 @@
 #include "huffman.h"
 #include <base/system.h>
 
+#include <cstring>
+
 struct CHuffmanConstructNode
 {
 	unsigned short m_NodeId;
@@ -95,105 +97,81 @@ void CHuffman::ConstructTree(const unsigned *pFrequencies)
 
 void CHuffman::Init(const unsigned *pFrequencies)
 {
-	int i;
-
 	// make sure to cleanout every thing
 	mem_zero(this, sizeof(*this));
 
 	// construct the tree
 	ConstructTree(pFrequencies);
 
-	// build decode LUT
-	for(i = 0; i < HUFFMAN_LUTSIZE; i++)
+	// build decode LUT, every index is the next HUFFMAN_LUTBITS bits of the input
+	for(int i = 0; i < HUFFMAN_LUTSIZE; i++)
 	{
 		unsigned Bits = i;
-		int k;
 		CNode *pNode = m_pStartNode;
+		int k;
 		for(k = 0; k < HUFFMAN_LUTBITS; k++)
 		{
 			pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
 			Bits >>= 1;
-
-			if(!pNode)
-				break;
-
 			if(pNode->m_NumBits)
-			{
-				m_apDecodeLut[i] = pNode;
 				break;
-			}
 		}
 
-		if(k == HUFFMAN_LUTBITS)
-			m_apDecodeLut[i] = pNode;
+		// symbols are the first nodes, so their index is the symbol
+		m_aDecodeLut[i].m_Index = pNode - m_aNodes;
+		m_aDecodeLut[i].m_NumBits = k < HUFFMAN_LUTBITS ? pNode->m_NumBits : 0;
 	}
 }
 
 //***************************************************************
 int CHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
 {
-	// this macro loads a symbol for a byte into bits and bitcount
-#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
-	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
-	Bitcount += m_aNodes[Sym].m_NumBits;
-
-	// this macro writes the symbol stored in bits and bitcount to the dst pointer
-#define HUFFMAN_MACRO_WRITE() \
-	while(Bitcount >= 8) \
-	{ \
-		*pDst++ = (unsigned char)(Bits & 0xff); \
-		if(pDst == pDstEnd) \
-			return -1; \
-		Bits >>= 8; \
-		Bitcount -= 8; \
-	}
-
-	// setup buffer pointers
 	const unsigned char *pSrc = (const unsigned char *)pInput;
 	const unsigned char *pSrcEnd = pSrc + InputSize;
 	unsigned char *pDst = (unsigned char *)pOutput;
 	unsigned char *pDstEnd = pDst + OutputSize;
 
-	// symbol variables
-	unsigned Bits = 0;
+	// codes go in from the bottom, whole words come out when there are enough bits
+	uint64 Bits = 0;
 	unsigned Bitcount = 0;
 
-	// make sure that we have data that we want to compress
-	if(InputSize)
+	for(; pSrc != pSrcEnd; pSrc++)
 	{
-		// {A} load the first symbol
-		int Symbol = *pSrc++;
+		const CNode &Symbol = m_aNodes[*pSrc];
+		Bits |= (uint64)Symbol.m_Bits << Bitcount;
+		Bitcount += Symbol.m_NumBits;
 
-		while(pSrc != pSrcEnd)
+		if(Bitcount >= 32)
 		{
-			// {B} load the symbol
-			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-
-			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
-			Symbol = *pSrc++;
-
-			// {B} write the symbol loaded at
-			HUFFMAN_MACRO_WRITE()
+			// the output always ends with at least one more byte
+			if(pDstEnd - pDst <= 4)
+				return -1;
+			pDst[0] = Bits;
+			pDst[1] = Bits >> 8;
+			pDst[2] = Bits >> 16;
+			pDst[3] = Bits >> 24;
+			pDst += 4;
+			Bits >>= 32;
+			Bitcount -= 32;
 		}
-
-		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
-		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
-		HUFFMAN_MACRO_WRITE()
 	}
 
-	// write EOF symbol
-	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL)
-	HUFFMAN_MACRO_WRITE()
+	// EOF symbol
+	Bits |= (uint64)m_aNodes[HUFFMAN_EOF_SYMBOL].m_Bits << Bitcount;
+	Bitcount += m_aNodes[HUFFMAN_EOF_SYMBOL].m_NumBits;
 
-	// write out the last bits
-	*pDst++ = Bits;
+	// the full bytes and the last bits, a byte of its own even if there are none left
+	const int Left = Bitcount / 8 + 1;
+	if(pDstEnd - pDst < Left)
+		return -1;
+	for(int i = 0; i < Left; i++)
+	{
+		*pDst++ = Bits;
+		Bits >>= 8;
+	}
 
 	// return the size of the output
 	return (int)(pDst - (const unsigned char *)pOutput);
-
-	// remove macros
-#undef HUFFMAN_MACRO_LOADSYMBOL
-#undef HUFFMAN_MACRO_WRITE
 }
 
 //***************************************************************
@@ -201,78 +179,69 @@ int CHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int O
 {
 	// setup buffer pointers
 	unsigned char *pDst = (unsigned char *)pOutput;
-	unsigned char *pSrc = (unsigned char *)pInput;
+	const unsigned char *pSrc = (const unsigned char *)pInput;
 	unsigned char *pDstEnd = pDst + OutputSize;
-	unsigned char *pSrcEnd = pSrc + InputSize;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
 
-	unsigned Bits = 0;
+	// past the end of the input the bits are zero
+	uint64 Bits = 0;
 	unsigned Bitcount = 0;
-
-	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
-	CNode *pNode = 0;
+	const int64 TotalBits = (int64)InputSize * 8;
+	int64 Position = 0;
 
 	while(1)
 	{
-		// {A} try to load a node now, this will reduce dependency at location {D}
-		pNode = 0;
-		if(Bitcount >= HUFFMAN_LUTBITS)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		// {B} fill with new bits
-		while(Bitcount < 24 && pSrc != pSrcEnd)
+		if(Bitcount < 32)
 		{
-			Bits |= (*pSrc++) << Bitcount;
-			Bitcount += 8;
+#if defined(CONF_ARCH_ENDIAN_LITTLE)
+			// a whole word at once, the bytes beyond what fits get loaded again next time
+			if(pSrcEnd - pSrc >= 8)
+			{
+				uint64 Word;
+				memcpy(&Word, pSrc, sizeof(Word)); // not mem_copy, this has to become a single load
+				Bits |= Word << Bitcount;
+				pSrc += (63 - Bitcount) >> 3;
+				Bitcount |= 56;
+			}
+#endif
+			while(Bitcount <= 56 && pSrc != pSrcEnd)
+			{
+				Bits |= (uint64)(*pSrc++) << Bitcount;
+				Bitcount += 8;
+			}
+			if(pSrc == pSrcEnd)
+				Bitcount = 64;
 		}
 
-		// {C} load symbol now if we didn't that earlier at location {A}
-		if(!pNode)
-			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
-
-		if(!pNode)
-			return -1;
-
-		// {D} check if we hit a symbol already
-		if(pNode->m_NumBits)
+		const CDecodeEntry &Entry = m_aDecodeLut[Bits & HUFFMAN_LUTMASK];
+		int Symbol = Entry.m_Index;
+		int NumBits = Entry.m_NumBits;
+		if(!NumBits)
 		{
-			// remove the bits for that symbol
-			Bits >>= pNode->m_NumBits;
-			Bitcount -= pNode->m_NumBits;
+			// longer than the table, walk the tree for the rest
+			const CNode *pNode = &m_aNodes[Entry.m_Index];
+			NumBits = HUFFMAN_LUTBITS;
+			while(!pNode->m_NumBits)
+				pNode = &m_aNodes[pNode->m_aLeafs[(Bits >> NumBits++) & 1]];
+			Symbol = pNode - m_aNodes;
 		}
-		else
-		{
-			// remove the bits that the lut checked up for us
-			Bits >>= HUFFMAN_LUTBITS;
-			Bitcount -= HUFFMAN_LUTBITS;
-
-			// walk the tree bit by bit
-			while(1)
-			{
-				// traverse tree
-				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
 
-				// remove bit
-				Bitcount--;
-				Bits >>= 1;
-
-				// check if we hit a symbol
-				if(pNode->m_NumBits)
-					break;
+		// the old decoder failed when the input ended inside a long code, but not within the first bits of it
+		if(NumBits > HUFFMAN_WALKBITS && Position + HUFFMAN_WALKBITS < TotalBits && TotalBits < Position + NumBits)
+			return -1;
 
-				// no more bits, decoding error
-				if(Bitcount == 0)
-					return -1;
-			}
-		}
+		Bits >>= NumBits;
+		Bitcount -= NumBits;
+		Position += NumBits;
 
 		// check for eof
-		if(pNode == pEof)
+		if(Symbol == HUFFMAN_EOF_SYMBOL)
 			break;
 
 		// output character
 		if(pDst == pDstEnd)
 			return -1;
-		*pDst++ = pNode->m_Symbol;
+		*pDst++ = Symbol;
 	}
 
 	// return the size of the decompressed buffer
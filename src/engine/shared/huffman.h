@@ -12,9 +12,12 @@ class CHuffman
 		HUFFMAN_MAX_SYMBOLS = HUFFMAN_EOF_SYMBOL + 1,
 		HUFFMAN_MAX_NODES = HUFFMAN_MAX_SYMBOLS * 2 - 1,
 
-		HUFFMAN_LUTBITS = 10,
+		HUFFMAN_LUTBITS = 12,
 		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
-		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1),
+
+		// the old decoder only walked the tree after this many bits, its errors depend on it
+		HUFFMAN_WALKBITS = 10,
 	};
 
 	struct CNode
@@ -30,8 +33,15 @@ class CHuffman
 		unsigned char m_Symbol;
 	};
 
+	// a symbol and its length, or the node to walk the tree on from with a length of 0
+	struct CDecodeEntry
+	{
+		unsigned short m_Index;
+		unsigned short m_NumBits;
+	};
+
 	CNode m_aNodes[HUFFMAN_MAX_NODES];
-	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CDecodeEntry m_aDecodeLut[HUFFMAN_LUTSIZE];
 	CNode *m_pStartNode;
 	int m_NumNodes;
 
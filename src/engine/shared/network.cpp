@@ -142,9 +142,9 @@ void CNetBase::SendPacket(NETSOCKET Socket, NETADDR *pAddr, CNetPacketConstruct
 		pPacket->m_DataSize += sizeof(SecurityToken);
 	}
 
-	// compress
-	if(!NoCompress)
-		CompressedSize = ms_Huffman.Compress(pPacket->m_aChunkData, pPacket->m_DataSize, &aBuffer[HeaderSize], NET_MAX_PACKETSIZE - HeaderSize);
+	// compress, giving up as soon as it gets as big as the data itself
+	if(!NoCompress && pPacket->m_DataSize > 1)
+		CompressedSize = ms_Huffman.Compress(pPacket->m_aChunkData, pPacket->m_DataSize, &aBuffer[HeaderSize], minimum(NET_MAX_PACKETSIZE - HeaderSize, pPacket->m_DataSize - 1));
 
 	// check if the compression was enabled, successful and good enough
 	if(!NoCompress && CompressedSize > 0 && CompressedSize < pPacket->m_DataSize)
@@ -307,6 +307,7 @@ class CNetServer
 	NETADDR m_Address;
 	NETSOCKET m_Socket;
 	MMSGS m_MMSGS;
+	NETSENDQUEUE m_SendQueue;
 	class CNetBan *m_pNetBan;
 	CSlot m_aSlots[NET_MAX_CLIENTS];
 	int m_MaxClients;
@@ -330,6 +331,13 @@ class CNetServer
 
 	CNetRecvUnpacker m_RecvUnpacker;
 
+	// receives and decodes on its own thread when started, not touched by the mem_zero in Open
+	class CRecvThread;
+	CRecvThread *m_pRecvThread;
+	void RecvThread();
+	bool DecodePacket(class CRecvPacket *pPacket, const unsigned char *pData, int Bytes);
+	int ProcessPacket(NETADDR &Addr, unsigned char *pData, int Bytes, bool Sixup, SECURITY_TOKEN Token, SECURITY_TOKEN ResponseToken, CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken);
+
 	void OnTokenCtrlMsg(NETADDR &Addr, int ControlMsg, const CNetPacketConstruct &Packet);
 	int OnSixupCtrlMsg(NETADDR &Addr, CNetChunk *pChunk, int ControlMsg, const CNetPacketConstruct &Packet, SECURITY_TOKEN &ResponseToken, SECURITY_TOKEN Token);
 	void OnPreConnMsg(NETADDR &Addr, CNetPacketConstruct &Packet);
@@ -347,14 +355,26 @@ public:
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 	int SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_NEWCLIENT_NOAUTH pfnNewClientNoAuth, NETFUNC_CLIENTREJOIN pfnClientRejoin, NETFUNC_DELCLIENT pfnDelClient, void *pUser);
 
+	CNetServer() :
+		m_pRecvThread(0) {}
+	~CNetServer() { StopRecvThread(); }
+
 	//
 	bool Open(NETADDR BindAddr, class CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, int Flags);
 	int Close();
 
+	// moves receiving, validating and decompressing packets to a thread, Recv then only handles the connections
+	void StartRecvThread();
+	void StopRecvThread();
+	// waits up to Time microseconds for packets, returns true if there are some
+	bool Wait(int Time);
+
 	//
 	int Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken);
 	int Send(CNetChunk *pChunk);
 	int Update();
+	// sends what was queued since the last flush
+	void Flush();
 
 	//
 	int Drop(int ClientID, const char *pReason);
@@ -8,12 +8,18 @@
 #include "config.h"
 #include "netban.h"
 #include "network.h"
+#include "spsc_queue.h"
 #include <engine/message.h>
 #include <engine/shared/protocol.h>
 #include <game/generated/protocol.h>
 
 #include "spdlog/spdlog.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #define FMT "[Network] "
 
 const int DummyMapCrc = 0x6c760ac4;
@@ -50,6 +56,39 @@ static SECURITY_TOKEN ToSecurityToken(const unsigned char *pData)
 	return (int)pData[0] | (pData[1] << 8) | (pData[2] << 16) | (pData[3] << 24);
 }
 
+// a packet as the receive thread hands it over, already unpacked but with the raw data for 0.7 clients
+class CRecvPacket
+{
+public:
+	NETADDR m_Addr;
+	int m_Size;
+	unsigned char m_aData[NET_MAX_PACKETSIZE];
+	bool m_Sixup;
+	SECURITY_TOKEN m_Token;
+	SECURITY_TOKEN m_ResponseToken;
+	CNetPacketConstruct m_Packet;
+};
+
+class CNetServer::CRecvThread
+{
+public:
+	enum
+	{
+		QUEUE_SIZE = 512,
+	};
+
+	CSpscQueue<CRecvPacket, QUEUE_SIZE> m_Queue;
+	// what doesn't fit into the queue is read into here and dropped
+	CRecvPacket m_Dropped;
+	std::atomic<int> m_NumDropped{0};
+	int64 m_LastDropWarning = 0;
+
+	std::thread m_Thread;
+	std::atomic<bool> m_Shutdown{false};
+	std::mutex m_WakeLock;
+	std::condition_variable m_Wake;
+};
+
 bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int MaxClientsPerIP, int Flags)
 {
 	// zero out the whole structure
@@ -80,6 +119,9 @@ bool CNetServer::Open(NETADDR BindAddr, CNetBan *pNetBan, int MaxClients, int Ma
 
 	secure_random_fill(m_aSecurityTokenSeed, sizeof(m_aSecurityTokenSeed));
 
+	// packets go out in one batch per server loop, the connections get the socket with the queue
+	net_udp_set_send_queue(&m_Socket, &m_SendQueue);
+
 	for(auto &Slot : m_aSlots)
 		Slot.m_Connection.Init(m_Socket, true);
 
@@ -109,9 +151,102 @@ int CNetServer::SetCallbacks(NETFUNC_NEWCLIENT pfnNewClient, NETFUNC_NEWCLIENT_N
 int CNetServer::Close()
 {
 	// TODO: implement me
+	StopRecvThread();
+	Flush();
 	return 0;
 }
 
+void CNetServer::StartRecvThread()
+{
+	if(m_pRecvThread)
+		return;
+	m_pRecvThread = new CRecvThread();
+	m_pRecvThread->m_Thread = std::thread(&CNetServer::RecvThread, this);
+}
+
+void CNetServer::StopRecvThread()
+{
+	if(!m_pRecvThread)
+		return;
+	m_pRecvThread->m_Shutdown = true;
+	m_pRecvThread->m_Thread.join();
+	delete m_pRecvThread;
+	m_pRecvThread = 0;
+}
+
+bool CNetServer::Wait(int Time)
+{
+	if(!m_pRecvThread)
+		return net_socket_read_wait(m_Socket, Time) > 0;
+
+	std::unique_lock<std::mutex> Lock(m_pRecvThread->m_WakeLock);
+	return m_pRecvThread->m_Wake.wait_for(Lock, std::chrono::microseconds(Time), [this]() { return !m_pRecvThread->m_Queue.Empty(); });
+}
+
+bool CNetServer::DecodePacket(CRecvPacket *pPacket, const unsigned char *pData, int Bytes)
+{
+	if(Bytes > NET_MAX_PACKETSIZE)
+		return false;
+	if(pData != pPacket->m_aData)
+		mem_copy(pPacket->m_aData, pData, Bytes);
+	pPacket->m_Size = Bytes;
+	pPacket->m_Sixup = false;
+	pPacket->m_ResponseToken = NET_SECURITY_TOKEN_UNKNOWN;
+	if(CNetBase::UnpackPacket(pPacket->m_aData, Bytes, &pPacket->m_Packet, pPacket->m_Sixup, &pPacket->m_Token, &pPacket->m_ResponseToken) != 0)
+		return false;
+
+	// the token only depends on the address, so spoofed 0.7 connless packets stop here
+	if(pPacket->m_Packet.m_Flags & NET_PACKETFLAG_CONNLESS && pPacket->m_Sixup && pPacket->m_Token != GetToken(pPacket->m_Addr))
+		return false;
+	return true;
+}
+
+void CNetServer::RecvThread()
+{
+	CRecvThread *pThread = m_pRecvThread;
+	while(!pThread->m_Shutdown)
+	{
+		// wake up now and then to see if we should stop
+		if(net_socket_read_wait(m_Socket, 100000) <= 0)
+			continue;
+
+		int NumReceived = 0;
+		while(true)
+		{
+			CRecvPacket *pPacket = pThread->m_Queue.BeginPush();
+			CRecvPacket *pTarget = pPacket ? pPacket : &pThread->m_Dropped;
+			unsigned char *pData;
+			const int Bytes = net_udp_recv(m_Socket, &pTarget->m_Addr, pTarget->m_aData, NET_MAX_PACKETSIZE, &m_MMSGS, &pData);
+			if(Bytes <= 0)
+				break;
+
+			// the game thread is behind, better lose packets than make it fall behind further
+			if(!pPacket)
+			{
+				pThread->m_NumDropped++;
+				continue;
+			}
+
+			if(DecodePacket(pPacket, pData, Bytes))
+			{
+				pThread->m_Queue.EndPush();
+				NumReceived++;
+			}
+		}
+
+		if(NumReceived)
+		{
+			std::lock_guard<std::mutex> Lock(pThread->m_WakeLock);
+			pThread->m_Wake.notify_one();
+		}
+	}
+}
+
+void CNetServer::Flush()
+{
+	net_udp_flush(m_Socket);
+}
+
 int CNetServer::Drop(int ClientID, const char *pReason)
 {
 	// TODO: insert lots of checks here
@@ -589,19 +724,39 @@ static bool IsDDNetControlMsg(const CNetPacketConstruct *pPacket)
 	return false;
 }
 
-/*
-	TODO: chopp up this function into smaller working parts
-*/
 int CNetServer::Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken)
 {
 	while(1)
 	{
-		NETADDR Addr;
-
 		// check for a chunk
 		if(m_RecvUnpacker.FetchChunk(pChunk))
 			return 1;
 
+		if(m_pRecvThread)
+		{
+			if(const int NumDropped = m_pRecvThread->m_NumDropped.exchange(0))
+			{
+				if(time_get() > m_pRecvThread->m_LastDropWarning + time_freq())
+				{
+					spdlog::warn(FMT "Receive queue full, dropped {} packets", NumDropped);
+					m_pRecvThread->m_LastDropWarning = time_get();
+				}
+			}
+
+			CRecvPacket *pPacket = m_pRecvThread->m_Queue.Front();
+			if(!pPacket)
+				break;
+
+			// the chunks get unpacked from m_RecvUnpacker, the slot is free again after this
+			mem_copy(&m_RecvUnpacker.m_Data, &pPacket->m_Packet, sizeof(m_RecvUnpacker.m_Data));
+			const int Result = ProcessPacket(pPacket->m_Addr, pPacket->m_aData, pPacket->m_Size, pPacket->m_Sixup, pPacket->m_Token, pPacket->m_ResponseToken, pChunk, pResponseToken);
+			m_pRecvThread->m_Queue.Pop();
+			if(Result)
+				return 1;
+			continue;
+		}
+
+		NETADDR Addr;
 		// TODO: empty the recvinfo
 		unsigned char *pData;
 		int Bytes = net_udp_recv(m_Socket, &Addr, m_RecvUnpacker.m_aBuffer, NET_MAX_PACKETSIZE, &m_MMSGS, &pData);
@@ -610,87 +765,94 @@ int CNetServer::Recv(CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken)
 		if(Bytes <= 0)
 			break;
 
-		// check if we just should drop the packet
-		char aBuf[128];
-		if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
-		{
-			// banned, reply with a message
-			CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1, NET_SECURITY_TOKEN_UNSUPPORTED);
-			continue;
-		}
-
 		SECURITY_TOKEN Token;
+		SECURITY_TOKEN ResponseToken = NET_SECURITY_TOKEN_UNKNOWN;
 		bool Sixup = false;
-		*pResponseToken = NET_SECURITY_TOKEN_UNKNOWN;
-		if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data, Sixup, &Token, pResponseToken) == 0)
+		if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data, Sixup, &Token, &ResponseToken) != 0)
+			continue;
+
+		if(ProcessPacket(Addr, pData, Bytes, Sixup, Token, ResponseToken, pChunk, pResponseToken))
+			return 1;
+	}
+	return 0;
+}
+
+// handles a packet that is unpacked into m_RecvUnpacker.m_Data, returns 1 if pChunk got a chunk
+int CNetServer::ProcessPacket(NETADDR &Addr, unsigned char *pData, int Bytes, bool Sixup, SECURITY_TOKEN Token, SECURITY_TOKEN ResponseToken, CNetChunk *pChunk, SECURITY_TOKEN *pResponseToken)
+{
+	// check if we just should drop the packet
+	char aBuf[128];
+	if(NetBan() && NetBan()->IsBanned(&Addr, aBuf, sizeof(aBuf)))
+	{
+		// banned, reply with a message
+		CNetBase::SendControlMsg(m_Socket, &Addr, 0, NET_CTRLMSG_CLOSE, aBuf, str_length(aBuf) + 1, NET_SECURITY_TOKEN_UNSUPPORTED);
+		return 0;
+	}
+
+	*pResponseToken = ResponseToken;
+	if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_CONNLESS)
+	{
+		if(Sixup && Token != GetToken(Addr))
+			return 0;
+
+		pChunk->m_Flags = NETSENDFLAG_CONNLESS;
+		pChunk->m_ClientID = -1;
+		pChunk->m_Address = Addr;
+		pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
+		pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
+		if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_EXTENDED)
 		{
-			if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_CONNLESS)
-			{
-				if(Sixup && Token != GetToken(Addr))
-					continue;
-
-				pChunk->m_Flags = NETSENDFLAG_CONNLESS;
-				pChunk->m_ClientID = -1;
-				pChunk->m_Address = Addr;
-				pChunk->m_DataSize = m_RecvUnpacker.m_Data.m_DataSize;
-				pChunk->m_pData = m_RecvUnpacker.m_Data.m_aChunkData;
-				if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_EXTENDED)
-				{
-					pChunk->m_Flags |= NETSENDFLAG_EXTENDED;
-					mem_copy(pChunk->m_aExtraData, m_RecvUnpacker.m_Data.m_aExtraData, sizeof(pChunk->m_aExtraData));
-				}
-				return 1;
-			}
-			else
-			{
-				// drop invalid ctrl packets
-				if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_CONTROL &&
-					m_RecvUnpacker.m_Data.m_DataSize == 0)
-					continue;
+			pChunk->m_Flags |= NETSENDFLAG_EXTENDED;
+			mem_copy(pChunk->m_aExtraData, m_RecvUnpacker.m_Data.m_aExtraData, sizeof(pChunk->m_aExtraData));
+		}
+		return 1;
+	}
 
-				// normal packet, find matching slot
-				int Slot = GetClientSlot(Addr);
+	// drop invalid ctrl packets
+	if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_CONTROL &&
+		m_RecvUnpacker.m_Data.m_DataSize == 0)
+		return 0;
 
-				if(!Sixup && Slot != -1 && m_aSlots[Slot].m_Connection.m_Sixup)
-				{
-					Sixup = true;
-					if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data, Sixup, &Token))
-						continue;
-				}
+	// normal packet, find matching slot
+	int Slot = GetClientSlot(Addr);
 
-				if(Slot != -1)
-				{
-					// found
+	if(!Sixup && Slot != -1 && m_aSlots[Slot].m_Connection.m_Sixup)
+	{
+		Sixup = true;
+		if(CNetBase::UnpackPacket(pData, Bytes, &m_RecvUnpacker.m_Data, Sixup, &Token))
+			return 0;
+	}
 
-					// control
-					if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_CONTROL)
-						OnConnCtrlMsg(Addr, Slot, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data);
+	if(Slot != -1)
+	{
+		// found
 
-					if(m_aSlots[Slot].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr, Token))
-					{
-						if(m_RecvUnpacker.m_Data.m_DataSize)
-							m_RecvUnpacker.Start(&Addr, &m_aSlots[Slot].m_Connection, Slot);
-					}
-				}
-				else
-				{
-					// not found, client that wants to connect
-
-					if(Sixup)
-					{
-						// got 0.7 control msg
-						if(OnSixupCtrlMsg(Addr, pChunk, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data, *pResponseToken, Token) == 1)
-							return 1;
-					}
-					else if(IsDDNetControlMsg(&m_RecvUnpacker.m_Data))
-						// got ddnet control msg
-						OnTokenCtrlMsg(Addr, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data);
-					else
-						// got connection-less ctrl or sys msg
-						OnPreConnMsg(Addr, m_RecvUnpacker.m_Data);
-				}
-			}
+		// control
+		if(m_RecvUnpacker.m_Data.m_Flags & NET_PACKETFLAG_CONTROL)
+			OnConnCtrlMsg(Addr, Slot, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data);
+
+		if(m_aSlots[Slot].m_Connection.Feed(&m_RecvUnpacker.m_Data, &Addr, Token))
+		{
+			if(m_RecvUnpacker.m_Data.m_DataSize)
+				m_RecvUnpacker.Start(&Addr, &m_aSlots[Slot].m_Connection, Slot);
+		}
+	}
+	else
+	{
+		// not found, client that wants to connect
+
+		if(Sixup)
+		{
+			// got 0.7 control msg
+			if(OnSixupCtrlMsg(Addr, pChunk, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data, *pResponseToken, Token) == 1)
+				return 1;
 		}
+		else if(IsDDNetControlMsg(&m_RecvUnpacker.m_Data))
+			// got ddnet control msg
+			OnTokenCtrlMsg(Addr, m_RecvUnpacker.m_Data.m_aChunkData[0], m_RecvUnpacker.m_Data);
+		else
+			// got connection-less ctrl or sys msg
+			OnPreConnMsg(Addr, m_RecvUnpacker.m_Data);
 	}
 	return 0;
 }
@@ -28,6 +28,18 @@ void CPacker::AddInt(int i)
 		m_pCurrent = CVariableInt::Pack(m_pCurrent, i);
 }
 
+void CPacker::AddInts(const int *pInts, int Num)
+{
+	if(m_Error)
+		return;
+
+	const long Size = CVariableInt::Compress(pInts, Num * sizeof(int), m_pCurrent, m_pEnd - m_pCurrent);
+	if(Size < 0)
+		m_Error = 1;
+	else
+		m_pCurrent += Size;
+}
+
 void CPacker::AddString(const char *pStr, int Limit)
 {
 	if(m_Error)
@@ -111,6 +123,19 @@ int CUnpacker::GetInt()
 	return i;
 }
 
+void CUnpacker::GetInts(int *pInts, int Num)
+{
+	// an int is at most 5 bytes, with 8 left it can't run over the end
+	int i = 0;
+	if(!m_Error)
+	{
+		for(; i < Num && m_pEnd - m_pCurrent >= 8; i++)
+			m_pCurrent = CVariableInt::UnpackFast(m_pCurrent, &pInts[i]);
+	}
+	for(; i < Num; i++)
+		pInts[i] = GetInt();
+}
+
 int CUnpacker::GetIntOrDefault(int Default)
 {
 	if(m_Error)
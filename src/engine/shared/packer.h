@@ -20,6 +20,8 @@ private:
 public:
 	void Reset();
 	void AddInt(int i);
+	// like AddInt for every one of them
+	void AddInts(const int *pInts, int Num);
 	void AddString(const char *pStr, int Limit);
 	void AddRaw(const void *pData, int Size);
 
@@ -45,6 +47,8 @@ public:
 
 	void Reset(const void *pData, int Size);
 	int GetInt();
+	// like GetInt for every one of them
+	void GetInts(int *pInts, int Num);
 	int GetIntOrDefault(int Default);
 	const char *GetString(int SanitizeType = SANITIZE);
 	const unsigned char *GetRaw(int Size);
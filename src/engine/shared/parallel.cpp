@@ -0,0 +1,79 @@
+#include "parallel.h"
+
+CParallelFor::CParallelFor() :
+	m_Shutdown(false), m_Generation(0), m_NumBusy(0), m_pTask(nullptr), m_NumTasks(0)
+{
+	m_NextTask = 0;
+}
+
+CParallelFor::~CParallelFor()
+{
+	{
+		std::unique_lock<std::mutex> Lock(m_Lock);
+		m_Shutdown = true;
+	}
+	m_Start.notify_all();
+	for(auto &Thread : m_vThreads)
+		Thread.join();
+}
+
+void CParallelFor::Init(int NumThreads)
+{
+	for(int i = 0; i < NumThreads; i++)
+		m_vThreads.emplace_back(&CParallelFor::WorkerThread, this);
+}
+
+void CParallelFor::RunTasks()
+{
+	for(int Task = m_NextTask++; Task < m_NumTasks; Task = m_NextTask++)
+		(*m_pTask)(Task);
+}
+
+void CParallelFor::Run(int NumTasks, const FTask &Task)
+{
+	// waking the threads costs more than a single task
+	if(m_vThreads.empty() || NumTasks <= 1)
+	{
+		for(int i = 0; i < NumTasks; i++)
+			Task(i);
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> Lock(m_Lock);
+		m_pTask = &Task;
+		m_NumTasks = NumTasks;
+		m_NextTask = 0;
+		m_NumBusy = m_vThreads.size();
+		m_Generation++;
+	}
+	m_Start.notify_all();
+
+	RunTasks();
+
+	// Task has to outlive every thread that might still look at it
+	std::unique_lock<std::mutex> Lock(m_Lock);
+	m_Done.wait(Lock, [this]() { return m_NumBusy == 0; });
+	m_pTask = nullptr;
+}
+
+void CParallelFor::WorkerThread()
+{
+	int64 Generation = 0;
+	while(true)
+	{
+		{
+			std::unique_lock<std::mutex> Lock(m_Lock);
+			m_Start.wait(Lock, [this, Generation]() { return m_Shutdown || m_Generation != Generation; });
+			if(m_Shutdown)
+				break;
+			Generation = m_Generation;
+		}
+
+		RunTasks();
+
+		std::unique_lock<std::mutex> Lock(m_Lock);
+		if(--m_NumBusy == 0)
+			m_Done.notify_one();
+	}
+}
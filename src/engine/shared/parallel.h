@@ -0,0 +1,50 @@
+#ifndef ENGINE_SHARED_PARALLEL_H
+#define ENGINE_SHARED_PARALLEL_H
+
+#include <base/system.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Fork-join helper for work that has to be finished within a tick, unlike CJobPool
+	which is meant for background jobs. Run hands out the tasks to the threads and
+	the calling thread, and returns once all of them are done.
+*/
+class CParallelFor
+{
+public:
+	typedef std::function<void(int Task)> FTask;
+
+	CParallelFor();
+	~CParallelFor();
+
+	// NumThreads helpers besides the caller, 0 runs everything on the caller
+	void Init(int NumThreads);
+	int NumThreads() const { return m_vThreads.size(); }
+
+	// calls Task(0) ... Task(NumTasks - 1) in no particular order
+	void Run(int NumTasks, const FTask &Task);
+
+private:
+	std::vector<std::thread> m_vThreads;
+	std::mutex m_Lock;
+	std::condition_variable m_Start;
+	std::condition_variable m_Done;
+	bool m_Shutdown;
+	int64 m_Generation;
+	int m_NumBusy;
+
+	const FTask *m_pTask;
+	int m_NumTasks;
+	std::atomic<int> m_NextTask;
+
+	void WorkerThread();
+	void RunTasks();
+};
+
+#endif
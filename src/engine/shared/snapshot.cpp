@@ -3,12 +3,18 @@
 #include "snapshot.h"
 #include "compression.h"
 #include "uuid_manager.h"
+#include <base/math.h>
 
 #include <game/generated/protocol.h>
 #include <game/generated/protocolglue.h>
 
 #include "spdlog/spdlog.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SNAPSHOT_SSE2
+#endif
+
 #define FMT "[Snapshot] "
 
 // CSnapshot
@@ -93,54 +99,93 @@ void CSnapshot::DebugDump()
 
 // CSnapshotDelta
 
-struct CItemList
-{
-	int m_Num;
-	int m_aKeys[64];
-	int m_aIndex[64];
-};
-
-enum
+// key -> item index with linear probing, sized to the snapshot so building it costs little
+class CItemIndex
 {
-	HASHLIST_SIZE = 256,
-};
-
-static void GenerateHash(CItemList *pHashlist, CSnapshot *pSnapshot)
-{
-	for(int i = 0; i < HASHLIST_SIZE; i++)
-		pHashlist[i].m_Num = 0;
-
-	for(int i = 0; i < pSnapshot->NumItems(); i++)
+	enum
 	{
-		int Key = pSnapshot->GetItem(i)->Key();
-		int HashID = ((Key >> 12) & 0xf0) | (Key & 0xf);
-		if(pHashlist[HashID].m_Num != 64)
+		MAX_ITEMS = 1024, // as many as CSnapshotBuilder makes
+		MAX_SLOTS = MAX_ITEMS * 2,
+		NUM_BUCKETS = 256, // of the hash list CreateDelta used before
+		BUCKET_SIZE = 64,
+	};
+	int m_aKeys[MAX_SLOTS];
+	int m_aIndices[MAX_SLOTS];
+	int m_Shift;
+	int m_Mask;
+
+	int Slot(int Key) const { return ((unsigned)Key * 2654435761u) >> m_Shift; }
+
+public:
+	// Limited skips the items the old hash list had no room for, keys that appear
+	// more than once are found at their first index either way
+	void Build(const CSnapshot *pSnapshot, bool Limited)
+	{
+		const int NumItems = minimum(pSnapshot->NumItems(), (int)MAX_ITEMS);
+		int Bits = 4;
+		while((1 << Bits) < NumItems * 2)
+			Bits++;
+		m_Shift = 32 - Bits;
+		m_Mask = (1 << Bits) - 1;
+		for(int i = 0; i <= m_Mask; i++)
+			m_aIndices[i] = -1;
+
+		unsigned char aBucketSizes[NUM_BUCKETS];
+		if(Limited)
+			mem_zero(aBucketSizes, sizeof(aBucketSizes));
+
+		for(int i = 0; i < NumItems; i++)
 		{
-			pHashlist[HashID].m_aIndex[pHashlist[HashID].m_Num] = i;
-			pHashlist[HashID].m_aKeys[pHashlist[HashID].m_Num] = Key;
-			pHashlist[HashID].m_Num++;
+			const int Key = pSnapshot->GetItem(i)->Key();
+			if(Limited)
+			{
+				const int Bucket = ((Key >> 12) & 0xf0) | (Key & 0xf);
+				if(aBucketSizes[Bucket] == BUCKET_SIZE)
+					continue;
+				aBucketSizes[Bucket]++;
+			}
+
+			int Slot = this->Slot(Key);
+			while(m_aIndices[Slot] != -1)
+				Slot = (Slot + 1) & m_Mask;
+			m_aKeys[Slot] = Key;
+			m_aIndices[Slot] = i;
 		}
 	}
-}
 
-static int GetItemIndexHashed(int Key, const CItemList *pHashlist)
-{
-	int HashID = ((Key >> 12) & 0xf0) | (Key & 0xf);
-	for(int i = 0; i < pHashlist[HashID].m_Num; i++)
+	int Find(int Key) const
 	{
-		if(pHashlist[HashID].m_aKeys[i] == Key)
-			return pHashlist[HashID].m_aIndex[i];
+		for(int Slot = this->Slot(Key); m_aIndices[Slot] != -1; Slot = (Slot + 1) & m_Mask)
+		{
+			if(m_aKeys[Slot] == Key)
+				return m_aIndices[Slot];
+		}
+		return -1;
 	}
-
-	return -1;
-}
+};
 
 int CSnapshotDelta::DiffItem(int *pPast, int *pCurrent, int *pOut, int Size)
 {
 	int Needed = 0;
+#if defined(SNAPSHOT_SSE2)
+	// four ints at a time, the rest of the item below
+	__m128i Changed = _mm_setzero_si128();
+	for(; Size >= 4; Size -= 4)
+	{
+		const __m128i Diff = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)pCurrent), _mm_loadu_si128((const __m128i *)pPast));
+		_mm_storeu_si128((__m128i *)pOut, Diff);
+		Changed = _mm_or_si128(Changed, Diff);
+		pOut += 4;
+		pPast += 4;
+		pCurrent += 4;
+	}
+	Changed = _mm_or_si128(Changed, _mm_shuffle_epi32(Changed, _MM_SHUFFLE(1, 0, 3, 2)));
+	Changed = _mm_or_si128(Changed, _mm_shuffle_epi32(Changed, _MM_SHUFFLE(2, 3, 0, 1)));
+	Needed = _mm_cvtsi128_si32(Changed);
+#endif
 	while(Size)
 	{
-		*pOut = *pCurrent - *pPast;
+		*pOut = (int)((unsigned)*pCurrent - (unsigned)*pPast);
 		Needed |= *pOut;
 		pOut++;
 		pPast++;
@@ -162,7 +207,7 @@ void CSnapshotDelta::UndiffItem(int *pPast, int *pDiff, int *pOut, int Size)
 		else
 		{
 			unsigned char aBuf[16];
-			unsigned char *pEnd = CVariableInt::Pack(aBuf, *pDiff);
+			unsigned char *pEnd = CVariableInt::PackFast(aBuf, *pDiff);
 			m_aSnapshotDataRate[m_SnapshotCurrent] += (int)(pEnd - (unsigned char *)aBuf) * 8;
 		}
 
@@ -203,7 +248,6 @@ CSnapshotDelta::CData *CSnapshotDelta::EmptyDelta()
 	return &m_Empty;
 }
 
-// TODO: OPT: this should be made much faster
 int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData)
 {
 	CData *pDelta = (CData *)pDstData;
@@ -218,14 +262,17 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 	pDelta->m_NumUpdateItems = 0;
 	pDelta->m_NumTempItems = 0;
 
-	CItemList aHashlist[HASHLIST_SIZE];
-	GenerateHash(aHashlist, pTo);
+	// limited like the old hash lists, so the delta stays the same byte for byte
+	CItemIndex ToIndex;
+	CItemIndex FromIndex;
+	ToIndex.Build(pTo, true);
+	FromIndex.Build(pFrom, true);
 
 	// pack deleted stuff
 	for(i = 0; i < pFrom->NumItems(); i++)
 	{
 		pFromItem = pFrom->GetItem(i);
-		if(GetItemIndexHashed(pFromItem->Key(), aHashlist) == -1)
+		if(ToIndex.Find(pFromItem->Key()) == -1)
 		{
 			// deleted
 			pDelta->m_NumDeletedItems++;
@@ -234,24 +281,13 @@ int CSnapshotDelta::CreateDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData
 		}
 	}
 
-	GenerateHash(aHashlist, pFrom);
-	int aPastIndices[1024];
-
-	// fetch previous indices
-	// we do this as a separate pass because it helps the cache
 	const int NumItems = pTo->NumItems();
-	for(i = 0; i < NumItems; i++)
-	{
-		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		aPastIndices[i] = GetItemIndexHashed(pCurItem->Key(), aHashlist); // O(n) .. O(n^n)
-	}
-
 	for(i = 0; i < NumItems; i++)
 	{
 		// do delta
-		ItemSize = pTo->GetItemSize(i); // O(1) .. O(n)
-		pCurItem = pTo->GetItem(i); // O(1) .. O(n)
-		PastIndex = aPastIndices[i];
+		ItemSize = pTo->GetItemSize(i);
+		pCurItem = pTo->GetItem(i);
+		PastIndex = FromIndex.Find(pCurItem->Key());
 
 		bool IncludeSize = pCurItem->Type() >= MAX_NETOBJSIZES || !m_aItemSizes[pCurItem->Type()];
 
@@ -317,6 +353,9 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 	Builder.Init();
 
+	CItemIndex Index;
+	Index.Build(pFrom, false);
+
 	// unpack deleted stuff
 	pDeleted = pData;
 	pData += pDelta->m_NumDeletedItems;
@@ -384,7 +423,7 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 		if(!pNewData)
 			return -4;
 
-		FromIndex = pFrom->GetItemIndex(Key);
+		FromIndex = Index.Find(Key);
 		if(FromIndex != -1)
 		{
 			// we got an update so we need pTo apply the diff
@@ -407,112 +446,155 @@ int CSnapshotDelta::UnpackDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pSrcData
 
 // CSnapshotStorage
 
+CSnapshotStorage::CSnapshotStorage() :
+	m_pArena(0), m_ArenaSize(0)
+{
+	Init();
+}
+
+CSnapshotStorage::~CSnapshotStorage()
+{
+	free(m_pArena);
+}
+
 void CSnapshotStorage::Init()
 {
-	m_pFirst = 0;
-	m_pLast = 0;
+	m_Head = 0;
+	m_Tail = 0;
+	m_Wrap = -1;
+	m_NumHolders = 0;
+	for(int &Offset : m_aIndex)
+		Offset = -1;
 }
 
 void CSnapshotStorage::PurgeAll()
 {
-	CHolder *pHolder = m_pFirst;
-	CHolder *pNext;
+	// the arena is kept for the next snapshots
+	Init();
+}
+
+void CSnapshotStorage::PurgeOldest()
+{
+	CHolder *pHolder = Holder(m_Head);
+	int &Index = m_aIndex[pHolder->m_Tick & (MAX_TICKS - 1)];
+	if(Index == m_Head)
+		Index = -1;
 
-	while(pHolder)
+	m_Head += pHolder->m_Size;
+	if(m_Head == m_Wrap)
 	{
-		pNext = pHolder->m_pNext;
-		free(pHolder);
-		pHolder = pNext;
+		m_Head = 0;
+		m_Wrap = -1;
 	}
-
-	// no more snapshots in storage
-	m_pFirst = 0;
-	m_pLast = 0;
+	if(--m_NumHolders == 0)
+		Init();
 }
 
 void CSnapshotStorage::PurgeUntil(int Tick)
 {
-	CHolder *pHolder = m_pFirst;
-	CHolder *pNext;
+	while(m_NumHolders && Holder(m_Head)->m_Tick < Tick)
+		PurgeOldest();
+}
 
-	while(pHolder)
+int CSnapshotStorage::Allocate(int Size)
+{
+	int Offset = -1;
+	if(m_Wrap < 0)
 	{
-		pNext = pHolder->m_pNext;
-		if(pHolder->m_Tick >= Tick)
-			return; // no more to remove
-		free(pHolder);
+		// the holders are in one piece, append or start again at the front
+		if(m_Tail + Size <= m_ArenaSize)
+			Offset = m_Tail;
+		else if(Size <= m_Head)
+		{
+			m_Wrap = m_Tail;
+			Offset = 0;
+		}
+	}
+	else if(m_Tail + Size <= m_Head)
+		Offset = m_Tail;
 
-		// did we come to the end of the list?
-		if(!pNext)
-			break;
+	if(Offset >= 0)
+		m_Tail = Offset + Size;
+	return Offset;
+}
 
-		m_pFirst = pNext;
-		pNext->m_pPrev = 0x0;
+void CSnapshotStorage::Grow(int Size)
+{
+	const int NewSize = maximum(maximum(m_ArenaSize * 2, m_ArenaSize + Size), 64 * 1024);
+	char *pNewArena = (char *)malloc(NewSize);
 
-		pHolder = pNext;
+	// copy the holders over in order, so they are in one piece again
+	int NewTail = 0;
+	for(int i = 0; i < MAX_TICKS; i++)
+		m_aIndex[i] = -1;
+	for(int Offset = m_Head, i = 0; i < m_NumHolders; i++)
+	{
+		CHolder *pHolder = Holder(Offset);
+		mem_copy(pNewArena + NewTail, pHolder, pHolder->m_Size);
+		m_aIndex[pHolder->m_Tick & (MAX_TICKS - 1)] = NewTail;
+		NewTail += pHolder->m_Size;
+
+		Offset += pHolder->m_Size;
+		if(Offset == m_Wrap)
+			Offset = 0;
 	}
 
-	// no more snapshots in storage
-	m_pFirst = 0;
-	m_pLast = 0;
+	free(m_pArena);
+	m_pArena = pNewArena;
+	m_ArenaSize = NewSize;
+	m_Head = 0;
+	m_Tail = NewTail;
+	m_Wrap = -1;
 }
 
 void CSnapshotStorage::Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt)
 {
-	// allocate memory for holder + snapshot_data
-	int TotalSize = sizeof(CHolder) + DataSize;
+	// holder + snapshot_data
+	const int Size = ((int)sizeof(CHolder) + DataSize * (CreateAlt ? 2 : 1) + 7) & ~7;
 
-	if(CreateAlt)
-		TotalSize += DataSize;
+	// a snapshot MAX_TICKS older has the same slot, drop it and everything before
+	const int Slot = Tick & (MAX_TICKS - 1);
+	if(m_aIndex[Slot] >= 0)
+		PurgeUntil(Holder(m_aIndex[Slot])->m_Tick + 1);
 
-	CHolder *pHolder = (CHolder *)malloc(TotalSize);
+	int Offset = Allocate(Size);
+	if(Offset < 0)
+	{
+		Grow(Size);
+		Offset = Allocate(Size);
+	}
 
-	// set data
+	CHolder *pHolder = Holder(Offset);
 	pHolder->m_Tick = Tick;
 	pHolder->m_Tagtime = Tagtime;
 	pHolder->m_SnapSize = DataSize;
-	pHolder->m_pSnap = (CSnapshot *)(pHolder + 1);
-	mem_copy(pHolder->m_pSnap, pData, DataSize);
-
+	pHolder->m_Size = Size;
+	pHolder->m_HasAlt = CreateAlt;
+	mem_copy(pHolder->Snap(), pData, DataSize);
 	if(CreateAlt) // create alternative if wanted
-	{
-		pHolder->m_pAltSnap = (CSnapshot *)(((char *)pHolder->m_pSnap) + DataSize);
-		mem_copy(pHolder->m_pAltSnap, pData, DataSize);
-	}
-	else
-		pHolder->m_pAltSnap = 0;
+		mem_copy(pHolder->AltSnap(), pData, DataSize);
 
-	// link
-	pHolder->m_pNext = 0;
-	pHolder->m_pPrev = m_pLast;
-	if(m_pLast)
-		m_pLast->m_pNext = pHolder;
-	else
-		m_pFirst = pHolder;
-	m_pLast = pHolder;
+	m_aIndex[Slot] = Offset;
+	m_NumHolders++;
 }
 
 int CSnapshotStorage::Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData)
 {
-	CHolder *pHolder = m_pFirst;
-
-	while(pHolder)
-	{
-		if(pHolder->m_Tick == Tick)
-		{
-			if(pTagtime)
-				*pTagtime = pHolder->m_Tagtime;
-			if(ppData)
-				*ppData = pHolder->m_pSnap;
-			if(ppAltData)
-				*ppAltData = pHolder->m_pAltSnap;
-			return pHolder->m_SnapSize;
-		}
+	const int Offset = m_aIndex[Tick & (MAX_TICKS - 1)];
+	if(Offset < 0)
+		return -1;
 
-		pHolder = pHolder->m_pNext;
-	}
+	CHolder *pHolder = Holder(Offset);
+	if(pHolder->m_Tick != Tick)
+		return -1;
 
-	return -1;
+	if(pTagtime)
+		*pTagtime = pHolder->m_Tagtime;
+	if(ppData)
+		*ppData = pHolder->Snap();
+	if(ppAltData)
+		*ppAltData = pHolder->AltSnap();
+	return pHolder->m_SnapSize;
 }
 
 // CSnapshotBuilder
@@ -93,33 +93,52 @@ public:
 
 // CSnapshotStorage
 
+// Snapshots in tick order, kept in one ring of bytes that only grows to the largest history
+// seen, so adding and purging don't allocate once it is big enough. Get is a lookup by tick.
 class CSnapshotStorage
 {
 public:
-	class CHolder
+	enum
 	{
-	public:
-		CHolder *m_pPrev;
-		CHolder *m_pNext;
-
-		int64 m_Tagtime;
-		int m_Tick;
-
-		int m_SnapSize;
-		CSnapshot *m_pSnap;
-		CSnapshot *m_pAltSnap;
+		MAX_TICKS = 256, // older snapshots are dropped when a newer one would take their slot
 	};
 
-	CHolder *m_pFirst;
-	CHolder *m_pLast;
-
-	CSnapshotStorage() { Init(); };
-	~CSnapshotStorage() { PurgeAll(); };
+	CSnapshotStorage();
+	~CSnapshotStorage();
+	CSnapshotStorage(const CSnapshotStorage &) = delete;
+	CSnapshotStorage &operator=(const CSnapshotStorage &) = delete;
 	void Init();
 	void PurgeAll();
 	void PurgeUntil(int Tick);
 	void Add(int Tick, int64 Tagtime, int DataSize, void *pData, int CreateAlt);
 	int Get(int Tick, int64 *pTagtime, CSnapshot **ppData, CSnapshot **ppAltData);
+
+private:
+	class CHolder
+	{
+	public:
+		int64 m_Tagtime;
+		int m_Tick;
+		int m_SnapSize;
+		int m_Size; // holder and snapshots, rounded up so the next holder stays aligned
+		bool m_HasAlt;
+
+		CSnapshot *Snap() { return (CSnapshot *)(this + 1); }
+		CSnapshot *AltSnap() { return m_HasAlt ? (CSnapshot *)((char *)Snap() + m_SnapSize) : 0; }
+	};
+
+	char *m_pArena;
+	int m_ArenaSize;
+	int m_Head; // oldest holder
+	int m_Tail; // end of the newest holder
+	int m_Wrap; // end of the older part once the holders wrapped around, -1 before that
+	int m_NumHolders;
+	int m_aIndex[MAX_TICKS]; // offset of the holder of Tick % MAX_TICKS, -1 if there is none
+
+	CHolder *Holder(int Offset) { return (CHolder *)(m_pArena + Offset); }
+	int Allocate(int Size);
+	void Grow(int Size);
+	void PurgeOldest();
 };
 
 class CSnapshotBuilder
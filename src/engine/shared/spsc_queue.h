@@ -0,0 +1,45 @@
+#ifndef ENGINE_SHARED_SPSC_QUEUE_H
+#define ENGINE_SHARED_SPSC_QUEUE_H
+
+#include <atomic>
+
+/*
+	Bounded queue between one producer and one consumer thread, without locks.
+	Items stay in place: the producer fills the slot from BeginPush and
+	publishes it with EndPush, the consumer reads Front and frees it with Pop.
+*/
+template<class T, unsigned Size>
+class CSpscQueue
+{
+	static_assert((Size & (Size - 1)) == 0, "Size has to be a power of two");
+
+	T m_aItems[Size];
+	// free running counters, only their difference and the low bits matter
+	alignas(64) std::atomic<unsigned> m_Head{0}; // written by the consumer
+	alignas(64) std::atomic<unsigned> m_Tail{0}; // written by the producer
+
+public:
+	// producer, returns nullptr if the queue is full
+	T *BeginPush()
+	{
+		const unsigned Tail = m_Tail.load(std::memory_order_relaxed);
+		if(Tail - m_Head.load(std::memory_order_acquire) == Size)
+			return nullptr;
+		return &m_aItems[Tail & (Size - 1)];
+	}
+	void EndPush() { m_Tail.store(m_Tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	// consumer, returns nullptr if the queue is empty
+	T *Front()
+	{
+		const unsigned Head = m_Head.load(std::memory_order_relaxed);
+		if(Head == m_Tail.load(std::memory_order_acquire))
+			return nullptr;
+		return &m_aItems[Head & (Size - 1)];
+	}
+	void Pop() { m_Head.store(m_Head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+	bool Empty() const { return m_Head.load(std::memory_order_acquire) == m_Tail.load(std::memory_order_acquire); }
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "timer_wheel.h"
+
+#include <base/math.h>
+
+#include <algorithm>
+
+CTimerWheel::CTimerWheel(int64 Now) :
+	m_Now(Now), m_NextID(1), m_NumLevel0(0)
+{
+}
+
+int64 CTimerWheel::Add(int64 Due, FTimer Func)
+{
+	const int64 ID = m_NextID++;
+	m_Timers[ID] = STimer{Due, std::move(Func)};
+	Insert(ID, Due);
+	return ID;
+}
+
+bool CTimerWheel::Cancel(int64 ID)
+{
+	return m_Timers.erase(ID) != 0;
+}
+
+void CTimerWheel::Insert(int64 ID, int64 Due)
+{
+	// due timers fire on the next tick, far ones get inserted again when they come up
+	Due = clamp(Due, m_Now + 1, m_Now + MAX_DELAY - 1);
+	const int64 Delta = Due - m_Now;
+	if(Delta < (1 << LEVEL0_BITS))
+	{
+		m_aLevel0[Due & ((1 << LEVEL0_BITS) - 1)].push_back(ID);
+		m_NumLevel0++;
+		return;
+	}
+
+	int Level = 1;
+	while(Level < NUM_LEVELS - 1 && Delta >= ((int64)1 << Shift(Level + 1)))
+		Level++;
+	m_aaLevels[Level - 1][(Due >> Shift(Level)) & ((1 << LEVEL_BITS) - 1)].push_back(ID);
+}
+
+void CTimerWheel::Cascade(int Level)
+{
+	std::vector<int64> vIDs;
+	vIDs.swap(m_aaLevels[Level - 1][(m_Now >> Shift(Level)) & ((1 << LEVEL_BITS) - 1)]);
+	for(int64 ID : vIDs)
+	{
+		auto It = m_Timers.find(ID);
+		if(It != m_Timers.end())
+			Insert(ID, It->second.m_Due);
+	}
+}
+
+void CTimerWheel::Advance(int64 Now, std::vector<FTimer> &vDue)
+{
+	while(m_Now < Now)
+	{
+		// nothing pending, the slots only hold ids of cancelled timers
+		if(m_Timers.empty())
+		{
+			for(auto &Slot : m_aLevel0)
+				Slot.clear();
+			for(auto &Level : m_aaLevels)
+				for(auto &Slot : Level)
+					Slot.clear();
+			m_NumLevel0 = 0;
+			m_Now = Now;
+			return;
+		}
+
+		// with an empty level 0 nothing can happen before the next cascade
+		if(!m_NumLevel0)
+		{
+			m_Now = minimum(Now, m_Now | ((1 << LEVEL0_BITS) - 1));
+			if(m_Now == Now)
+				return;
+		}
+
+		m_Now++;
+		// when a level completes a turn, the next slot of the level above is spread out below
+		for(int Level = 1; Level < NUM_LEVELS; Level++)
+		{
+			if(m_Now & (((int64)1 << Shift(Level)) - 1))
+				break;
+			Cascade(Level);
+		}
+
+		std::vector<int64> vIDs;
+		vIDs.swap(m_aLevel0[m_Now & ((1 << LEVEL0_BITS) - 1)]);
+		m_NumLevel0 -= vIDs.size();
+		for(int64 ID : vIDs)
+		{
+			auto It = m_Timers.find(ID);
+			if(It == m_Timers.end())
+				continue;
+			if(It->second.m_Due > m_Now)
+			{
+				Insert(ID, It->second.m_Due);
+				continue;
+			}
+			vDue.push_back(std::move(It->second.m_Func));
+			m_Timers.erase(It);
+		}
+	}
+}
+
+void CTimerWheel::TakeAll(std::vector<FTimer> &vDue)
+{
+	std::vector<std::pair<int64, int64>> vOrder;
+	for(const auto &Timer : m_Timers)
+		vOrder.emplace_back(Timer.second.m_Due, Timer.first);
+	std::sort(vOrder.begin(), vOrder.end());
+	for(const auto &Entry : vOrder)
+		vDue.push_back(std::move(m_Timers[Entry.second].m_Func));
+	m_Timers.clear();
+
+	m_NumLevel0 = 0;
+	for(auto &Slot : m_aLevel0)
+		Slot.clear();
+	for(auto &Level : m_aaLevels)
+		for(auto &Slot : Level)
+			Slot.clear();
+}
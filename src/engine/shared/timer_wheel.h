@@ -0,0 +1,64 @@
+#ifndef ENGINE_SHARED_TIMER_WHEEL_H
+#define ENGINE_SHARED_TIMER_WHEEL_H
+
+#include <base/system.h>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/*
+	Hierarchical timer wheel, time is counted in ticks of whatever length the owner uses.
+	Level 0 has 256 slots of one tick, every further level 64 slots of a whole turn of the
+	level below, so adding, cancelling and advancing by one tick are O(1) on average.
+	Timers further away than MAX_DELAY ticks fire after MAX_DELAY ticks.
+	Not thread safe, the owner has to lock.
+*/
+class CTimerWheel
+{
+public:
+	typedef std::function<void()> FTimer;
+
+	enum
+	{
+		NUM_LEVELS = 4,
+		LEVEL0_BITS = 8,
+		LEVEL_BITS = 6,
+		MAX_DELAY = 1 << (LEVEL0_BITS + (NUM_LEVELS - 1) * LEVEL_BITS),
+	};
+
+	CTimerWheel(int64 Now = 0);
+
+	int64 Now() const { return m_Now; }
+	int Num() const { return m_Timers.size(); }
+
+	// Func is handed out by Advance once Now reaches Due, returns a non-zero id for Cancel
+	int64 Add(int64 Due, FTimer Func);
+	// returns false if the timer already fired or was cancelled
+	bool Cancel(int64 ID);
+	// moves time forward to Now and appends the timers that are due to vDue, earliest first
+	void Advance(int64 Now, std::vector<FTimer> &vDue);
+	// appends all pending timers to vDue and empties the wheel, e.g. on shutdown
+	void TakeAll(std::vector<FTimer> &vDue);
+
+private:
+	struct STimer
+	{
+		int64 m_Due;
+		FTimer m_Func;
+	};
+	// the slots only hold ids, cancelled timers are skipped when their slot comes up
+	std::unordered_map<int64, STimer> m_Timers;
+	std::vector<int64> m_aLevel0[1 << LEVEL0_BITS];
+	std::vector<int64> m_aaLevels[NUM_LEVELS - 1][1 << LEVEL_BITS];
+	int64 m_Now;
+	int64 m_NextID;
+	// ids in level 0, lets Advance skip ahead to the next cascade when there are none
+	int m_NumLevel0;
+
+	static int Shift(int Level) { return LEVEL0_BITS + (Level - 1) * LEVEL_BITS; }
+	void Insert(int64 ID, int64 Due);
+	void Cascade(int Level);
+};
+
+#endif
@@ -44,6 +44,7 @@ vec2 ClampVel(int MoveRestriction, vec2 Vel)
 CCollision::CCollision()
 {
 	m_pTiles = 0;
+	m_pSolid = 0;
 	m_Width = 0;
 	m_Height = 0;
 	m_pLayers = 0;
@@ -55,6 +56,7 @@ CCollision::CCollision()
 	m_pDoor = 0;
 	m_pSwitchers = 0;
 	m_pTune = 0;
+	m_SweptMoveBox = false;
 }
 
 CCollision::~CCollision()
@@ -71,6 +73,12 @@ void CCollision::Init(class CLayers *pLayers)
 	m_Height = m_pLayers->GameLayer()->m_Height;
 	m_pTiles = static_cast<CTile *>(m_pLayers->Map()->GetData(m_pLayers->GameLayer()->m_Data));
 
+	m_pSolid = new unsigned[(m_Width * m_Height + 31) / 32];
+	mem_zero(m_pSolid, (m_Width * m_Height + 31) / 32 * sizeof(unsigned));
+	for(int i = 0; i < m_Width * m_Height; i++)
+		if(m_pTiles[i].m_Index == TILE_SOLID || m_pTiles[i].m_Index == TILE_NOHOOK)
+			m_pSolid[i / 32] |= 1u << (i % 32);
+
 	if(m_pLayers->TeleLayer())
 	{
 		unsigned int Size = m_pLayers->Map()->GetDataSize(m_pLayers->TeleLayer()->m_Tele);
@@ -299,7 +307,30 @@ int CCollision::GetTile(int x, int y) const
 	return 0;
 }
 
-// TODO: rewrite this smarter!
+// the line tests only look at the tile a sample rounds to, so after a miss they go on with the last sample that is still in that tile
+int CCollision::LastSampleInTile(vec2 Pos0, vec2 Pos1, vec2 Pos, bool Round, float Steps, int Sample, int LastSample) const
+{
+	// rounded samples make a tile reach half a unit into its neighbours, the border ones reach to infinity
+	float Exit = 2.0f;
+	const float Shift = Round ? 0.5f : 0.0f;
+	const int Tx = clamp((Round ? round_to_int(Pos.x) : (int)Pos.x) / 32, 0, m_Width - 1);
+	const int Ty = clamp((Round ? round_to_int(Pos.y) : (int)Pos.y) / 32, 0, m_Height - 1);
+	if(Pos1.x > Pos0.x && Tx < m_Width - 1)
+		Exit = (Tx * 32 + 32 - Shift - Pos0.x) / (Pos1.x - Pos0.x);
+	else if(Pos1.x < Pos0.x && Tx > 0)
+		Exit = (Tx * 32 - Shift - Pos0.x) / (Pos1.x - Pos0.x);
+	if(Pos1.y > Pos0.y && Ty < m_Height - 1)
+		Exit = minimum(Exit, (Ty * 32 + 32 - Shift - Pos0.y) / (Pos1.y - Pos0.y));
+	else if(Pos1.y < Pos0.y && Ty > 0)
+		Exit = minimum(Exit, (Ty * 32 - Shift - Pos0.y) / (Pos1.y - Pos0.y));
+
+	// the samples right before the border are tested again, the float math isn't exact
+	const float Last = Exit * Steps - 2.0f - Steps / (1 << 18);
+	if(Last >= LastSample)
+		return LastSample;
+	return maximum(Sample, (int)Last);
+}
+
 int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision) const
 {
 	float Distance = distance(Pos0, Pos1);
@@ -322,7 +353,9 @@ int CCollision::IntersectLine(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *p
 			return GetCollisionAt(ix, iy);
 		}
 
-		Last = Pos;
+		const int Skip = LastSampleInTile(Pos0, Pos1, Pos, true, End, i, End);
+		Last = Skip > i ? mix(Pos0, Pos1, Skip / (float)End) : Pos;
+		i = Skip;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -377,7 +410,9 @@ int CCollision::IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision,
 			return hit;
 		}
 
-		Last = Pos;
+		const int Skip = LastSampleInTile(Pos0, Pos1, Pos, true, End, i, End);
+		Last = Skip > i ? mix(Pos0, Pos1, Skip / (float)End) : Pos;
+		i = Skip;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -419,7 +454,9 @@ int CCollision::IntersectLineTeleWeapon(vec2 Pos0, vec2 Pos1, vec2 *pOutCollisio
 			return GetCollisionAt(ix, iy);
 		}
 
-		Last = Pos;
+		const int Skip = LastSampleInTile(Pos0, Pos1, Pos, true, End, i, End);
+		Last = Skip > i ? mix(Pos0, Pos1, Skip / (float)End) : Pos;
+		i = Skip;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
@@ -482,6 +519,113 @@ bool CCollision::TestBox(vec2 Pos, vec2 Size) const
 }
 
 void CCollision::MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const
+{
+	if(m_SweptMoveBox)
+		MoveBoxSwept(pInoutPos, pInoutVel, Size, Elasticity);
+	else
+		MoveBoxSteps(pInoutPos, pInoutVel, Size, Elasticity);
+}
+
+void CCollision::MoveBoxSwept(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const
+{
+	vec2 Pos = *pInoutPos;
+	vec2 Vel = *pInoutVel;
+	const vec2 Half = Size * 0.5f;
+
+	// boxes that are stuck already move like they always did
+	if(length(Vel) <= 0.00001f || TestBox(Pos, Size))
+	{
+		MoveBoxSteps(pInoutPos, pInoutVel, Size, Elasticity);
+		return;
+	}
+
+	// when an edge gets into the next tile, the border tiles reach to infinity
+	auto Border = [](int Tile, int Dir, int NumTiles, float Edge, float Speed) {
+		if(Dir > 0 && Tile < NumTiles - 1)
+			return ((Tile + 1) * 32 - 0.5f - Edge) / Speed;
+		if(Dir < 0 && Tile > 0)
+			return (Tile * 32 - 0.5f - Edge) / Speed;
+		return 2.0f;
+	};
+	// how far before a tile a box stops, a few float steps even on the largest maps
+	const float Gap = 1 / 64.0f;
+
+	// the part of the tick that is left, every hit starts a new sweep from where the box stopped
+	float Time = 1.0f;
+	for(int Sweeps = 0; Sweeps < 8 && Time > 0.0f && Vel != vec2(0, 0); Sweeps++)
+	{
+		const vec2 Start = Pos;
+		const int Dx = Vel.x > 0 ? 1 : Vel.x < 0 ? -1 : 0;
+		const int Dy = Vel.y > 0 ? 1 : Vel.y < 0 ? -1 : 0;
+		const vec2 Edge = Start + vec2(Dx * Half.x, Dy * Half.y);
+		int Col = TileX(Edge.x);
+		int Row = TileY(Edge.y);
+		float NextX = Border(Col, Dx, m_Width, Edge.x, Vel.x);
+		float NextY = Border(Row, Dy, m_Height, Edge.y, Vel.y);
+
+		// only the tiles the leading edges get into need a look
+		bool Hit = false;
+		while(!Hit)
+		{
+			const float T = minimum(NextX, NextY);
+			if(T >= Time)
+				break;
+			const vec2 At = Start + Vel * T;
+			if(NextX <= NextY)
+			{
+				Col += Dx;
+				for(int y = TileY(At.y - Half.y); y <= TileY(At.y + Half.y) && !Hit; y++)
+					Hit = SolidTile(Col, y);
+				if(!Hit)
+				{
+					NextX = Border(Col, Dx, m_Width, Edge.x, Vel.x);
+					continue;
+				}
+				Pos = At;
+				if(Dx > 0)
+					Pos.x = maximum(Start.x, Col * 32 - 0.5f - Half.x - Gap);
+				else
+					Pos.x = minimum(Start.x, (Col + 1) * 32 - 0.5f + Half.x + Gap);
+				Vel.x *= -Elasticity;
+			}
+			else
+			{
+				Row += Dy;
+				for(int x = TileX(At.x - Half.x); x <= TileX(At.x + Half.x) && !Hit; x++)
+					Hit = SolidTile(x, Row);
+				if(!Hit)
+				{
+					NextY = Border(Row, Dy, m_Height, Edge.y, Vel.y);
+					continue;
+				}
+				Pos = At;
+				if(Dy > 0)
+					Pos.y = maximum(Start.y, Row * 32 - 0.5f - Half.y - Gap);
+				else
+					Pos.y = minimum(Start.y, (Row + 1) * 32 - 0.5f + Half.y + Gap);
+				Vel.y *= -Elasticity;
+			}
+			Time -= T;
+		}
+		if(!Hit)
+		{
+			Pos = Start + Vel * Time;
+			Time = 0.0f;
+		}
+	}
+
+	// the float math isn't exact, never end up in a wall because of it
+	if(TestBox(Pos, Size))
+	{
+		MoveBoxSteps(pInoutPos, pInoutVel, Size, Elasticity);
+		return;
+	}
+
+	*pInoutPos = Pos;
+	*pInoutVel = Vel;
+}
+
+void CCollision::MoveBoxSteps(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const
 {
 	// do the move
 	vec2 Pos = *pInoutPos;
@@ -557,7 +701,9 @@ void CCollision::Dest()
 		delete[] m_pDoor;
 	if(m_pSwitchers)
 		delete[] m_pSwitchers;
+	delete[] m_pSolid;
 	m_pTiles = 0;
+	m_pSolid = 0;
 	m_Width = 0;
 	m_Height = 0;
 	m_pLayers = 0;
@@ -572,8 +718,9 @@ void CCollision::Dest()
 
 int CCollision::IsSolid(int x, int y) const
 {
-	int index = GetTile(x, y);
-	return index == TILE_SOLID || index == TILE_NOHOOK;
+	if(!m_pSolid)
+		return 0;
+	return SolidTile(clamp(x / 32, 0, m_Width - 1), clamp(y / 32, 0, m_Height - 1));
 }
 
 bool CCollision::IsThrough(int x, int y, int xoff, int yoff, vec2 pos0, vec2 pos1) const
@@ -794,50 +941,44 @@ int CCollision::GetMapIndex(vec2 Pos) const
 		return -1;
 }
 
-std::list<int> CCollision::GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices) const
+CCollision::CMapIndices::CMapIndices(const CCollision *pCollision, vec2 PrevPos, vec2 Pos) :
+	m_pCollision(pCollision), m_PrevPos(PrevPos), m_Pos(Pos)
 {
-	std::list<int> Indices;
-	float d = distance(PrevPos, Pos);
-	int End(d + 1);
-	if(!d)
-	{
-		int Nx = clamp((int)Pos.x / 32, 0, m_Width - 1);
-		int Ny = clamp((int)Pos.y / 32, 0, m_Height - 1);
-		int Index = Ny * m_Width + Nx;
+	m_Distance = distance(PrevPos, Pos);
+	m_NumSamples = m_Distance + 1;
+	m_Sample = 0;
+	m_LastIndex = 0;
+}
 
-		if(TileExists(Index))
-		{
-			Indices.push_back(Index);
-			return Indices;
-		}
-		else
-			return Indices;
+bool CCollision::CMapIndices::Next(int *pIndex)
+{
+	const CCollision *pCollision = m_pCollision;
+	if(!m_Distance)
+	{
+		if(m_Sample++)
+			return false;
+		const int Nx = clamp((int)m_Pos.x / 32, 0, pCollision->m_Width - 1);
+		const int Ny = clamp((int)m_Pos.y / 32, 0, pCollision->m_Height - 1);
+		*pIndex = Ny * pCollision->m_Width + Nx;
+		return pCollision->TileExists(*pIndex);
 	}
-	else
+
+	// one sample per unit like before, but only the ones around tile borders are looked at
+	while(m_Sample < m_NumSamples)
 	{
-		float a = 0.0f;
-		vec2 Tmp = vec2(0, 0);
-		int Nx = 0;
-		int Ny = 0;
-		int Index, LastIndex = 0;
-		for(int i = 0; i < End; i++)
+		const vec2 Pos = mix(m_PrevPos, m_Pos, m_Sample / m_Distance);
+		const int Nx = clamp((int)Pos.x / 32, 0, pCollision->m_Width - 1);
+		const int Ny = clamp((int)Pos.y / 32, 0, pCollision->m_Height - 1);
+		const int Index = Ny * pCollision->m_Width + Nx;
+		m_Sample = pCollision->LastSampleInTile(m_PrevPos, m_Pos, Pos, false, m_Distance, m_Sample, m_NumSamples - 1) + 1;
+		if(Index != m_LastIndex && pCollision->TileExists(Index))
 		{
-			a = i / d;
-			Tmp = mix(PrevPos, Pos, a);
-			Nx = clamp((int)Tmp.x / 32, 0, m_Width - 1);
-			Ny = clamp((int)Tmp.y / 32, 0, m_Height - 1);
-			Index = Ny * m_Width + Nx;
-			if(TileExists(Index) && LastIndex != Index)
-			{
-				if(MaxIndices && Indices.size() > MaxIndices)
-					return Indices;
-				Indices.push_back(Index);
-				LastIndex = Index;
-			}
+			m_LastIndex = Index;
+			*pIndex = Index;
+			return true;
 		}
-
-		return Indices;
 	}
+	return false;
 }
 
 vec2 CCollision::GetPos(int Index) const
@@ -995,7 +1136,13 @@ void CCollision::SetCollisionAt(float x, float y, int id)
 	int Nx = clamp(round_to_int(x) / 32, 0, m_Width - 1);
 	int Ny = clamp(round_to_int(y) / 32, 0, m_Height - 1);
 
-	m_pTiles[Ny * m_Width + Nx].m_Index = id;
+	int Index = Ny * m_Width + Nx;
+
+	m_pTiles[Index].m_Index = id;
+	if(id == TILE_SOLID || id == TILE_NOHOOK)
+		m_pSolid[Index / 32] |= 1u << (Index % 32);
+	else
+		m_pSolid[Index / 32] &= ~(1u << (Index % 32));
 }
 
 void CCollision::SetDCollisionAt(float x, float y, int Type, int Flags, int Number)
@@ -1087,7 +1234,10 @@ int CCollision::IntersectAir(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pO
 			else
 				return GetFTile(round_to_int(Pos.x), round_to_int(Pos.y));
 		}
-		Last = Pos;
+
+		const int Skip = LastSampleInTile(Pos0, Pos1, Pos, true, d, i, id - 1);
+		Last = Skip > i ? mix(Pos0, Pos1, (float)Skip / d) : Pos;
+		i = Skip;
 	}
 	if(pOutCollision)
 		*pOutCollision = Pos1;
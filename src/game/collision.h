@@ -6,8 +6,6 @@
 #include <base/vmath.h>
 #include <engine/shared/protocol.h>
 
-#include <list>
-
 enum
 {
 	CANTMOVE_LEFT = 1 << 0,
@@ -24,6 +22,8 @@ struct CAntibotMapData;
 class CCollision
 {
 	class CTile *m_pTiles;
+	// one bit per tile that CheckPoint hits
+	unsigned *m_pSolid;
 	int m_Width;
 	int m_Height;
 	class CLayers *m_pLayers;
@@ -43,6 +43,8 @@ public:
 	int IntersectLineTeleHook(vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr) const;
 	void MovePoint(vec2 *pInoutPos, vec2 *pInoutVel, float Elasticity, int *pBounces) const;
 	void MoveBox(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const;
+	// swept moves go to the first solid tile in one go instead of in unit steps, the positions differ a bit from what clients predict
+	void SetSweptMoveBox(bool Swept) { m_SweptMoveBox = Swept; }
 	bool TestBox(vec2 Pos, vec2 Size) const;
 
 	// DDRace
@@ -71,7 +73,23 @@ public:
 	int Entity(int x, int y, int Layer) const;
 	int GetPureMapIndex(float x, float y) const;
 	int GetPureMapIndex(vec2 Pos) const { return GetPureMapIndex(Pos.x, Pos.y); }
-	std::list<int> GetMapIndices(vec2 PrevPos, vec2 Pos, unsigned MaxIndices = 0) const;
+
+	// the tiles with game tiles that a move from PrevPos to Pos crosses, in order
+	class CMapIndices
+	{
+		const CCollision *m_pCollision;
+		vec2 m_PrevPos;
+		vec2 m_Pos;
+		float m_Distance;
+		int m_NumSamples;
+		int m_Sample;
+		int m_LastIndex;
+
+	public:
+		CMapIndices(const CCollision *pCollision, vec2 PrevPos, vec2 Pos);
+		bool Next(int *pIndex);
+	};
+
 	int GetMapIndex(vec2 Pos) const;
 	bool TileExists(int Index) const;
 	bool TileExistsNext(int Index) const;
@@ -102,6 +120,19 @@ public:
 	int m_NumSwitchers;
 
 private:
+	int LastSampleInTile(vec2 Pos0, vec2 Pos1, vec2 Pos, bool Round, float Steps, int Sample, int LastSample) const;
+	int TileX(float x) const { return clamp(round_to_int(x) / 32, 0, m_Width - 1); }
+	int TileY(float y) const { return clamp(round_to_int(y) / 32, 0, m_Height - 1); }
+	bool SolidTile(int Tx, int Ty) const
+	{
+		const int Index = Ty * m_Width + Tx;
+		return m_pSolid[Index / 32] >> (Index % 32) & 1;
+	}
+	void MoveBoxSteps(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const;
+	void MoveBoxSwept(vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity) const;
+
+	bool m_SweptMoveBox;
+
 	class CTeleTile *m_pTele;
 	class CSpeedupTile *m_pSpeedup;
 	class CTile *m_pFront;
@@ -0,0 +1,74 @@
+#include "alloc.h"
+
+#include <base/math.h>
+
+#include <cstddef>
+
+CSlabAllocator *CSlabAllocator::ms_pFirst = 0;
+
+CSlabAllocator::CSlabAllocator(const char *pName, int ObjectSize, int SlabObjects)
+{
+	m_pName = pName;
+	// every object as aligned as malloc'd memory
+	const int Align = alignof(std::max_align_t);
+	m_ObjectSize = (maximum(ObjectSize, (int)sizeof(CFreeObject)) + Align - 1) / Align * Align;
+	m_SlabObjects = maximum(SlabObjects, 1);
+	m_pFree = 0;
+	m_Used = 0;
+	m_MaxUsed = 0;
+
+	m_pNextAllocator = ms_pFirst;
+	ms_pFirst = this;
+}
+
+CSlabAllocator::~CSlabAllocator()
+{
+	for(CSlabAllocator **ppAllocator = &ms_pFirst; *ppAllocator; ppAllocator = &(*ppAllocator)->m_pNextAllocator)
+	{
+		if(*ppAllocator == this)
+		{
+			*ppAllocator = m_pNextAllocator;
+			break;
+		}
+	}
+	for(char *pSlab : m_vpSlabs)
+		free(pSlab);
+}
+
+void CSlabAllocator::AddSlab()
+{
+	char *pSlab = (char *)malloc((size_t)m_ObjectSize * m_SlabObjects);
+	m_vpSlabs.push_back(pSlab);
+
+	// the first object of the slab is handed out first
+	for(int i = m_SlabObjects - 1; i >= 0; i--)
+	{
+		CFreeObject *pObject = (CFreeObject *)(pSlab + (size_t)i * m_ObjectSize);
+		pObject->m_pNext = m_pFree;
+		m_pFree = pObject;
+	}
+}
+
+void *CSlabAllocator::Allocate()
+{
+	if(!m_pFree)
+		AddSlab();
+
+	CFreeObject *pObject = m_pFree;
+	m_pFree = pObject->m_pNext;
+	m_Used++;
+	m_MaxUsed = maximum(m_MaxUsed, m_Used);
+	mem_zero(pObject, m_ObjectSize);
+	return pObject;
+}
+
+void CSlabAllocator::Free(void *pPtr)
+{
+	if(!pPtr)
+		return;
+
+	CFreeObject *pObject = (CFreeObject *)pPtr;
+	pObject->m_pNext = m_pFree;
+	m_pFree = pObject;
+	m_Used--;
+}
@@ -4,6 +4,7 @@
 #define GAME_SERVER_ALLOC_H
 
 #include <new>
+#include <vector>
 
 #include <base/system.h>
 
@@ -59,4 +60,76 @@ private:
 		mem_zero(ms_PoolData##POOLTYPE[id], sizeof(POOLTYPE)); \
 	}
 
+/*
+	Hands out zeroed objects of one size from slabs of SlabObjects each.
+	Freed objects go on a free list and are handed out again first, slabs
+	are only given back when the allocator goes away.
+*/
+class CSlabAllocator
+{
+	struct CFreeObject
+	{
+		CFreeObject *m_pNext;
+	};
+
+	const char *m_pName;
+	int m_ObjectSize;
+	int m_SlabObjects;
+	std::vector<char *> m_vpSlabs;
+	CFreeObject *m_pFree;
+	int m_Used;
+	int m_MaxUsed;
+
+	// all allocators, for the stats
+	static CSlabAllocator *ms_pFirst;
+	CSlabAllocator *m_pNextAllocator;
+
+	void AddSlab();
+
+public:
+	CSlabAllocator(const char *pName, int ObjectSize, int SlabObjects);
+	~CSlabAllocator();
+
+	void *Allocate();
+	void Free(void *pPtr);
+
+	const char *Name() const { return m_pName; }
+	int ObjectSize() const { return m_ObjectSize; }
+	int NumSlabs() const { return m_vpSlabs.size(); }
+	int Capacity() const { return m_vpSlabs.size() * m_SlabObjects; }
+	int NumUsed() const { return m_Used; }
+	int MaxUsed() const { return m_MaxUsed; }
+
+	static CSlabAllocator *First() { return ms_pFirst; }
+	CSlabAllocator *Next() const { return m_pNextAllocator; }
+};
+
+#define MACRO_ALLOC_SLAB() \
+public: \
+	void *operator new(size_t Size); \
+	void operator delete(void *pPtr, size_t Size); \
+\
+private:
+
+// classes derived from POOLTYPE don't fit its slab, they come from the heap
+#define MACRO_ALLOC_SLAB_IMPL(POOLTYPE, SlabObjects) \
+	static CSlabAllocator ms_Slab##POOLTYPE(#POOLTYPE, sizeof(POOLTYPE), SlabObjects); \
+	void *POOLTYPE::operator new(size_t Size) \
+	{ \
+		if(Size != sizeof(POOLTYPE)) \
+		{ \
+			void *p = malloc(Size); \
+			mem_zero(p, Size); \
+			return p; \
+		} \
+		return ms_Slab##POOLTYPE.Allocate(); \
+	} \
+	void POOLTYPE::operator delete(void *pPtr, size_t Size) \
+	{ \
+		if(Size != sizeof(POOLTYPE)) \
+			free(pPtr); \
+		else \
+			ms_Slab##POOLTYPE.Free(pPtr); \
+	}
+
 #endif
@@ -0,0 +1,129 @@
+#ifndef GAME_SERVER_CELLGRID_H
+#define GAME_SERVER_CELLGRID_H
+
+#include <base/math.h>
+#include <base/vmath.h>
+
+#include <vector>
+
+// where an object is in a CCellGrid
+template<typename T>
+struct CCellLink
+{
+	T *m_pPrev;
+	T *m_pNext;
+	int m_Cell;
+
+	CCellLink() :
+		m_pPrev(0), m_pNext(0), m_Cell(-1) {}
+};
+
+/*
+	Objects chained into the cells of a map grid by one of their CCellLink members.
+	The grid has NumLayers layers of the map, e.g. one per entity type, after
+	NumExtra cells that are not on the map. Positions off the map go to the
+	border cells, so the cells of an area always cover what is in it.
+*/
+template<typename T>
+class CCellGrid
+{
+	CCellLink<T> T::*m_pLink;
+	std::vector<T *> m_vpCells;
+	int m_NumExtra;
+	int m_CellSize;
+	int m_Width;
+	int m_Height;
+
+	int Coord(float Pos, int NumCells) const
+	{
+		return (int)clamp(Pos / m_CellSize, 0.0f, (float)(NumCells - 1));
+	}
+
+public:
+	CCellGrid(CCellLink<T> T::*pLink) :
+		m_pLink(pLink), m_NumExtra(0), m_CellSize(1), m_Width(0), m_Height(0) {}
+
+	// the extra cells keep their objects, the map cells have to be empty
+	void Init(int NumExtra, int NumLayers, int MapWidth, int MapHeight, int CellSize)
+	{
+		m_NumExtra = NumExtra;
+		m_CellSize = CellSize;
+		m_Width = MapWidth / CellSize + 1;
+		m_Height = MapHeight / CellSize + 1;
+		m_vpCells.resize(NumExtra + NumLayers * m_Width * m_Height, 0);
+	}
+
+	bool HasMap() const { return m_Width > 0; }
+	int Cell(int Layer, vec2 Pos) const { return m_NumExtra + (Layer * m_Height + Coord(Pos.y, m_Height)) * m_Width + Coord(Pos.x, m_Width); }
+	// number of cells of a layer that cover the area from Min to Max
+	int NumCells(vec2 Min, vec2 Max) const { return (Coord(Max.x, m_Width) - Coord(Min.x, m_Width) + 1) * (Coord(Max.y, m_Height) - Coord(Min.y, m_Height) + 1); }
+
+	void Link(T *pObj, int Cell)
+	{
+		CCellLink<T> &Link = pObj->*m_pLink;
+		if(m_vpCells[Cell])
+			(m_vpCells[Cell]->*m_pLink).m_pPrev = pObj;
+		Link.m_pNext = m_vpCells[Cell];
+		Link.m_pPrev = 0;
+		Link.m_Cell = Cell;
+		m_vpCells[Cell] = pObj;
+	}
+
+	void Unlink(T *pObj)
+	{
+		CCellLink<T> &Link = pObj->*m_pLink;
+		if(Link.m_Cell == -1)
+			return;
+
+		if(Link.m_pPrev)
+			(Link.m_pPrev->*m_pLink).m_pNext = Link.m_pNext;
+		else
+			m_vpCells[Link.m_Cell] = Link.m_pNext;
+		if(Link.m_pNext)
+			(Link.m_pNext->*m_pLink).m_pPrev = Link.m_pPrev;
+
+		Link.m_pNext = 0;
+		Link.m_pPrev = 0;
+		Link.m_Cell = -1;
+	}
+
+	// only moves objects that are linked
+	void Move(T *pObj, int Cell)
+	{
+		if((pObj->*m_pLink).m_Cell != -1 && (pObj->*m_pLink).m_Cell != Cell)
+		{
+			Unlink(pObj);
+			Link(pObj, Cell);
+		}
+	}
+
+	// calls Visit for the objects in a cell until it returns false, they may unlink themselves
+	template<typename F>
+	bool VisitCell(int Cell, F &&Visit) const
+	{
+		for(T *pObj = m_vpCells[Cell]; pObj;)
+		{
+			T *pNext = (pObj->*m_pLink).m_pNext;
+			if(!Visit(pObj))
+				return false;
+			pObj = pNext;
+		}
+		return true;
+	}
+
+	// calls Visit for the objects in the cells of a layer that cover the area from Min to Max
+	template<typename F>
+	bool Visit(int Layer, vec2 Min, vec2 Max, F &&Visit) const
+	{
+		const int FromX = Coord(Min.x, m_Width);
+		const int ToX = Coord(Max.x, m_Width);
+		const int ToY = Coord(Max.y, m_Height);
+		for(int y = Coord(Min.y, m_Height); y <= ToY; y++)
+			for(int x = FromX; x <= ToX; x++)
+				if(!VisitCell(m_NumExtra + (Layer * m_Height + y) * m_Width + x, Visit))
+					return false;
+		return true;
+	}
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include <game/version.h>
 
 #include <game/server/database/account.h>
+#include <game/server/database/account_cache.h>
 
 #include "entities/character.h"
 #include "player.h"
@@ -133,35 +134,74 @@ void CGameContext::ConWhisper(IConsole::IResult *pResult, void *pUserData)
 	// This will never be called
 }
 
-void CGameContext::ConPlayerLogin(IConsole::IResult *pResult, void *pUserData)
-{
-	CGameContext *pSelf = (CGameContext *)pUserData;
-	if(!IsValidCID(pResult->m_ClientID))
-		return;
+// identifies the player that asked, a new player may take the slot before the result arrives
+static int s_NextAccountRequest = 0;
 
-	CPlayer *pPlayer = pSelf->m_apPlayers[pResult->m_ClientID];
-	if(!pPlayer)
+void CGameContext::OnAccountResult(int ClientID, int RequestID, CAccount *pAccount, int State)
+{
+	CPlayer *pPlayer = m_apPlayers[ClientID];
+	if(!pPlayer || pPlayer->m_AccountRequest != RequestID)
+	{
+		delete pAccount;
 		return;
+	}
 
-	int State = CAccount::SUCCESS;
-
-	pPlayer->SetAccount(CAccount::Login(pResult->GetString(0), pResult->GetString(1), State));
+	pPlayer->m_AccountRequest = 0;
+	if(pAccount)
+	{
+		// the cache owns logged in accounts and refuses one that is used on another slot
+		pAccount = CAccountCache::Add(ClientID, pAccount);
+		if(pAccount)
+			pPlayer->SetAccount(pAccount);
+		else
+			State = CAccount::ALREADY_LOGIN;
+	}
 
 	switch(State)
 	{
 	case CAccount::SUCCESS:
-		pSelf->SendChatTarget(pResult->m_ClientID, "Logged in successful");
+		SendChatTarget(ClientID, "Logged in successful");
 		break;
 	case CAccount::UNKNOWN_LOGIN:
-		pSelf->SendChatTarget(pResult->m_ClientID, "There is no such login in database");
+		SendChatTarget(ClientID, "There is no such login in database");
 		break;
 	case CAccount::WRONG_PASSWORD:
-		pSelf->SendChatTarget(pResult->m_ClientID, "Wrong password");
+		SendChatTarget(ClientID, "Wrong password");
 		break;
 	case CAccount::ALREADY_LOGIN:
-		pSelf->SendChatTarget(pResult->m_ClientID, "Account is already used");
+		SendChatTarget(ClientID, "Account is already used");
+		break;
+	case CAccount::ALREADY_REGISTERED:
+		SendChatTarget(ClientID, "Account is already registered");
 		break;
+	case CAccount::FAIL:
+		SendChatTarget(ClientID, "Something goes wrong. Ask administrator(s)");
+		break;
+	}
+}
+
+void CGameContext::ConPlayerLogin(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	if(!IsValidCID(pResult->m_ClientID))
+		return;
+
+	CPlayer *pPlayer = pSelf->m_apPlayers[pResult->m_ClientID];
+	if(!pPlayer)
+		return;
+
+	if(pPlayer->m_AccountRequest)
+	{
+		pSelf->SendChatTarget(pResult->m_ClientID, "Your previous request is still being processed");
+		return;
 	}
+
+	const int ClientID = pResult->m_ClientID;
+	const int RequestID = pPlayer->m_AccountRequest = ++s_NextAccountRequest;
+
+	CAccount::Login(pResult->GetString(0), pResult->GetString(1), [pSelf, ClientID, RequestID](CAccount *pAccount, int State) {
+		pSelf->OnAccountResult(ClientID, RequestID, pAccount, State);
+	});
 }
 
 void CGameContext::ConPlayerRegister(IConsole::IResult *pResult, void *pUserData)
@@ -183,22 +223,18 @@ void CGameContext::ConPlayerRegister(IConsole::IResult *pResult, void *pUserData
 	if(!pPlayer)
 		return;
 
-	int State = CAccount::SUCCESS;
-
-	pPlayer->SetAccount(CAccount::Register(pResult->GetString(0), pResult->GetString(1), State));
-
-	switch(State)
+	if(pPlayer->m_AccountRequest)
 	{
-	case CAccount::SUCCESS:
-		pSelf->SendChatTarget(pResult->m_ClientID, "Logged in successful");
-		break;
-	case CAccount::ALREADY_REGISTERED:
-		pSelf->SendChatTarget(pResult->m_ClientID, "Account is already registered");
-		break;
-	case CAccount::FAIL:
-		pSelf->SendChatTarget(pResult->m_ClientID, "Something goes wrong. Ask administrator(s)");
-		break;
+		pSelf->SendChatTarget(pResult->m_ClientID, "Your previous request is still being processed");
+		return;
 	}
+
+	const int ClientID = pResult->m_ClientID;
+	const int RequestID = pPlayer->m_AccountRequest = ++s_NextAccountRequest;
+
+	CAccount::Register(pResult->GetString(0), pResult->GetString(1), [pSelf, ClientID, RequestID](CAccount *pAccount, int State) {
+		pSelf->OnAccountResult(ClientID, RequestID, pAccount, State);
+	});
 }
 
 void CGameContext::ConFormattedAccountData(IConsole::IResult *pResult, void *pUserData)
@@ -194,7 +194,7 @@ void CGameContext::ConToTeleporter(IConsole::IResult *pResult, void *pUserData)
 			int TeleOut = pSelf->m_World.m_Core.RandomOr0(pGameControllerDDRace->m_TeleOuts[TeleTo - 1].size());
 			vec2 TelePos = pGameControllerDDRace->m_TeleOuts[TeleTo - 1][TeleOut];
 			pChr->Core()->m_Pos = TelePos;
-			pChr->m_Pos = TelePos;
+			pChr->SetPos(TelePos);
 			pChr->m_PrevPos = TelePos;
 		}
 	}
@@ -217,7 +217,7 @@ void CGameContext::ConTeleport(IConsole::IResult *pResult, void *pUserData)
 	if(pChr && pSelf->GetCharacter(TeleTo))
 	{
 		pChr->Core()->m_Pos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
-		pChr->m_Pos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
+		pChr->SetPos(pSelf->m_apPlayers[TeleTo]->m_ViewPos);
 		pChr->m_PrevPos = pSelf->m_apPlayers[TeleTo]->m_ViewPos;
 	}
 }
@@ -505,3 +505,15 @@ void CGameContext::ConDumpAntibot(IConsole::IResult *pResult, void *pUserData)
 	CGameContext *pSelf = (CGameContext *)pUserData;
 	pSelf->Antibot()->Dump();
 }
+
+void CGameContext::ConDumpEntityPools(IConsole::IResult *pResult, void *pUserData)
+{
+	CGameContext *pSelf = (CGameContext *)pUserData;
+	char aBuf[256];
+	for(CSlabAllocator *pAllocator = CSlabAllocator::First(); pAllocator; pAllocator = pAllocator->Next())
+	{
+		str_format(aBuf, sizeof(aBuf), "%s: %d used, %d at most, %d in %d slabs, %d bytes each", pAllocator->Name(),
+			pAllocator->NumUsed(), pAllocator->MaxUsed(), pAllocator->Capacity(), pAllocator->NumSlabs(), pAllocator->ObjectSize());
+		pSelf->Console()->Print(IConsole::OUTPUT_LEVEL_STANDARD, "entities", aBuf);
+	}
+}
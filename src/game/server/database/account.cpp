@@ -27,101 +27,136 @@ CAccount::CAccount(CUuid Id, const char *Login)
 	m_Self.Login = std::string(Login);
 }
 
-CAccount* CAccount::Login(const char *Login, const char *Password, int &State)
+// hands the result back to the game thread
+static void Finish(const CAccount::FResultCallback &Callback, CAccount *pAccount, int State)
 {
-	const char *ClearPassword = sqlstr::CSqlString<32>(Login).cstr();
-	ResultPtr pRes = SJK.SSD("id, login, password, salt", "accounts", "WHERE login = '%s'", ClearPassword);
-
-	if (pRes->next())
-	{
-		bool Success = false;
+	CConnectionPool::Complete([Callback, pAccount, State]() { Callback(pAccount, State); });
+}
 
-		std::string Salt(std::istreambuf_iterator<char>(*pRes->getBlob("salt")), std::istreambuf_iterator<char>());
-		std::string Pass(std::istreambuf_iterator<char>(*pRes->getBlob("password")), std::istreambuf_iterator<char>());
-		std::string HashP = Hash(sqlstr::CSqlString<32>(Password).cstr(), Salt.c_str()).c_str();
-		if(!str_comp(Pass.c_str(), HashP.c_str()))
-			Success = true;
+void CAccount::Login(const char *Login, const char *Password, FResultCallback Callback)
+{
+	// the password is hashed in its escaped form, as it always was
+	sqlstr::CSqlString<32> LoginString(Login);
+	const std::string ClearPassword(sqlstr::CSqlString<32>(Password).cstr());
 
-		if(!Success)
+	SJK.PreparedSelect([ClearPassword, Callback](ResultPtr pRes) {
+		if(!pRes)
 		{
-			State = WRONG_PASSWORD;
-			return 0;
+			Finish(Callback, 0, FAIL);
+			return;
 		}
 
-		/* if (smth)
+		try
 		{
-			State = ALREADY_LOGIN;
-			return 0;
-		} */
+			if(pRes->next())
+			{
+				bool Success = false;
 
-		CUuid Uuid;
+				std::string Salt(std::istreambuf_iterator<char>(*pRes->getBlob("salt")), std::istreambuf_iterator<char>());
+				std::string Pass(std::istreambuf_iterator<char>(*pRes->getBlob("password")), std::istreambuf_iterator<char>());
+				std::string HashP = Hash(ClearPassword.c_str(), Salt.c_str());
+				if(!str_comp(Pass.c_str(), HashP.c_str()))
+					Success = true;
 
-		if (!ParseUuid(&Uuid, pRes->getBlob("id")))
+				if(!Success)
+				{
+					Finish(Callback, 0, WRONG_PASSWORD);
+					return;
+				}
+
+				/* if (smth)
+				{
+					Finish(Callback, 0, ALREADY_LOGIN);
+					return;
+				} */
+
+				CUuid Uuid;
+
+				if(!ParseUuid(&Uuid, pRes->getBlob("id")))
+				{
+					Finish(Callback, new CAccount(Uuid, pRes->getString("login").c_str()), SUCCESS);
+					return;
+				}
+			}
+		}
+		catch(SQLException &)
 		{
-			State = SUCCESS;
-			return new CAccount(Uuid, pRes->getString("login").c_str());
+			Finish(Callback, 0, FAIL);
+			throw;
 		}
-	}
 
-	State = UNKNOWN_LOGIN;
-	return 0;
+		Finish(Callback, 0, UNKNOWN_LOGIN);
+	}, "SELECT id, login, password, salt FROM accounts WHERE login = ?;", LoginString.str());
 }
 
-CAccount *CAccount::Register(const char *Login, const char *Password, int &State)
+void CAccount::Register(const char *Login, const char *Password, FResultCallback Callback)
 {
-	char ClearLogin[64];
-	str_copy(ClearLogin, sqlstr::CSqlString<32>(Login).cstr(), sizeof(ClearLogin));
-
-	{
-		ResultPtr pRes = SJK.SSD("id", "accounts", "WHERE login = '%s'", ClearLogin);
+	const std::string LoginString(sqlstr::CSqlString<32>(Login).str());
+	const std::string ClearPassword(sqlstr::CSqlString<32>(Password).cstr());
 
-		if(pRes->next())
+	SJK.PreparedSelect([LoginString, ClearPassword, Callback](ResultPtr pRes) {
+		if(!pRes)
 		{
-			State = ALREADY_REGISTERED;
-			return 0;
+			Finish(Callback, 0, FAIL);
+			return;
 		}
-	}
 
-	{
+		try
 		{
-			struct membuf : std::streambuf
+			if(pRes->next())
 			{
-				membuf(char *d, size_t s)
-				{
-					setg(d, d, d + s - 1); //  little trolling
-				}
-			};
+				Finish(Callback, 0, ALREADY_REGISTERED);
+				return;
+			}
 
 			char aSalt[25] = {0};
 			secure_random_password(aSalt, sizeof(aSalt), 24);
 
 			char HashP[65];
-			str_copy(HashP, Hash(sqlstr::CSqlString<32>(Password).cstr(), aSalt).c_str(), sizeof(HashP));
+			str_copy(HashP, Hash(ClearPassword.c_str(), aSalt).c_str(), sizeof(HashP));
 
-			SqlArgs Args;
-			Args.Add("login", std::any(std::string(ClearLogin)));
-			Args.Add("password", std::any(new std::istream(new membuf(HashP, sizeof(HashP)))));
-			Args.Add("salt", std::any(new std::istream(new membuf(aSalt, sizeof(aSalt)))));
-			SJK.SPS("accounts", Args);
-		}
-
-		ResultPtr pRes = SJK.SSD("id", "accounts", "WHERE login = '%s'", ClearLogin);
-
-		// oof, should remake it with SJK.ASDS
-		while(!pRes->next())
-			pRes = SJK.SSD("id", "accounts", "WHERE login = '%s'", ClearLogin);
+			if(!SJK.PreparedUpdateSync("INSERT INTO accounts(login, password, salt) VALUES (?, ?, ?);",
+				   LoginString, SqlBlob(HashP, str_length(HashP)), SqlBlob(aSalt, str_length(aSalt))))
+			{
+				Finish(Callback, 0, FAIL);
+				return;
+			}
 
-		CUuid Uuid;
+			CUuid Uuid;
+			bool Found = false;
+			SJK.PreparedSelectSync([&Uuid, &Found](ResultPtr pNewRes) {
+				Found = pNewRes && pNewRes->next() && !ParseUuid(&Uuid, pNewRes->getBlob("id"));
+			}, "SELECT id FROM accounts WHERE login = ?;", LoginString);
 
-		if(!ParseUuid(&Uuid, pRes->getBlob("id")))
+			if(Found)
+			{
+				Finish(Callback, new CAccount(Uuid, LoginString.c_str()), SUCCESS);
+				return;
+			}
+		}
+		catch(SQLException &)
 		{
-			State = SUCCESS;
-			return new CAccount(Uuid, ClearLogin);
+			Finish(Callback, 0, FAIL);
+			throw;
 		}
-	}
 
-	State = FAIL;
-	return 0;
+		Finish(Callback, 0, FAIL);
+	}, "SELECT id FROM accounts WHERE login = ?;", LoginString);
+}
+
+void CAccount::WriteBack()
+{
+	if(m_DirtyColumns.empty())
+		return;
+
+	const SqlBlob Key(m_Self.Id.m_aData, sizeof(m_Self.Id.m_aData));
+	for(const auto &Column : m_DirtyColumns)
+	{
+		std::visit([&](const auto &Value) {
+			SJK.BufferUpdate("accounts", "id", Key, Column.first.c_str(), Value);
+		}, Column.second);
+	}
+	m_DirtyColumns.clear();
 }
 
 void CAccount::Format(char *pBuffer, int BufferSize)
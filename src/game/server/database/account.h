@@ -3,6 +3,11 @@
 
 #include <engine/shared/uuid_manager.h>
 
+#include <functional>
+#include <map>
+#include <string>
+#include <variant>
+
 class CAccount
 {
 	CAccount(CUuid Id, const char *Login);
@@ -11,6 +16,11 @@ class CAccount
 		CUuid Id;
 		std::string Login;
 	} m_Self;
+
+	// columns of the accounts row changed in memory since the last WriteBack
+	typedef std::variant<int, int64, std::string> DirtyValue;
+	std::map<std::string, DirtyValue> m_DirtyColumns;
+
 public:
 	enum
 	{
@@ -22,10 +32,24 @@ public:
 		FAIL
 	};
 
-	static CAccount *Login(const char *Login, const char *Password, int &State);
-	static CAccount *Register(const char *Login, const char *Password, int &State);
+	// gets the new account (or nullptr) and one of the states above, on the game thread
+	typedef std::function<void(CAccount *pAccount, int State)> FResultCallback;
+
+	// the lookup and password hashing run on an SQL worker, Callback is called on a later tick
+	static void Login(const char *Login, const char *Password, FResultCallback Callback);
+	static void Register(const char *Login, const char *Password, FResultCallback Callback);
 
 	void Format(char *pBuffer, int BufferSize);
+
+	const CUuid &Id() const { return m_Self.Id; }
+	const char *Login() const { return m_Self.Login.c_str(); }
+
+	// reads are served from memory, writes only mark the column until the next WriteBack
+	template<typename T>
+	void MarkDirty(const char *pColumn, const T &Value) { m_DirtyColumns[pColumn] = Value; }
+	bool IsDirty() const { return !m_DirtyColumns.empty(); }
+	// hands the dirty columns to the SQL write buffer, which sends them as one UPDATE per flush
+	void WriteBack();
 };
 
 #endif 
\ No newline at end of file
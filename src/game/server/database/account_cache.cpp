@@ -0,0 +1,47 @@
+#include "account_cache.h"
+
+std::map<CUuid, CAccountCache::CEntry> CAccountCache::ms_Accounts;
+
+CAccount *CAccountCache::Add(int ClientID, CAccount *pAccount)
+{
+	auto It = ms_Accounts.find(pAccount->Id());
+	if(It != ms_Accounts.end())
+	{
+		delete pAccount;
+		// logging in again keeps the in-memory state, it is newer than the database
+		return It->second.m_ClientID == ClientID ? It->second.m_pAccount.get() : nullptr;
+	}
+
+	Remove(ClientID);
+	CEntry &Entry = ms_Accounts[pAccount->Id()];
+	Entry.m_pAccount.reset(pAccount);
+	Entry.m_ClientID = ClientID;
+	return pAccount;
+}
+
+CAccount *CAccountCache::Find(int ClientID, const CUuid &Id)
+{
+	auto It = ms_Accounts.find(Id);
+	if(It == ms_Accounts.end() || It->second.m_ClientID != ClientID)
+		return nullptr;
+	return It->second.m_pAccount.get();
+}
+
+void CAccountCache::Remove(int ClientID)
+{
+	for(auto It = ms_Accounts.begin(); It != ms_Accounts.end(); ++It)
+	{
+		if(It->second.m_ClientID == ClientID)
+		{
+			It->second.m_pAccount->WriteBack();
+			ms_Accounts.erase(It);
+			return;
+		}
+	}
+}
+
+void CAccountCache::WriteBack()
+{
+	for(auto &Account : ms_Accounts)
+		Account.second.m_pAccount->WriteBack();
+}
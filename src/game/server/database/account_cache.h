@@ -0,0 +1,33 @@
+#ifndef GAME_SERVER_DATABASE_ACCOUNT_CACHE_H
+#define GAME_SERVER_DATABASE_ACCOUNT_CACHE_H
+
+#include "account.h"
+
+#include <map>
+#include <memory>
+
+// Accounts of logged in players by id. Lives outside of CGameContext, so accounts survive
+// map changes and are only loaded from the database once per login. Game thread only.
+class CAccountCache
+{
+	struct CEntry
+	{
+		std::unique_ptr<CAccount> m_pAccount;
+		int m_ClientID;
+	};
+	static std::map<CUuid, CEntry> ms_Accounts;
+
+public:
+	// takes ownership of pAccount and binds it to ClientID, replacing the account the client had.
+	// Returns nullptr if the account is used by another client, the cached copy if it was already loaded.
+	static CAccount *Add(int ClientID, CAccount *pAccount);
+	// the account of ClientID, e.g. to restore it after a map change
+	static CAccount *Find(int ClientID, const CUuid &Id);
+	// writes back and forgets the account of ClientID
+	static void Remove(int ClientID);
+	// writes back the dirty columns of all cached accounts
+	static void WriteBack();
+	static int Num() { return ms_Accounts.size(); }
+};
+
+#endif
@@ -16,7 +16,7 @@ void CFlag::Reset()
 {
 	m_pCarryingCharacter = NULL;
 	m_AtStand = 1;
-	m_Pos = m_StandPos;
+	SetPos(m_StandPos);
 	m_Vel = vec2(0,0);
 	m_GrabTick = 0;
 }
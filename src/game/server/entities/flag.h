@@ -24,6 +24,11 @@ public:
 	virtual void Reset();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapPos(vec2 *pPos)
+	{
+		*pPos = m_Pos;
+		return true;
+	}
 };
 
 #endif
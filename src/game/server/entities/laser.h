@@ -7,6 +7,8 @@
 
 class CLaser : public CEntity
 {
+	MACRO_ALLOC_SLAB()
+
 public:
 	CLaser(CGameWorld *pGameWorld, vec2 Pos, vec2 Direction, float StartEnergy, int Owner, int Type);
 
@@ -14,6 +16,11 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapPos(vec2 *pPos)
+	{
+		*pPos = m_Pos;
+		return true;
+	}
 
 protected:
 	bool HitCharacter(vec2 From, vec2 To);
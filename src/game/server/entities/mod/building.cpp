@@ -1,5 +1,7 @@
 #include "building.h"
 
+MACRO_ALLOC_SLAB_IMPL(CBuilding, 64)
+
 CBuilding::CBuilding(CGameWorld *pGameWorld, vec2 Pos) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_BUILDING, Pos)
 {
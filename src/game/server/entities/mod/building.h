@@ -5,12 +5,18 @@
 
 class CBuilding : public CEntity
 {
+	MACRO_ALLOC_SLAB()
 
 public:
 	CBuilding(CGameWorld *pGameWorld, vec2 Pos);
 
 	virtual void Destroy();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapPos(vec2 *pPos)
+	{
+		*pPos = m_Pos;
+		return true;
+	}
 };
 
 #endif
\ No newline at end of file
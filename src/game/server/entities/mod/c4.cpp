@@ -1,5 +1,7 @@
 #include "c4.h"
 
+MACRO_ALLOC_SLAB_IMPL(CC4, 32)
+
 CC4::CC4(CGameWorld *pGameWorld, vec2 Pos, int Owner) :
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_C4, Pos)
 {
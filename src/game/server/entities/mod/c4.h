@@ -5,6 +5,8 @@
 
 class CC4 : public CEntity
 {
+	MACRO_ALLOC_SLAB()
+
 	int m_Owner;
 	int m_DestroyTicks;
 
@@ -14,6 +16,11 @@ public:
 	virtual void Destroy();
 	virtual void Tick();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapPos(vec2 *pPos)
+	{
+		*pPos = m_Pos;
+		return true;
+	}
 };
 
 #endif
\ No newline at end of file
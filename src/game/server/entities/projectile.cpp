@@ -11,6 +11,8 @@
 
 #include "character.h"
 
+MACRO_ALLOC_SLAB_IMPL(CProjectile, 128)
+
 CProjectile::CProjectile(
 	CGameWorld *pGameWorld,
 	int Type,
@@ -27,7 +29,7 @@ CProjectile::CProjectile(
 	CEntity(pGameWorld, CGameWorld::ENTTYPE_PROJECTILE)
 {
 	m_Type = Type;
-	m_Pos = Pos;
+	SetPos(Pos);
 	m_Direction = Dir;
 	m_LifeSpan = Span;
 	m_Owner = Owner;
@@ -140,7 +142,7 @@ void CProjectile::Tick()
 		if(Collide && m_Bouncing != 0)
 		{
 			m_StartTick = Server()->Tick();
-			m_Pos = NewPos + (-(m_Direction * 4));
+			vec2 Pos = NewPos + (-(m_Direction * 4));
 			if(m_Bouncing == 1)
 				m_Direction.x = -m_Direction.x;
 			else if(m_Bouncing == 2)
@@ -149,7 +151,7 @@ void CProjectile::Tick()
 				m_Direction.x = 0;
 			if(fabs(m_Direction.y) < 1e-6)
 				m_Direction.y = 0;
-			m_Pos += m_Direction;
+			SetPos(Pos + m_Direction);
 		}
 		else if(m_Type == WEAPON_GUN)
 		{
@@ -178,7 +180,7 @@ void CProjectile::Tick()
 	if(z && pControllerDDRace->m_TeleOuts[z - 1].size())
 	{
 		int TeleOut = GameServer()->m_World.m_Core.RandomOr0(pControllerDDRace->m_TeleOuts[z - 1].size());
-		m_Pos = pControllerDDRace->m_TeleOuts[z - 1][TeleOut];
+		SetPos(pControllerDDRace->m_TeleOuts[z - 1][TeleOut]);
 		m_StartTick = Server()->Tick();
 	}
 }
@@ -198,6 +200,12 @@ void CProjectile::FillInfo(CNetObj_Projectile *pProj)
 	pProj->m_Type = m_Type;
 }
 
+bool CProjectile::SnapPos(vec2 *pPos)
+{
+	*pPos = GetPos((Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed());
+	return true;
+}
+
 void CProjectile::Snap(int SnappingClient)
 {
 	float Ct = (Server()->Tick() - m_StartTick) / (float)Server()->TickSpeed();
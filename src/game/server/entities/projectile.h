@@ -7,6 +7,8 @@
 
 class CProjectile : public CEntity
 {
+	MACRO_ALLOC_SLAB()
+
 public:
 	CProjectile(
 		CGameWorld *pGameWorld,
@@ -29,6 +31,7 @@ public:
 	virtual void Tick();
 	virtual void TickPaused();
 	virtual void Snap(int SnappingClient);
+	virtual bool SnapPos(vec2 *pPos);
 
 private:
 	vec2 m_Direction;
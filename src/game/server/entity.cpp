@@ -29,6 +29,12 @@ CEntity::~CEntity()
 	Server()->SnapFreeID(m_ID);
 }
 
+void CEntity::SetPos(vec2 Pos)
+{
+	m_Pos = Pos;
+	GameWorld()->EntityMoved(this);
+}
+
 bool CEntity::NetworkClipped(int SnappingClient)
 {
 	return ::NetworkClipped(GameServer(), SnappingClient, m_Pos);
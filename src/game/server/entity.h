@@ -22,6 +22,10 @@ private:
 	CEntity *m_pPrevTypeEntity;
 	CEntity *m_pNextTypeEntity;
 
+	// grid cell handling
+	CCellLink<CEntity> m_SnapLink;
+	CCellLink<CEntity> m_QueryLink;
+
 	/* Identity */
 	class CGameWorld *m_pGameWorld;
 
@@ -41,7 +45,8 @@ protected:
 public: // TODO: Maybe make protected
 	/*
 		Variable: m_Pos
-			Contains the current posititon of the entity.
+			Contains the current posititon of the entity. Only change
+			it with SetPos, so the world can find the entity there.
 	*/
 	vec2 m_Pos;
 
@@ -65,6 +70,7 @@ public:
 	CEntity *TypeNext() { return m_pNextTypeEntity; }
 	CEntity *TypePrev() { return m_pPrevTypeEntity; }
 	const vec2 &GetPos() const { return m_Pos; }
+	void SetPos(vec2 Pos);
 	float GetProximityRadius() const { return m_ProximityRadius; }
 
 	/* Other functions */
@@ -114,6 +120,19 @@ public:
 	*/
 	virtual void Snap(int SnappingClient) {}
 
+	/*
+		Function: SnapPos
+			Tells where Snap network clips the entity, so the world can
+			skip it for clients that don't see that part of the map.
+
+		Arguments:
+			pPos - Gets the position.
+
+		Returns:
+			False if the entity has to be snapped for every client.
+	*/
+	virtual bool SnapPos(vec2 *pPos) { return false; }
+
 	/*
 		Function: NetworkClipped
 			Performs a series of test to see if a client can see the
@@ -14,6 +14,7 @@
 #include <engine/storage.h>
 #include <engine/map.h>
 #include <engine/server/server.h>
+#include <engine/server/sql_connect_pool.h>
 #include <engine/shared/config.h>
 #include <engine/shared/datafile.h>
 #include <engine/shared/linereader.h>
@@ -26,6 +27,7 @@
 #include <game/generated/protocol7.h>
 #include <game/generated/protocolglue.h>
 
+#include "database/account_cache.h"
 #include "entities/character.h"
 #include "gamemodes/2xp.h"
 
@@ -575,6 +577,11 @@ void CGameContext::OnTick()
 		m_TeeHistorian.BeginPlayers();
 	}
 
+	// results of database queries finished since the last tick
+	CConnectionPool::RunCompletions();
+	CAccountCache::WriteBack();
+	CConnectionPool::FlushWrites(false);
+
 	// copy tuning
 	m_World.m_Core.m_Tuning[0] = m_Tuning;
 	m_World.Tick();
@@ -827,6 +834,11 @@ bool CGameContext::OnClientDataPersist(int ClientID, void *pData)
 		return false;
 	}
 	pPersistent->m_IsSpectator = m_apPlayers[ClientID]->Spectator();
+	// the account itself stays in the cache, the new game context picks it up in OnClientConnected
+	CAccount *pAccount = m_apPlayers[ClientID]->GetAccount();
+	pPersistent->m_HasAccount = pAccount != 0;
+	if(pAccount)
+		pPersistent->m_AccountId = pAccount->Id();
 	return true;
 }
 
@@ -840,6 +852,12 @@ void CGameContext::OnClientConnected(int ClientID, void *pData)
 		m_apPlayers[ClientID] = new(ClientID) CPlayer(this, ClientID, IGameController::GAMETEAM_NONE);
 	}
 
+	const CPersistentClientData *pPersistent = (CPersistentClientData *)pData;
+	if(pPersistent && pPersistent->m_HasAccount)
+		m_apPlayers[ClientID]->SetAccount(CAccountCache::Find(ClientID, pPersistent->m_AccountId));
+	else
+		CAccountCache::Remove(ClientID);
+
 #ifdef CONF_DEBUG
 	if(g_Config.m_DbgDummies)
 	{
@@ -861,6 +879,10 @@ void CGameContext::OnClientDrop(int ClientID, const char *pReason)
 	delete m_apPlayers[ClientID];
 	m_apPlayers[ClientID] = 0;
 
+	// don't keep the leaving player's writes around for the rest of the flush window
+	CAccountCache::Remove(ClientID);
+	CConnectionPool::FlushWrites(true);
+
 	VoteManager()->SetUpdating(true);
 
 	// update spectator modes
@@ -1821,6 +1843,16 @@ void CGameContext::ConchainSpecialMotdupdate(IConsole::IResult *pResult, void *p
 	}
 }
 
+void CGameContext::ConchainSweptMoveBox(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData)
+{
+	pfnCallback(pResult, pCallbackUserData);
+	if(pResult->NumArguments())
+	{
+		CGameContext *pSelf = (CGameContext *)pUserData;
+		pSelf->m_Collision.SetSweptMoveBox(g_Config.m_SvSweptMoveBox);
+	}
+}
+
 void CGameContext::OnConsoleInit()
 {
 	m_pServer = Kernel()->RequestInterface<IServer>();
@@ -1854,8 +1886,10 @@ void CGameContext::OnConsoleInit()
 	Console()->Register("add_map_votes", "", CFGFLAG_SERVER, ConAddMapVotes, this, "Automatically adds voting options for all maps");
 	Console()->Register("vote", "r['yes'|'no']", CFGFLAG_SERVER, ConVote, this, "Force a vote to yes/no");
 	Console()->Register("dump_antibot", "", CFGFLAG_SERVER, ConDumpAntibot, this, "Dumps the antibot status");
+	Console()->Register("dump_entity_pools", "", CFGFLAG_SERVER, ConDumpEntityPools, this, "Dumps how much of the entity slabs is in use");
 
 	Console()->Chain("sv_motd", ConchainSpecialMotdupdate, this);
+	Console()->Chain("sv_swept_movebox", ConchainSweptMoveBox, this);
 
 #define CONSOLE_COMMAND(name, params, flags, callback, userdata, help) m_pConsole->Register(name, params, flags, callback, userdata, help);
 #include <game/consolecommands.h>
@@ -1892,6 +1926,7 @@ void CGameContext::OnInit(/*class IKernel *pKernel*/)
 
 	m_Layers.Init(Kernel());
 	m_Collision.Init(&m_Layers);
+	m_Collision.SetSweptMoveBox(g_Config.m_SvSweptMoveBox);
 
 	char aMapName[128];
 	int MapSize;
@@ -2224,6 +2259,10 @@ void CGameContext::OnShutdown()
 		aio_free(m_pTeeHistorianFile);
 	}
 
+	// cached accounts stay loaded for the next map, only their changes are written
+	CAccountCache::WriteBack();
+	CConnectionPool::FlushWrites(true);
+
 	DeleteTempfile();
 	Console()->ResetServerGameSettings();
 	Collision()->Dest();
@@ -2294,7 +2333,10 @@ void CGameContext::OnSnap(int ClientID)
 	if(ClientID > -1)
 		m_apPlayers[ClientID]->FakeSnap();
 }
-void CGameContext::OnPreSnap() {}
+void CGameContext::OnPreSnap()
+{
+	m_World.UpdateSnapGrid();
+}
 void CGameContext::OnPostSnap()
 {
 	m_Events.Clear();
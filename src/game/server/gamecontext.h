@@ -103,7 +103,9 @@ class CGameContext : public IGameServer
 	static void ConAddMapVotes(IConsole::IResult *pResult, void *pUserData);
 	static void ConVote(IConsole::IResult *pResult, void *pUserData);
 	static void ConDumpAntibot(IConsole::IResult *pResult, void *pUserData);
+	static void ConDumpEntityPools(IConsole::IResult *pResult, void *pUserData);
 	static void ConchainSpecialMotdupdate(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
+	static void ConchainSweptMoveBox(IConsole::IResult *pResult, void *pUserData, IConsole::FCommandCallback pfnCallback, void *pCallbackUserData);
 
 	CGameContext(int Resetting);
 	void Construct(int Resetting);
@@ -114,6 +116,8 @@ class CGameContext : public IGameServer
 	struct CPersistentClientData
 	{
 		bool m_IsSpectator;
+		bool m_HasAccount;
+		CUuid m_AccountId;
 	};
 
 public:
@@ -289,6 +293,7 @@ private:
 	static void ConPlayerRegister(IConsole::IResult *pResult, void *pUserData);
 
 	static void ConFormattedAccountData(IConsole::IResult *pResult, void *pUserData);
+	void OnAccountResult(int ClientID, int RequestID, class CAccount *pAccount, int State);
 
 	static void ConBuildingMode(IConsole::IResult *pResult, void *pUserData);
 
@@ -16,7 +16,8 @@
 //////////////////////////////////////////////////
 // game world
 //////////////////////////////////////////////////
-CGameWorld::CGameWorld()
+CGameWorld::CGameWorld() :
+	m_SnapGrid(&CEntity::m_SnapLink), m_QueryGrid(&CEntity::m_QueryLink)
 {
 	m_pGameServer = 0x0;
 	m_pConfig = 0x0;
@@ -26,6 +27,13 @@ CGameWorld::CGameWorld()
 	m_ResetRequested = false;
 	for(auto &pFirstEntityType : m_apFirstEntityTypes)
 		pFirstEntityType = 0;
+
+	// the grids are made when the first entity gets in, the map size is known then
+	for(int i = 0; i < NUM_ENTTYPES; i++)
+	{
+		m_aNumEntities[i] = 0;
+		m_aMaxProximityRadius[i] = 0.0f;
+	}
 }
 
 CGameWorld::~CGameWorld()
@@ -54,17 +62,17 @@ int CGameWorld::FindEntities(vec2 Pos, float Radius, CEntity **ppEnts, int Max,
 		return 0;
 
 	int Num = 0;
-	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
-	{
+	QueryEntities(Type, Pos, Pos, Radius, [&](CEntity *pEnt) {
 		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
 		{
 			if(ppEnts)
 				ppEnts[Num] = pEnt;
 			Num++;
 			if(Num == Max)
-				break;
+				return false;
 		}
-	}
+		return true;
+	});
 
 	return Num;
 }
@@ -83,10 +91,27 @@ void CGameWorld::InsertEntity(CEntity *pEnt)
 	pEnt->m_pNextTypeEntity = m_apFirstEntityTypes[pEnt->m_ObjType];
 	pEnt->m_pPrevTypeEntity = 0x0;
 	m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt;
+	m_aNumEntities[pEnt->m_ObjType]++;
+	m_aMaxProximityRadius[pEnt->m_ObjType] = maximum(m_aMaxProximityRadius[pEnt->m_ObjType], pEnt->m_ProximityRadius);
+
+	if(!m_QueryGrid.HasMap())
+	{
+		const int Width = GameServer()->Collision()->GetWidth() * 32;
+		const int Height = GameServer()->Collision()->GetHeight() * 32;
+		m_SnapGrid.Init(1, 1, Width, Height, SNAP_CELL_SIZE);
+		m_QueryGrid.Init(0, NUM_ENTTYPES, Width, Height, QUERY_CELL_SIZE);
+	}
+
+	// snapped for everyone until the grid is updated
+	m_SnapGrid.Link(pEnt, 0);
+	m_QueryGrid.Link(pEnt, m_QueryGrid.Cell(pEnt->m_ObjType, pEnt->m_Pos));
 }
 
 void CGameWorld::RemoveEntity(CEntity *pEnt)
 {
+	m_SnapGrid.Unlink(pEnt);
+	m_QueryGrid.Unlink(pEnt);
+
 	// not in the list
 	if(!pEnt->m_pNextTypeEntity && !pEnt->m_pPrevTypeEntity && m_apFirstEntityTypes[pEnt->m_ObjType] != pEnt)
 		return;
@@ -98,6 +123,7 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 		m_apFirstEntityTypes[pEnt->m_ObjType] = pEnt->m_pNextTypeEntity;
 	if(pEnt->m_pNextTypeEntity)
 		pEnt->m_pNextTypeEntity->m_pPrevTypeEntity = pEnt->m_pPrevTypeEntity;
+	m_aNumEntities[pEnt->m_ObjType]--;
 
 	// keep list traversing valid
 	if(m_pNextTraverseEntity == pEnt)
@@ -107,18 +133,70 @@ void CGameWorld::RemoveEntity(CEntity *pEnt)
 	pEnt->m_pPrevTypeEntity = 0;
 }
 
-//
-void CGameWorld::Snap(int SnappingClient)
+void CGameWorld::UpdateSnapGrid()
 {
 	for(auto *pEnt : m_apFirstEntityTypes)
-		for(; pEnt;)
+		for(; pEnt; pEnt = pEnt->m_pNextTypeEntity)
 		{
-			m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
-			pEnt->Snap(SnappingClient);
-			pEnt = m_pNextTraverseEntity;
+			vec2 Pos;
+			m_SnapGrid.Move(pEnt, pEnt->SnapPos(&Pos) ? m_SnapGrid.Cell(0, Pos) : 0);
 		}
 }
 
+void CGameWorld::EntityMoved(CEntity *pEnt)
+{
+	m_QueryGrid.Move(pEnt, m_QueryGrid.Cell(pEnt->m_ObjType, pEnt->m_Pos));
+}
+
+// calls Visit for the entities of a type that can be within Radius of the box from Min to Max, until it returns false
+template<typename T>
+void CGameWorld::QueryEntities(int Type, vec2 Min, vec2 Max, float Radius, T Visit)
+{
+	if(m_QueryGrid.HasMap())
+	{
+		const float Margin = Radius + m_aMaxProximityRadius[Type];
+		const vec2 From = Min - vec2(Margin, Margin);
+		const vec2 To = Max + vec2(Margin, Margin);
+
+		// a long line or a huge radius over a few entities is quicker with the list
+		if(m_QueryGrid.NumCells(From, To) <= m_aNumEntities[Type])
+		{
+			m_QueryGrid.Visit(Type, From, To, Visit);
+			return;
+		}
+	}
+
+	for(CEntity *pEnt = m_apFirstEntityTypes[Type]; pEnt; pEnt = pEnt->m_pNextTypeEntity)
+		if(!Visit(pEnt))
+			return;
+}
+
+//
+void CGameWorld::Snap(int SnappingClient)
+{
+	// demos get everything
+	if(SnappingClient == -1 || !m_SnapGrid.HasMap())
+	{
+		for(auto *pEnt : m_apFirstEntityTypes)
+			for(; pEnt;)
+			{
+				m_pNextTraverseEntity = pEnt->m_pNextTypeEntity;
+				pEnt->Snap(SnappingClient);
+				pEnt = m_pNextTraverseEntity;
+			}
+		return;
+	}
+
+	// only the cells in view range, Snap still clips what is in them
+	auto SnapEntity = [SnappingClient](CEntity *pEnt) {
+		pEnt->Snap(SnappingClient);
+		return true;
+	};
+	m_SnapGrid.VisitCell(0, SnapEntity);
+	const CPlayer *pPlayer = GameServer()->m_apPlayers[SnappingClient];
+	m_SnapGrid.Visit(0, pPlayer->m_ViewPos - pPlayer->m_ShowDistance, pPlayer->m_ViewPos + pPlayer->m_ShowDistance, SnapEntity);
+}
+
 void CGameWorld::Reset()
 {
 	// reset all entities
@@ -297,14 +375,15 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	const vec2 Min(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y));
+	const vec2 Max(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y));
+	QueryEntities(ENTTYPE_CHARACTER, Min, Max, Radius, [&](CEntity *pEnt) {
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		if(pThisOnly && p != pThisOnly)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, p->m_Pos, IntersectPos))
@@ -321,7 +400,8 @@ CCharacter *CGameWorld::IntersectCharacter(vec2 Pos0, vec2 Pos1, float Radius, v
 				}
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -332,11 +412,10 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 	float ClosestRange = Radius * 2;
 	CCharacter *pClosest = 0;
 
-	CCharacter *p = (CCharacter *)GameServer()->m_World.FindFirst(ENTTYPE_CHARACTER);
-	for(; p; p = (CCharacter *)p->TypeNext())
-	{
+	QueryEntities(ENTTYPE_CHARACTER, Pos, Pos, Radius, [&](CEntity *pEnt) {
+		CCharacter *p = (CCharacter *)pEnt;
 		if(p == pNotThis)
-			continue;
+			return true;
 
 		float Len = distance(Pos, p->m_Pos);
 		if(Len < p->m_ProximityRadius + Radius)
@@ -347,7 +426,8 @@ CCharacter *CGameWorld::ClosestCharacter(vec2 Pos, float Radius, CEntity *pNotTh
 				pClosest = p;
 			}
 		}
-	}
+		return true;
+	});
 
 	return pClosest;
 }
@@ -356,11 +436,12 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 {
 	std::list<CCharacter *> listOfChars;
 
-	CCharacter *pChr = (CCharacter *)FindFirst(CGameWorld::ENTTYPE_CHARACTER);
-	for(; pChr; pChr = (CCharacter *)pChr->TypeNext())
-	{
+	const vec2 Min(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y));
+	const vec2 Max(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y));
+	QueryEntities(ENTTYPE_CHARACTER, Min, Max, Radius, [&](CEntity *pEnt) {
+		CCharacter *pChr = (CCharacter *)pEnt;
 		if(pChr == pNotThis)
-			continue;
+			return true;
 
 		vec2 IntersectPos;
 		if(closest_point_on_line(Pos0, Pos1, pChr->m_Pos, IntersectPos))
@@ -372,7 +453,8 @@ std::list<class CCharacter *> CGameWorld::IntersectedCharacters(vec2 Pos0, vec2
 				listOfChars.push_back(pChr);
 			}
 		}
-	}
+		return true;
+	});
 	return listOfChars;
 }
 
@@ -5,7 +5,10 @@
 
 #include <game/gamecore.h>
 
+#include "cellgrid.h"
+
 #include <list>
+#include <vector>
 
 class CEntity;
 class CCharacter;
@@ -32,12 +35,29 @@ public:
 	};
 
 private:
+	enum
+	{
+		SNAP_CELL_SIZE = 512,
+		QUERY_CELL_SIZE = 256,
+	};
+
 	void Reset();
 	void RemoveEntities();
 
 	CEntity *m_pNextTraverseEntity;
 	CEntity *m_apFirstEntityTypes[NUM_ENTTYPES];
 
+	// entities by the map cell they are snapped in, cell 0 holds the ones every client gets
+	CCellGrid<CEntity> m_SnapGrid;
+
+	// entities by type and the map cell of m_Pos, so the queries only look at what is close
+	CCellGrid<CEntity> m_QueryGrid;
+	int m_aNumEntities[NUM_ENTTYPES];
+	float m_aMaxProximityRadius[NUM_ENTTYPES];
+
+	template<typename T>
+	void QueryEntities(int Type, vec2 Min, vec2 Max, float Radius, T Visit);
+
 	class CGameContext *m_pGameServer;
 	struct CConfig *m_pConfig;
 	class IServer *m_pServer;
@@ -125,6 +145,16 @@ public:
 	*/
 	void RemoveEntity(CEntity *pEntity);
 
+	/*
+		Function: EntityMoved
+			Moves an entity to the query grid cell of its position,
+			CEntity::SetPos calls it.
+
+		Arguments:
+			entity - Entity that moved
+	*/
+	void EntityMoved(CEntity *pEntity);
+
 	/*
 		Function: snap
 			Calls snap on all the entities in the world to create
@@ -136,6 +166,13 @@ public:
 	*/
 	void Snap(int SnappingClient);
 
+	/*
+		Function: UpdateSnapGrid
+			Moves the entities to the snap grid cells of their current
+			positions, has to be called before the clients are snapped.
+	*/
+	void UpdateSnapGrid();
+
 	/*
 		Function: tick
 			Calls tick on all the entities in the world to progress
@@ -67,6 +67,7 @@ void CPlayer::Reset()
 
 	// Variable initialized:
 	m_LastSQLQuery = 0;
+	m_AccountRequest = 0;
 }
 
 static int PlayerFlags_SevenToSix(int Flags)
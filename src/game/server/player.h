@@ -128,6 +128,8 @@ public:
 	int m_ChatScore;
 
 	int64 m_LastSQLQuery;
+	// non-zero while a login or register query is running for this player
+	int m_AccountRequest;
 };
 
 #endif
@@ -411,10 +411,7 @@ void CTeeHistorian::RecordPlayerInput(int ClientID, const CNetObj_PlayerInput *p
 		}
 	}
 	Buffer.AddInt(ClientID);
-	for(int i = 0; i < (int)(sizeof(DiffInput) / sizeof(int)); i++)
-	{
-		Buffer.AddInt(((int *)&DiffInput)[i]);
-	}
+	Buffer.AddInts((int *)&DiffInput, sizeof(DiffInput) / sizeof(int));
 	pPrev->m_InputExists = true;
 	pPrev->m_Input = *pInput;
 
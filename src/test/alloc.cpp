@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/alloc.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// each test that uses the macro has its own class, so its slab only sees that test
+struct CMacroObject
+{
+	MACRO_ALLOC_SLAB()
+
+public:
+	virtual ~CMacroObject() {}
+	int m_aData[7];
+};
+
+MACRO_ALLOC_SLAB_IMPL(CMacroObject, 4)
+
+struct CBaseObject
+{
+	MACRO_ALLOC_SLAB()
+
+public:
+	virtual ~CBaseObject() {}
+	int m_aData[7];
+};
+
+struct CBiggerObject : public CBaseObject
+{
+	int m_aMore[64];
+};
+
+MACRO_ALLOC_SLAB_IMPL(CBaseObject, 4)
+
+static CSlabAllocator *FindAllocator(const char *pName)
+{
+	for(CSlabAllocator *pAllocator = CSlabAllocator::First(); pAllocator; pAllocator = pAllocator->Next())
+		if(str_comp(pAllocator->Name(), pName) == 0)
+			return pAllocator;
+	return 0;
+}
+
+TEST(SlabAllocator, Objects)
+{
+	CSlabAllocator Allocator("test", 12, 8);
+	EXPECT_EQ(Allocator.ObjectSize() % alignof(std::max_align_t), 0u);
+	EXPECT_EQ(Allocator.NumSlabs(), 0);
+
+	std::vector<void *> vpObjects;
+	std::set<void *> Distinct;
+	for(int i = 0; i < 20; i++)
+	{
+		void *pObject = Allocator.Allocate();
+		EXPECT_EQ((uintptr_t)pObject % alignof(std::max_align_t), 0u);
+		vpObjects.push_back(pObject);
+		Distinct.insert(pObject);
+		mem_copy(pObject, "garbage garb", 12);
+	}
+	EXPECT_EQ(Distinct.size(), 20u);
+	EXPECT_EQ(Allocator.NumUsed(), 20);
+	EXPECT_EQ(Allocator.NumSlabs(), 3);
+	EXPECT_EQ(Allocator.Capacity(), 24);
+
+	// freed ones come back first, zeroed, without new slabs
+	std::set<void *> Freed;
+	for(int i = 0; i < 10; i++)
+	{
+		Allocator.Free(vpObjects[i * 2]);
+		Freed.insert(vpObjects[i * 2]);
+	}
+	Allocator.Free(0);
+	EXPECT_EQ(Allocator.NumUsed(), 10);
+	for(int i = 0; i < 14; i++)
+	{
+		char *pObject = (char *)Allocator.Allocate();
+		EXPECT_EQ(Freed.count(pObject), i < 10 ? 1u : 0u);
+		for(int b = 0; b < 12; b++)
+			ASSERT_EQ(pObject[b], 0);
+	}
+	EXPECT_EQ(Allocator.NumSlabs(), 3);
+	EXPECT_EQ(Allocator.NumUsed(), 24);
+	EXPECT_EQ(Allocator.MaxUsed(), 24);
+}
+
+TEST(SlabAllocator, Stats)
+{
+	int Found = 0;
+	{
+		CSlabAllocator Allocator("stats", 16, 8);
+		for(CSlabAllocator *pAllocator = CSlabAllocator::First(); pAllocator; pAllocator = pAllocator->Next())
+			if(pAllocator == &Allocator)
+				Found++;
+	}
+	EXPECT_EQ(Found, 1);
+	for(CSlabAllocator *pAllocator = CSlabAllocator::First(); pAllocator; pAllocator = pAllocator->Next())
+		EXPECT_STRNE(pAllocator->Name(), "stats");
+}
+
+TEST(SlabAllocator, Macro)
+{
+	std::vector<CMacroObject *> vpObjects;
+	for(int i = 0; i < 9; i++)
+	{
+		vpObjects.push_back(new CMacroObject);
+		EXPECT_EQ(vpObjects.back()->m_aData[6], 0);
+		vpObjects.back()->m_aData[6] = i + 1;
+	}
+	for(CMacroObject *pObject : vpObjects)
+		delete pObject;
+
+	CMacroObject *pObject = new CMacroObject;
+	EXPECT_EQ(pObject->m_aData[6], 0);
+	delete pObject;
+
+	CSlabAllocator *pAllocator = FindAllocator("CMacroObject");
+	ASSERT_TRUE(pAllocator);
+	EXPECT_EQ(pAllocator->NumUsed(), 0);
+	EXPECT_EQ(pAllocator->MaxUsed(), 9);
+	EXPECT_EQ(pAllocator->NumSlabs(), 3);
+}
+
+TEST(SlabAllocator, Derived)
+{
+	// too big for the slab, has to come zeroed from the heap and go back there
+	CSlabAllocator *pAllocator = FindAllocator("CBaseObject");
+	ASSERT_TRUE(pAllocator);
+	std::vector<CBaseObject *> vpObjects;
+	for(int i = 0; i < 10; i++)
+	{
+		CBiggerObject *pObject = new CBiggerObject;
+		EXPECT_EQ(pObject->m_aMore[63], 0);
+		for(int &Value : pObject->m_aMore)
+			Value = i + 1;
+		vpObjects.push_back(pObject);
+	}
+	EXPECT_EQ(pAllocator->NumUsed(), 0);
+	for(CBaseObject *pObject : vpObjects)
+		delete pObject;
+	EXPECT_EQ(pAllocator->NumUsed(), 0);
+	EXPECT_EQ(pAllocator->NumSlabs(), 0);
+}
@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <game/server/cellgrid.h>
+
+#include <algorithm>
+#include <vector>
+
+// CGameWorld needs a running game server, so its queries are done the same way on stand-in entities
+struct CTestEntity
+{
+	vec2 m_Pos;
+	float m_ProximityRadius;
+	CCellLink<CTestEntity> m_QueryLink;
+};
+
+static const int MAP_WIDTH = 100 * 32;
+static const int MAP_HEIGHT = 60 * 32;
+static const int CELL_SIZE = 256;
+static const float MAX_PROXIMITY_RADIUS = 28.0f;
+
+static unsigned s_Seed = 1;
+
+static float Random(float Max)
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) / (float)(1 << 24) * Max;
+}
+
+// somewhere on the map or a bit off it
+static vec2 RandomPos()
+{
+	return vec2(Random(MAP_WIDTH + 400) - 200, Random(MAP_HEIGHT + 400) - 200);
+}
+
+// like CEntity::SetPos
+static void SetPos(CCellGrid<CTestEntity> *pGrid, CTestEntity *pEnt, vec2 Pos)
+{
+	pEnt->m_Pos = Pos;
+	pGrid->Move(pEnt, pGrid->Cell(0, Pos));
+}
+
+// like CGameWorld::FindEntities, with or without the grid
+static std::vector<CTestEntity *> FindEntities(CCellGrid<CTestEntity> *pGrid, std::vector<CTestEntity> *pvEntities, vec2 Pos, float Radius, bool UseGrid)
+{
+	std::vector<CTestEntity *> vpFound;
+	auto Visit = [&](CTestEntity *pEnt) {
+		if(distance(pEnt->m_Pos, Pos) < Radius + pEnt->m_ProximityRadius)
+			vpFound.push_back(pEnt);
+		return true;
+	};
+	if(UseGrid)
+	{
+		const float Margin = Radius + MAX_PROXIMITY_RADIUS;
+		pGrid->Visit(0, Pos - vec2(Margin, Margin), Pos + vec2(Margin, Margin), Visit);
+	}
+	else
+	{
+		for(auto &Ent : *pvEntities)
+			if(Ent.m_QueryLink.m_Cell != -1)
+				Visit(&Ent);
+	}
+	std::sort(vpFound.begin(), vpFound.end());
+	return vpFound;
+}
+
+// like CGameWorld::IntersectCharacter, with or without the grid
+static CTestEntity *IntersectCharacter(CCellGrid<CTestEntity> *pGrid, std::vector<CTestEntity> *pvEntities, vec2 Pos0, vec2 Pos1, float Radius, bool UseGrid)
+{
+	float ClosestLen = distance(Pos0, Pos1) * 100.0f;
+	CTestEntity *pClosest = 0;
+	auto Visit = [&](CTestEntity *pEnt) {
+		vec2 IntersectPos;
+		if(closest_point_on_line(Pos0, Pos1, pEnt->m_Pos, IntersectPos) && distance(pEnt->m_Pos, IntersectPos) < pEnt->m_ProximityRadius + Radius)
+		{
+			const float Len = distance(Pos0, IntersectPos);
+			// the same distance twice is decided by the entity, the order they are found in differs
+			if(Len < ClosestLen || (Len == ClosestLen && pEnt < pClosest))
+			{
+				ClosestLen = Len;
+				pClosest = pEnt;
+			}
+		}
+		return true;
+	};
+	if(UseGrid)
+	{
+		const float Margin = Radius + MAX_PROXIMITY_RADIUS;
+		const vec2 Min(minimum(Pos0.x, Pos1.x), minimum(Pos0.y, Pos1.y));
+		const vec2 Max(maximum(Pos0.x, Pos1.x), maximum(Pos0.y, Pos1.y));
+		pGrid->Visit(0, Min - vec2(Margin, Margin), Max + vec2(Margin, Margin), Visit);
+	}
+	else
+	{
+		for(auto &Ent : *pvEntities)
+			if(Ent.m_QueryLink.m_Cell != -1)
+				Visit(&Ent);
+	}
+	return pClosest;
+}
+
+static void ExpectSameQueries(CCellGrid<CTestEntity> *pGrid, std::vector<CTestEntity> *pvEntities)
+{
+	const vec2 Pos = RandomPos();
+	const float Radius = Random(3) < 1 ? Random(50) : Random(600);
+	ASSERT_EQ(FindEntities(pGrid, pvEntities, Pos, Radius, true), FindEntities(pGrid, pvEntities, Pos, Radius, false));
+
+	const vec2 Pos0 = RandomPos();
+	const vec2 Pos1 = Random(2) < 1 ? Pos0 + vec2(Random(1600) - 800, Random(1600) - 800) : RandomPos();
+	const float LineRadius = Random(2) < 1 ? 0.0f : Random(30);
+	ASSERT_EQ(IntersectCharacter(pGrid, pvEntities, Pos0, Pos1, LineRadius, true), IntersectCharacter(pGrid, pvEntities, Pos0, Pos1, LineRadius, false));
+}
+
+TEST(CellGrid, QueriesMatchLinearScan)
+{
+	CCellGrid<CTestEntity> Grid(&CTestEntity::m_QueryLink);
+	Grid.Init(0, 1, MAP_WIDTH, MAP_HEIGHT, CELL_SIZE);
+
+	std::vector<CTestEntity> vEntities(200);
+	for(auto &Ent : vEntities)
+	{
+		Ent.m_Pos = RandomPos();
+		Ent.m_ProximityRadius = Random(2) < 1 ? MAX_PROXIMITY_RADIUS : Random(MAX_PROXIMITY_RADIUS);
+		Grid.Link(&Ent, Grid.Cell(0, Ent.m_Pos));
+	}
+
+	for(int Tick = 0; Tick < 200; Tick++)
+	{
+		// entities move one after another, the queries in between have to see where they are now
+		for(auto &Ent : vEntities)
+		{
+			if(Random(100) < 1)
+				SetPos(&Grid, &Ent, RandomPos());
+			else
+				SetPos(&Grid, &Ent, Ent.m_Pos + vec2(Random(100) - 50, Random(100) - 50));
+
+			// some leave the world and come back
+			if(Random(200) < 1)
+			{
+				if(Ent.m_QueryLink.m_Cell == -1)
+					Grid.Link(&Ent, Grid.Cell(0, Ent.m_Pos));
+				else
+					Grid.Unlink(&Ent);
+			}
+
+			if(Random(10) < 1)
+				ExpectSameQueries(&Grid, &vEntities);
+		}
+	}
+}
+
+TEST(CellGrid, LinkUnlink)
+{
+	CCellGrid<CTestEntity> Grid(&CTestEntity::m_QueryLink);
+	EXPECT_FALSE(Grid.HasMap());
+	Grid.Init(1, 2, MAP_WIDTH, MAP_HEIGHT, CELL_SIZE);
+	EXPECT_TRUE(Grid.HasMap());
+
+	// off the map goes to the border cells, the layers and extra cells don't overlap
+	EXPECT_EQ(Grid.Cell(0, vec2(-100, -100)), 1);
+	EXPECT_EQ(Grid.Cell(0, vec2(10, 10)), 1);
+	EXPECT_EQ(Grid.Cell(1, vec2(-100, -100)), 1 + Grid.NumCells(vec2(0, 0), vec2(MAP_WIDTH, MAP_HEIGHT)));
+	EXPECT_EQ(Grid.Cell(0, vec2(MAP_WIDTH + 1000, MAP_HEIGHT + 1000)), Grid.Cell(1, vec2(-1, -1)) - 1);
+
+	CTestEntity aEnts[3];
+	for(auto &Ent : aEnts)
+		Grid.Link(&Ent, 0);
+
+	// unlinking from the front, the middle and the end keeps the others
+	auto CellContents = [&Grid](int Cell) {
+		std::vector<CTestEntity *> vpEnts;
+		Grid.VisitCell(Cell, [&vpEnts](CTestEntity *pEnt) {
+			vpEnts.push_back(pEnt);
+			return true;
+		});
+		return vpEnts;
+	};
+	EXPECT_EQ(CellContents(0), std::vector<CTestEntity *>({&aEnts[2], &aEnts[1], &aEnts[0]}));
+	Grid.Unlink(&aEnts[1]);
+	EXPECT_EQ(CellContents(0), std::vector<CTestEntity *>({&aEnts[2], &aEnts[0]}));
+	Grid.Unlink(&aEnts[2]);
+	Grid.Unlink(&aEnts[2]);
+	EXPECT_EQ(CellContents(0), std::vector<CTestEntity *>({&aEnts[0]}));
+
+	// Move only touches linked entities
+	Grid.Move(&aEnts[0], 5);
+	Grid.Move(&aEnts[1], 5);
+	EXPECT_TRUE(CellContents(0).empty());
+	EXPECT_EQ(CellContents(5), std::vector<CTestEntity *>({&aEnts[0]}));
+	EXPECT_EQ(aEnts[1].m_QueryLink.m_Cell, -1);
+}
@@ -0,0 +1,541 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/kernel.h>
+#include <engine/map.h>
+#include <engine/storage.h>
+#include <game/collision.h>
+#include <game/gamecore.h>
+#include <game/layers.h>
+#include <game/mapitems.h>
+
+#include <string>
+#include <vector>
+
+// the line tests as they were before they skipped over tiles, one sample per unit
+static int ReferenceIntersectLine(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int ix = 0, iy = 0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		ix = round_to_int(Pos.x);
+		iy = round_to_int(Pos.y);
+
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int ReferenceIntersectLineTeleHook(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int ix = 0, iy = 0;
+	int dx = 0, dy = 0;
+	ThroughOffset(Pos0, Pos1, &dx, &dy);
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		ix = round_to_int(Pos.x);
+		iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+
+		*pTeleNr = Collision.IsTeleportHook(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINHOOK;
+		}
+
+		int hit = 0;
+		if(Collision.CheckPoint(ix, iy))
+		{
+			if(!Collision.IsThrough(ix, iy, dx, dy, Pos0, Pos1))
+				hit = Collision.GetCollisionAt(ix, iy);
+		}
+		else if(Collision.IsHookBlocker(ix, iy, Pos0, Pos1))
+		{
+			hit = TILE_NOHOOK;
+		}
+		if(hit)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return hit;
+		}
+
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int ReferenceIntersectLineTeleWeapon(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision, int *pTeleNr)
+{
+	float Distance = distance(Pos0, Pos1);
+	int End(Distance + 1);
+	vec2 Last = Pos0;
+	int ix = 0, iy = 0;
+	for(int i = 0; i <= End; i++)
+	{
+		float a = i / (float)End;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		ix = round_to_int(Pos.x);
+		iy = round_to_int(Pos.y);
+
+		int Index = Collision.GetPureMapIndex(Pos);
+		*pTeleNr = Collision.IsTeleportWeapon(Index);
+		if(*pTeleNr)
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return TILE_TELEINWEAPON;
+		}
+
+		if(Collision.CheckPoint(ix, iy))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			return Collision.GetCollisionAt(ix, iy);
+		}
+
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+static int ReferenceIntersectAir(const CCollision &Collision, vec2 Pos0, vec2 Pos1, vec2 *pOutCollision, vec2 *pOutBeforeCollision)
+{
+	float d = distance(Pos0, Pos1);
+	vec2 Last = Pos0;
+
+	for(int i = 0, id = (int)ceilf(d); i < id; i++)
+	{
+		float a = (float)i / d;
+		vec2 Pos = mix(Pos0, Pos1, a);
+		int x = round_to_int(Pos.x), y = round_to_int(Pos.y);
+		if(Collision.IsSolid(x, y) || (!Collision.GetTile(x, y) && !Collision.GetFTile(x, y)))
+		{
+			*pOutCollision = Pos;
+			*pOutBeforeCollision = Last;
+			if(!Collision.GetTile(x, y) && !Collision.GetFTile(x, y))
+				return -1;
+			else if(!Collision.GetTile(x, y))
+				return Collision.GetTile(x, y);
+			else
+				return Collision.GetFTile(x, y);
+		}
+		Last = Pos;
+	}
+	*pOutCollision = Pos1;
+	*pOutBeforeCollision = Pos1;
+	return 0;
+}
+
+// what GetMapIndices did before there was CMapIndices
+static std::vector<int> ReferenceMapIndices(const CCollision &Collision, vec2 PrevPos, vec2 Pos)
+{
+	std::vector<int> vIndices;
+	float d = distance(PrevPos, Pos);
+	int End(d + 1);
+	if(!d)
+	{
+		int Nx = clamp((int)Pos.x / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp((int)Pos.y / 32, 0, Collision.GetHeight() - 1);
+		int Index = Ny * Collision.GetWidth() + Nx;
+		if(Collision.TileExists(Index))
+			vIndices.push_back(Index);
+		return vIndices;
+	}
+	int LastIndex = 0;
+	for(int i = 0; i < End; i++)
+	{
+		vec2 Tmp = mix(PrevPos, Pos, i / d);
+		int Nx = clamp((int)Tmp.x / 32, 0, Collision.GetWidth() - 1);
+		int Ny = clamp((int)Tmp.y / 32, 0, Collision.GetHeight() - 1);
+		int Index = Ny * Collision.GetWidth() + Nx;
+		if(Collision.TileExists(Index) && LastIndex != Index)
+		{
+			vIndices.push_back(Index);
+			LastIndex = Index;
+		}
+	}
+	return vIndices;
+}
+
+// MoveBox as it was before there was a solid map and swept moves
+static bool ReferenceTestBox(const CCollision &Collision, vec2 Pos, vec2 Size)
+{
+	Size *= 0.5f;
+	const vec2 aCorners[] = {Pos - Size, vec2(Pos.x + Size.x, Pos.y - Size.y), vec2(Pos.x - Size.x, Pos.y + Size.y), Pos + Size};
+	for(const vec2 &Corner : aCorners)
+	{
+		const int Index = Collision.GetTile(round_to_int(Corner.x), round_to_int(Corner.y));
+		if(Index == TILE_SOLID || Index == TILE_NOHOOK)
+			return true;
+	}
+	return false;
+}
+
+static void ReferenceMoveBox(const CCollision &Collision, vec2 *pInoutPos, vec2 *pInoutVel, vec2 Size, float Elasticity)
+{
+	vec2 Pos = *pInoutPos;
+	vec2 Vel = *pInoutVel;
+	float Distance = length(Vel);
+	int Max = (int)Distance;
+	if(Distance > 0.00001f)
+	{
+		float Fraction = 1.0f / (float)(Max + 1);
+		for(int i = 0; i <= Max; i++)
+		{
+			if(Vel == vec2(0, 0))
+				break;
+			vec2 NewPos = Pos + Vel * Fraction;
+			if(NewPos == Pos)
+				break;
+			if(ReferenceTestBox(Collision, vec2(NewPos.x, NewPos.y), Size))
+			{
+				int Hits = 0;
+				if(ReferenceTestBox(Collision, vec2(Pos.x, NewPos.y), Size))
+				{
+					NewPos.y = Pos.y;
+					Vel.y *= -Elasticity;
+					Hits++;
+				}
+				if(ReferenceTestBox(Collision, vec2(NewPos.x, Pos.y), Size))
+				{
+					NewPos.x = Pos.x;
+					Vel.x *= -Elasticity;
+					Hits++;
+				}
+				if(Hits == 0)
+				{
+					NewPos.y = Pos.y;
+					Vel.y *= -Elasticity;
+					NewPos.x = Pos.x;
+					Vel.x *= -Elasticity;
+				}
+			}
+			Pos = NewPos;
+		}
+	}
+	*pInoutPos = Pos;
+	*pInoutVel = Vel;
+}
+
+static unsigned s_Seed = 1;
+
+static float Random(float Max)
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return (s_Seed >> 8) / (float)(1 << 24) * Max;
+}
+
+class CMapCollision
+{
+	IKernel *m_pKernel;
+
+public:
+	CLayers m_Layers;
+	CCollision m_Collision;
+
+	CMapCollision() :
+		m_pKernel(0) {}
+	~CMapCollision() { delete m_pKernel; }
+
+	bool Load(const char *pPath)
+	{
+		m_pKernel = IKernel::Create();
+		IEngineMap *pMap = CreateEngineMap();
+		m_pKernel->RegisterInterface(CreateLocalStorage());
+		m_pKernel->RegisterInterface(pMap);
+		m_pKernel->RegisterInterface(static_cast<IMap *>(pMap), false);
+		if(!pMap->Load(pPath))
+			return false;
+		m_Layers.Init(m_pKernel);
+		m_Collision.Init(&m_Layers);
+		return true;
+	}
+};
+
+static int CollectMap(const char *pName, int IsDir, int StorageType, void *pUser)
+{
+	if(!IsDir && str_endswith(pName, ".map"))
+		((std::vector<std::string> *)pUser)->push_back(pName);
+	return 0;
+}
+
+// the bundled maps, the tests run from the source or the build directory
+static std::vector<std::string> BundledMaps(const char **ppDir)
+{
+	static const char *s_apDirs[] = {"data/maps", "../data/maps"};
+	std::vector<std::string> vMaps;
+	for(const char *pDir : s_apDirs)
+	{
+		fs_listdir(pDir, CollectMap, 0, &vMaps);
+		if(!vMaps.empty())
+		{
+			*ppDir = pDir;
+			break;
+		}
+	}
+	return vMaps;
+}
+
+// lines of every length, from, into and past the map, some along the borders of tiles
+static void RandomLine(const CCollision &Collision, vec2 *pPos0, vec2 *pPos1)
+{
+	const float Width = Collision.GetWidth() * 32, Height = Collision.GetHeight() * 32;
+	*pPos0 = vec2(Random(Width + 200) - 100, Random(Height + 200) - 100);
+	switch((int)Random(6))
+	{
+	case 0: *pPos1 = *pPos0 + vec2(Random(80) - 40, Random(80) - 40); break;
+	case 1: *pPos1 = *pPos0 + vec2(Random(1600) - 800, Random(1600) - 800); break;
+	case 2: *pPos1 = vec2(Random(Width + 200) - 100, Random(Height + 200) - 100); break;
+	case 3:
+		*pPos0 = vec2(round_to_int(pPos0->x / 32) * 32 + (Random(2) < 1 ? 31.5f : -0.5f), pPos0->y);
+		*pPos1 = vec2(pPos0->x, Random(Height));
+		break;
+	case 4:
+		*pPos0 = vec2(round_to_int(pPos0->x), round_to_int(pPos0->y));
+		*pPos1 = *pPos0 + vec2(round_to_int(Random(600) - 300), round_to_int(Random(600) - 300));
+		break;
+	default: *pPos1 = *pPos0; break;
+	}
+}
+
+TEST(Collision, SameAsReference)
+{
+	const char *pDir = 0;
+	std::vector<std::string> vMaps = BundledMaps(&pDir);
+	if(vMaps.empty())
+		GTEST_SKIP() << "data/maps not found";
+
+	for(const auto &Map : vMaps)
+	{
+		char aPath[256];
+		str_format(aPath, sizeof(aPath), "%s/%s", pDir, Map.c_str());
+		CMapCollision MapCollision;
+		ASSERT_TRUE(MapCollision.Load(aPath)) << aPath;
+		CCollision &Collision = MapCollision.m_Collision;
+
+		// hook blockers and through tiles too, the bundled maps have none
+		for(int i = 0; i < Collision.GetWidth() * Collision.GetHeight() / 50; i++)
+		{
+			static const int s_aTiles[] = {TILE_NOHOOK, TILE_THROUGH_ALL, TILE_THROUGH_DIR, TILE_SOLID, TILE_AIR};
+			Collision.SetCollisionAt(Random(Collision.GetWidth() * 32), Random(Collision.GetHeight() * 32), s_aTiles[(int)Random(5)]);
+		}
+
+		for(int i = 0; i < 20000; i++)
+		{
+			vec2 Pos0, Pos1;
+			RandomLine(Collision, &Pos0, &Pos1);
+
+			vec2 aExpected[2], aGot[2];
+			int ExpectedTele, GotTele;
+			int Expected = ReferenceIntersectLine(Collision, Pos0, Pos1, &aExpected[0], &aExpected[1]);
+			ASSERT_EQ(Collision.IntersectLine(Pos0, Pos1, &aGot[0], &aGot[1]), Expected) << Map << " " << Pos0.x << "," << Pos0.y << " " << Pos1.x << "," << Pos1.y;
+			ASSERT_TRUE(aGot[0] == aExpected[0] && aGot[1] == aExpected[1]) << Map << " " << Pos0.x << "," << Pos0.y << " " << Pos1.x << "," << Pos1.y;
+
+			Expected = ReferenceIntersectLineTeleHook(Collision, Pos0, Pos1, &aExpected[0], &aExpected[1], &ExpectedTele);
+			ASSERT_EQ(Collision.IntersectLineTeleHook(Pos0, Pos1, &aGot[0], &aGot[1], &GotTele), Expected);
+			ASSERT_TRUE(aGot[0] == aExpected[0] && aGot[1] == aExpected[1] && GotTele == ExpectedTele);
+
+			Expected = ReferenceIntersectLineTeleWeapon(Collision, Pos0, Pos1, &aExpected[0], &aExpected[1], &ExpectedTele);
+			ASSERT_EQ(Collision.IntersectLineTeleWeapon(Pos0, Pos1, &aGot[0], &aGot[1], &GotTele), Expected);
+			ASSERT_TRUE(aGot[0] == aExpected[0] && aGot[1] == aExpected[1] && GotTele == ExpectedTele);
+
+			Expected = ReferenceIntersectAir(Collision, Pos0, Pos1, &aExpected[0], &aExpected[1]);
+			ASSERT_EQ(Collision.IntersectAir(Pos0, Pos1, &aGot[0], &aGot[1]), Expected);
+			ASSERT_TRUE(aGot[0] == aExpected[0] && aGot[1] == aExpected[1]);
+		}
+	}
+}
+
+TEST(Collision, MapIndices)
+{
+	const char *pDir = 0;
+	std::vector<std::string> vMaps = BundledMaps(&pDir);
+	if(vMaps.empty())
+		GTEST_SKIP() << "data/maps not found";
+
+	for(const auto &Map : vMaps)
+	{
+		char aPath[256];
+		str_format(aPath, sizeof(aPath), "%s/%s", pDir, Map.c_str());
+		CMapCollision MapCollision;
+		ASSERT_TRUE(MapCollision.Load(aPath)) << aPath;
+		CCollision &Collision = MapCollision.m_Collision;
+
+		// stoppers make the tiles next to them count, the bundled maps have no other game tiles
+		for(int i = 0; i < Collision.GetWidth() * Collision.GetHeight() / 20; i++)
+			Collision.SetCollisionAt(Random(Collision.GetWidth() * 32), Random(Collision.GetHeight() * 32), TILE_STOPA);
+
+		for(int i = 0; i < 5000; i++)
+		{
+			vec2 Pos0, Pos1;
+			RandomLine(Collision, &Pos0, &Pos1);
+			// indices are found with truncated positions, so also right on and before those borders
+			if(i % 5 == 0)
+				Pos0.x = Pos1.x = round_to_int(Pos0.x / 32) * 32 - (i % 10 ? 0.001f : 0.0f);
+
+			const std::vector<int> vExpected = ReferenceMapIndices(Collision, Pos0, Pos1);
+			std::vector<int> vGot;
+			CCollision::CMapIndices Indices(&Collision, Pos0, Pos1);
+			int Index;
+			while(Indices.Next(&Index))
+				vGot.push_back(Index);
+			ASSERT_EQ(vGot, vExpected) << Map << " " << Pos0.x << "," << Pos0.y << " " << Pos1.x << "," << Pos1.y;
+		}
+	}
+}
+
+// somewhere a tee fits
+static vec2 RandomFreePos(const CCollision &Collision)
+{
+	vec2 Pos;
+	do
+		Pos = vec2(Random(Collision.GetWidth() * 32), Random(Collision.GetHeight() * 32));
+	while(Collision.TestBox(Pos, vec2(28.0f, 28.0f)));
+	return Pos;
+}
+
+// what a player does, for a while
+static void RandomInput(CNetObj_PlayerInput *pInput)
+{
+	pInput->m_Direction = (int)Random(3) - 1;
+	pInput->m_Jump = Random(3) < 1;
+	pInput->m_Hook = Random(2) < 1;
+	pInput->m_TargetX = Random(600) - 300;
+	pInput->m_TargetY = Random(600) - 300;
+	if(!pInput->m_TargetX && !pInput->m_TargetY)
+		pInput->m_TargetY = -1;
+}
+
+TEST(Collision, MoveBoxSameAsReference)
+{
+	const char *pDir = 0;
+	std::vector<std::string> vMaps = BundledMaps(&pDir);
+	if(vMaps.empty())
+		GTEST_SKIP() << "data/maps not found";
+
+	for(const auto &Map : vMaps)
+	{
+		char aPath[256];
+		str_format(aPath, sizeof(aPath), "%s/%s", pDir, Map.c_str());
+		CMapCollision MapCollision;
+		ASSERT_TRUE(MapCollision.Load(aPath)) << aPath;
+		CCollision &Collision = MapCollision.m_Collision;
+
+		// the solid map has to follow changed tiles
+		for(int i = 0; i < Collision.GetWidth() * Collision.GetHeight() / 50; i++)
+		{
+			static const int s_aTiles[] = {TILE_NOHOOK, TILE_SOLID, TILE_AIR, TILE_THROUGH_ALL};
+			Collision.SetCollisionAt(Random(Collision.GetWidth() * 32), Random(Collision.GetHeight() * 32), s_aTiles[(int)Random(4)]);
+		}
+
+		// tees running, jumping and hooking around on seeded random input have to take the exact same way as before
+		for(int Run = 0; Run < 10; Run++)
+		{
+			CWorldCore World;
+			CCharacterCore Core;
+			Core.Init(&World, &Collision);
+			Core.m_Pos = RandomFreePos(Collision);
+			for(int Tick = 0; Tick < 1000; Tick++)
+			{
+				if(Tick % 25 == 0)
+					RandomInput(&Core.m_Input);
+				Core.Tick(true);
+
+				const float RampValue = VelocityRamp(length(Core.m_Vel) * 50, Core.m_Tuning.m_VelrampStart, Core.m_Tuning.m_VelrampRange, Core.m_Tuning.m_VelrampCurvature);
+				vec2 ExpectedPos = Core.m_Pos;
+				vec2 ExpectedVel = vec2(Core.m_Vel.x * RampValue, Core.m_Vel.y);
+				ReferenceMoveBox(Collision, &ExpectedPos, &ExpectedVel, vec2(28.0f, 28.0f), 0);
+				ExpectedVel.x *= 1.0f / RampValue;
+
+				Core.Move();
+				ASSERT_TRUE(Core.m_Pos == ExpectedPos && Core.m_Vel == ExpectedVel) << Map << " run " << Run << " tick " << Tick;
+				Core.Quantize();
+			}
+		}
+
+		// bouncing boxes of any size and fast ones, the things a tee doesn't do
+		for(int i = 0; i < 20000; i++)
+		{
+			const vec2 Size = vec2(Random(64), Random(64));
+			vec2 Pos = Random(10) < 1 ? vec2(Random(Collision.GetWidth() * 32), Random(Collision.GetHeight() * 32)) : RandomFreePos(Collision);
+			vec2 Vel = Random(2) < 1 ? vec2(Random(80) - 40, Random(80) - 40) : vec2(Random(600) - 300, Random(600) - 300);
+			const float Elasticity = Random(2) < 1 ? 0.0f : Random(1);
+			vec2 ExpectedPos = Pos, ExpectedVel = Vel;
+			ReferenceMoveBox(Collision, &ExpectedPos, &ExpectedVel, Size, Elasticity);
+			Collision.MoveBox(&Pos, &Vel, Size, Elasticity);
+			ASSERT_TRUE(Pos == ExpectedPos && Vel == ExpectedVel) << Map << " " << i;
+		}
+	}
+}
+
+TEST(Collision, MoveBoxSwept)
+{
+	const char *pDir = 0;
+	std::vector<std::string> vMaps = BundledMaps(&pDir);
+	if(vMaps.empty())
+		GTEST_SKIP() << "data/maps not found";
+
+	for(const auto &Map : vMaps)
+	{
+		char aPath[256];
+		str_format(aPath, sizeof(aPath), "%s/%s", pDir, Map.c_str());
+		CMapCollision MapCollision;
+		ASSERT_TRUE(MapCollision.Load(aPath)) << aPath;
+		CCollision &Collision = MapCollision.m_Collision;
+		Collision.SetSweptMoveBox(true);
+
+		int Moves = 0, Different = 0;
+		for(int i = 0; i < 20000; i++)
+		{
+			const vec2 Size = i % 2 ? vec2(28.0f, 28.0f) : vec2(Random(32), Random(32));
+			const vec2 Start = RandomFreePos(Collision);
+			const vec2 StartVel = Random(2) < 1 ? vec2(Random(80) - 40, Random(80) - 40) : vec2(Random(600) - 300, Random(600) - 300);
+			if(Collision.TestBox(Start, Size))
+				continue;
+			vec2 Pos = Start, Vel = StartVel;
+			Collision.MoveBox(&Pos, &Vel, Size, 0);
+
+			// never into a wall, and all the way when nothing is in the way
+			ASSERT_FALSE(Collision.TestBox(Pos, Size)) << Map << " " << i;
+			if(Vel == StartVel)
+			{
+				ASSERT_LT(distance(Pos, Start + StartVel), 0.01f) << Map << " " << i;
+			}
+
+			// up to the same walls as the unit steps, except for the corners these slip past or get stuck on
+			vec2 ExpectedPos = Start, ExpectedVel = StartVel;
+			ReferenceMoveBox(Collision, &ExpectedPos, &ExpectedVel, Size, 0);
+			Moves++;
+			if(distance(Pos, ExpectedPos) > 1.5f)
+				Different++;
+		}
+		EXPECT_LT(Different, Moves / 100) << Map;
+	}
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/compression.h>
+#include <engine/shared/packer.h>
+
+#include <vector>
+
+static unsigned s_Seed = 1;
+
+static unsigned Random()
+{
+	s_Seed = s_Seed * 1103515245 + 12345;
+	return s_Seed >> 8;
+}
+
+// mostly small like snapshot deltas, every size every now and then
+static int RandomInt()
+{
+	const int Bits = Random() % 4 ? Random() % 8 : Random() % 33;
+	const int Value = Bits >= 32 ? (int)(Random() << 16 ^ Random()) : (int)(Random() & ((1u << Bits) - 1));
+	return Random() % 2 ? Value : -Value;
+}
+
+static const int s_aEdges[] = {0, 1, -1, 63, 64, -64, -65, 8191, 8192, -8193, (1 << 20) - 1, 1 << 20, (1 << 27) - 1, 1 << 27, 0x7fffffff, (int)0x80000000};
+
+// what Compress and Decompress did before they had a fast path
+static long ReferenceCompress(const int *pSrc, int Num, unsigned char *pDst, int DstSize)
+{
+	unsigned char *pStart = pDst;
+	for(int i = 0; i < Num; i++)
+	{
+		if(pStart + DstSize - pDst < 6)
+			return -1;
+		pDst = CVariableInt::Pack(pDst, pSrc[i]);
+	}
+	return pDst - pStart;
+}
+
+static long ReferenceDecompress(const unsigned char *pSrc, int Size, int *pDst, int DstSize)
+{
+	const unsigned char *pEnd = pSrc + Size;
+	int *pStart = pDst;
+	while(pSrc < pEnd)
+	{
+		if(pDst >= pStart + DstSize / 4)
+			return -1;
+		pSrc = CVariableInt::Unpack(pSrc, pDst++);
+	}
+	return (pDst - pStart) * sizeof(int);
+}
+
+TEST(VariableInt, PackFast)
+{
+	std::vector<int> vValues(s_aEdges, s_aEdges + sizeof(s_aEdges) / sizeof(s_aEdges[0]));
+	for(int i = 0; i < 100000; i++)
+		vValues.push_back(RandomInt());
+
+	for(int Value : vValues)
+	{
+		unsigned char aExpected[16] = {0}, aGot[16] = {0};
+		const int Size = CVariableInt::Pack(aExpected, Value) - aExpected;
+		ASSERT_EQ(CVariableInt::PackFast(aGot, Value) - aGot, Size) << Value;
+		ASSERT_EQ(mem_comp(aGot, aExpected, Size), 0) << Value;
+
+		int Unpacked;
+		ASSERT_EQ(CVariableInt::UnpackFast(aGot, &Unpacked) - aGot, Size) << Value;
+		ASSERT_EQ(Unpacked, Value);
+	}
+}
+
+TEST(VariableInt, UnpackFastGarbage)
+{
+	// any bytes have to read the same, even what Pack never writes
+	for(int i = 0; i < 100000; i++)
+	{
+		unsigned char aData[8];
+		for(auto &Byte : aData)
+			Byte = Random();
+		int Expected, Got;
+		const unsigned char *pExpectedEnd = CVariableInt::Unpack(aData, &Expected);
+		ASSERT_EQ(CVariableInt::UnpackFast(aData, &Got), pExpectedEnd);
+		ASSERT_EQ(Got, Expected);
+	}
+}
+
+TEST(VariableInt, SameAsReference)
+{
+	for(int Round = 0; Round < 500; Round++)
+	{
+		std::vector<int> vInts(Random() % 300);
+		for(auto &Int : vInts)
+			Int = RandomInt();
+		const int Size = vInts.size() * sizeof(int);
+
+		static unsigned char s_aExpected[2048], s_aGot[2048];
+		const int DstSize = Round % 2 ? sizeof(s_aGot) : Random() % sizeof(s_aGot);
+		const long ExpectedSize = ReferenceCompress(vInts.data(), vInts.size(), s_aExpected, DstSize);
+		ASSERT_EQ(CVariableInt::Compress(vInts.data(), Size, s_aGot, DstSize), ExpectedSize);
+		if(ExpectedSize < 0)
+			continue;
+		ASSERT_EQ(mem_comp(s_aGot, s_aExpected, ExpectedSize), 0);
+
+		// back, also with too little room and cut off in the middle of an int
+		static int s_aOut[512], s_aRefOut[512];
+		const int aSizes[] = {(int)ExpectedSize, ExpectedSize ? (int)(Random() % ExpectedSize) : 0};
+		for(int SrcSize : aSizes)
+		{
+			const int OutSize = Round % 3 ? sizeof(s_aOut) : Size / 2;
+			const long Expected = ReferenceDecompress(s_aExpected, SrcSize, s_aRefOut, OutSize);
+			ASSERT_EQ(CVariableInt::Decompress(s_aExpected, SrcSize, s_aOut, OutSize), Expected);
+			if(Expected > 0)
+			{
+				ASSERT_EQ(mem_comp(s_aOut, s_aRefOut, Expected), 0);
+			}
+		}
+	}
+}
+
+TEST(VariableInt, Packer)
+{
+	for(int Round = 0; Round < 200; Round++)
+	{
+		// some in front so the end of the buffer gets hit too
+		const int Offset = Random() % CPacker::PACKER_BUFFER_SIZE;
+		std::vector<int> vInts(Random() % 400);
+		for(auto &Int : vInts)
+			Int = RandomInt();
+
+		CPacker Expected, Got;
+		Expected.Reset();
+		Got.Reset();
+		for(int i = 0; i < Offset; i++)
+		{
+			Expected.AddInt(0);
+			Got.AddInt(0);
+		}
+		for(int Int : vInts)
+			Expected.AddInt(Int);
+		Got.AddInts(vInts.data(), vInts.size());
+
+		ASSERT_EQ(Got.Error(), Expected.Error());
+		if(Expected.Error())
+			continue;
+		ASSERT_EQ(Got.Size(), Expected.Size());
+		ASSERT_EQ(mem_comp(Got.Data(), Expected.Data(), Got.Size()), 0);
+
+		// more than there are, and cut off
+		const int aSizes[] = {Expected.Size(), (int)(Random() % (Expected.Size() + 1))};
+		for(int Size : aSizes)
+		{
+			CUnpacker ExpectedUnpacker, GotUnpacker;
+			ExpectedUnpacker.Reset(Expected.Data(), Size);
+			GotUnpacker.Reset(Expected.Data(), Size);
+			std::vector<int> vExpected(Offset + vInts.size() + 3), vGot(vExpected.size());
+			for(auto &Int : vExpected)
+				Int = ExpectedUnpacker.GetInt();
+			GotUnpacker.GetInts(vGot.data(), vGot.size());
+			ASSERT_EQ(GotUnpacker.Error(), ExpectedUnpacker.Error());
+			ASSERT_EQ(vGot, vExpected);
+		}
+	}
+}
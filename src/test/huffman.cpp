@@ -0,0 +1,430 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/huffman.h>
+
+#include <vector>
+
+// the table CNetBase uses
+static const unsigned s_aFreqTable[256 + 1] = {
+	1 << 30, 4545, 2657, 431, 1950, 919, 444, 482, 2244, 617, 838, 542, 715, 1814, 304, 240, 754, 212, 647, 186,
+	283, 131, 146, 166, 543, 164, 167, 136, 179, 859, 363, 113, 157, 154, 204, 108, 137, 180, 202, 176,
+	872, 404, 168, 134, 151, 111, 113, 109, 120, 126, 129, 100, 41, 20, 16, 22, 18, 18, 17, 19,
+	16, 37, 13, 21, 362, 166, 99, 78, 95, 88, 81, 70, 83, 284, 91, 187, 77, 68, 52, 68,
+	59, 66, 61, 638, 71, 157, 50, 46, 69, 43, 11, 24, 13, 19, 10, 12, 12, 20, 14, 9,
+	20, 20, 10, 10, 15, 15, 12, 12, 7, 19, 15, 14, 13, 18, 35, 19, 17, 14, 8, 5,
+	15, 17, 9, 15, 14, 18, 8, 10, 2173, 134, 157, 68, 188, 60, 170, 60, 194, 62, 175, 71,
+	148, 67, 167, 78, 211, 67, 156, 69, 1674, 90, 174, 53, 147, 89, 181, 51, 174, 63, 163, 80,
+	167, 94, 128, 122, 223, 153, 218, 77, 200, 110, 190, 73, 174, 69, 145, 66, 277, 143, 141, 60,
+	136, 53, 180, 57, 142, 57, 158, 61, 166, 112, 152, 92, 26, 22, 21, 28, 20, 26, 30, 21,
+	32, 27, 20, 17, 23, 21, 30, 22, 22, 21, 27, 25, 17, 27, 23, 18, 39, 26, 15, 21,
+	12, 18, 18, 27, 20, 18, 15, 19, 11, 17, 33, 12, 18, 15, 19, 18, 16, 26, 17, 18,
+	9, 10, 25, 22, 22, 17, 20, 16, 6, 16, 15, 20, 14, 18, 24, 335, 1517};
+
+// CHuffman as it was before the lookup table decoder, to check the output stays the same
+class CReferenceHuffman
+{
+	enum
+	{
+		HUFFMAN_EOF_SYMBOL = 256,
+
+		HUFFMAN_MAX_SYMBOLS = HUFFMAN_EOF_SYMBOL + 1,
+		HUFFMAN_MAX_NODES = HUFFMAN_MAX_SYMBOLS * 2 - 1,
+
+		HUFFMAN_LUTBITS = 10,
+		HUFFMAN_LUTSIZE = (1 << HUFFMAN_LUTBITS),
+		HUFFMAN_LUTMASK = (HUFFMAN_LUTSIZE - 1)
+	};
+
+	struct CNode
+	{
+		unsigned m_Bits;
+		unsigned m_NumBits;
+		unsigned short m_aLeafs[2];
+		unsigned char m_Symbol;
+	};
+
+	CNode m_aNodes[HUFFMAN_MAX_NODES];
+	CNode *m_apDecodeLut[HUFFMAN_LUTSIZE];
+	CNode *m_pStartNode;
+	int m_NumNodes;
+
+	void Setbits_r(CNode *pNode, int Bits, unsigned Depth);
+	void ConstructTree(const unsigned *pFrequencies);
+
+public:
+	void Init(const unsigned *pFrequencies);
+	int Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize);
+	int Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize);
+	unsigned MaxCodeLength() const
+	{
+		unsigned Max = 0;
+		for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+			Max = m_aNodes[i].m_NumBits > Max ? m_aNodes[i].m_NumBits : Max;
+		return Max;
+	}
+};
+
+struct CRefConstructNode
+{
+	unsigned short m_NodeId;
+	int m_Frequency;
+};
+
+void CReferenceHuffman::Setbits_r(CNode *pNode, int Bits, unsigned Depth)
+{
+	if(pNode->m_aLeafs[1] != 0xffff)
+		Setbits_r(&m_aNodes[pNode->m_aLeafs[1]], Bits | (1 << Depth), Depth + 1);
+	if(pNode->m_aLeafs[0] != 0xffff)
+		Setbits_r(&m_aNodes[pNode->m_aLeafs[0]], Bits, Depth + 1);
+
+	if(pNode->m_NumBits)
+	{
+		pNode->m_Bits = Bits;
+		pNode->m_NumBits = Depth;
+	}
+}
+
+static void RefBubbleSort(CRefConstructNode **ppList, int Size)
+{
+	int Changed = 1;
+	CRefConstructNode *pTemp;
+
+	while(Changed)
+	{
+		Changed = 0;
+		for(int i = 0; i < Size - 1; i++)
+		{
+			if(ppList[i]->m_Frequency < ppList[i + 1]->m_Frequency)
+			{
+				pTemp = ppList[i];
+				ppList[i] = ppList[i + 1];
+				ppList[i + 1] = pTemp;
+				Changed = 1;
+			}
+		}
+		Size--;
+	}
+}
+
+void CReferenceHuffman::ConstructTree(const unsigned *pFrequencies)
+{
+	CRefConstructNode aNodesLeftStorage[HUFFMAN_MAX_SYMBOLS];
+	CRefConstructNode *apNodesLeft[HUFFMAN_MAX_SYMBOLS];
+	int NumNodesLeft = HUFFMAN_MAX_SYMBOLS;
+
+	// add the symbols
+	for(int i = 0; i < HUFFMAN_MAX_SYMBOLS; i++)
+	{
+		m_aNodes[i].m_NumBits = 0xFFFFFFFF;
+		m_aNodes[i].m_Symbol = i;
+		m_aNodes[i].m_aLeafs[0] = 0xffff;
+		m_aNodes[i].m_aLeafs[1] = 0xffff;
+
+		if(i == HUFFMAN_EOF_SYMBOL)
+			aNodesLeftStorage[i].m_Frequency = 1;
+		else
+			aNodesLeftStorage[i].m_Frequency = pFrequencies[i];
+		aNodesLeftStorage[i].m_NodeId = i;
+		apNodesLeft[i] = &aNodesLeftStorage[i];
+	}
+
+	m_NumNodes = HUFFMAN_MAX_SYMBOLS;
+
+	// construct the table
+	while(NumNodesLeft > 1)
+	{
+		// we can't rely on stdlib's qsort for this, it can generate different results on different implementations
+		RefBubbleSort(apNodesLeft, NumNodesLeft);
+
+		m_aNodes[m_NumNodes].m_NumBits = 0;
+		m_aNodes[m_NumNodes].m_aLeafs[0] = apNodesLeft[NumNodesLeft - 1]->m_NodeId;
+		m_aNodes[m_NumNodes].m_aLeafs[1] = apNodesLeft[NumNodesLeft - 2]->m_NodeId;
+		apNodesLeft[NumNodesLeft - 2]->m_NodeId = m_NumNodes;
+		apNodesLeft[NumNodesLeft - 2]->m_Frequency = apNodesLeft[NumNodesLeft - 1]->m_Frequency + apNodesLeft[NumNodesLeft - 2]->m_Frequency;
+
+		m_NumNodes++;
+		NumNodesLeft--;
+	}
+
+	// set start node
+	m_pStartNode = &m_aNodes[m_NumNodes - 1];
+
+	// build symbol bits
+	Setbits_r(m_pStartNode, 0, 0);
+}
+
+void CReferenceHuffman::Init(const unsigned *pFrequencies)
+{
+	int i;
+
+	// make sure to cleanout every thing
+	mem_zero(this, sizeof(*this));
+
+	// construct the tree
+	ConstructTree(pFrequencies);
+
+	// build decode LUT
+	for(i = 0; i < HUFFMAN_LUTSIZE; i++)
+	{
+		unsigned Bits = i;
+		int k;
+		CNode *pNode = m_pStartNode;
+		for(k = 0; k < HUFFMAN_LUTBITS; k++)
+		{
+			pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+			Bits >>= 1;
+
+			if(!pNode)
+				break;
+
+			if(pNode->m_NumBits)
+			{
+				m_apDecodeLut[i] = pNode;
+				break;
+			}
+		}
+
+		if(k == HUFFMAN_LUTBITS)
+			m_apDecodeLut[i] = pNode;
+	}
+}
+
+int CReferenceHuffman::Compress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+{
+	// this macro loads a symbol for a byte into bits and bitcount
+#define HUFFMAN_MACRO_LOADSYMBOL(Sym) \
+	Bits |= m_aNodes[Sym].m_Bits << Bitcount; \
+	Bitcount += m_aNodes[Sym].m_NumBits;
+
+	// this macro writes the symbol stored in bits and bitcount to the dst pointer
+#define HUFFMAN_MACRO_WRITE() \
+	while(Bitcount >= 8) \
+	{ \
+		*pDst++ = (unsigned char)(Bits & 0xff); \
+		if(pDst == pDstEnd) \
+			return -1; \
+		Bits >>= 8; \
+		Bitcount -= 8; \
+	}
+
+	// setup buffer pointers
+	const unsigned char *pSrc = (const unsigned char *)pInput;
+	const unsigned char *pSrcEnd = pSrc + InputSize;
+	unsigned char *pDst = (unsigned char *)pOutput;
+	unsigned char *pDstEnd = pDst + OutputSize;
+
+	// symbol variables
+	unsigned Bits = 0;
+	unsigned Bitcount = 0;
+
+	// make sure that we have data that we want to compress
+	if(InputSize)
+	{
+		// {A} load the first symbol
+		int Symbol = *pSrc++;
+
+		while(pSrc != pSrcEnd)
+		{
+			// {B} load the symbol
+			HUFFMAN_MACRO_LOADSYMBOL(Symbol)
+
+			// {C} fetch next symbol, this is done here because it will reduce dependency in the code
+			Symbol = *pSrc++;
+
+			// {B} write the symbol loaded at
+			HUFFMAN_MACRO_WRITE()
+		}
+
+		// write the last symbol loaded from {C} or {A} in the case of only 1 byte input buffer
+		HUFFMAN_MACRO_LOADSYMBOL(Symbol)
+		HUFFMAN_MACRO_WRITE()
+	}
+
+	// write EOF symbol
+	HUFFMAN_MACRO_LOADSYMBOL(HUFFMAN_EOF_SYMBOL)
+	HUFFMAN_MACRO_WRITE()
+
+	// write out the last bits
+	*pDst++ = Bits;
+
+	// return the size of the output
+	return (int)(pDst - (const unsigned char *)pOutput);
+
+	// remove macros
+#undef HUFFMAN_MACRO_LOADSYMBOL
+#undef HUFFMAN_MACRO_WRITE
+}
+
+int CReferenceHuffman::Decompress(const void *pInput, int InputSize, void *pOutput, int OutputSize)
+{
+	// setup buffer pointers
+	unsigned char *pDst = (unsigned char *)pOutput;
+	unsigned char *pSrc = (unsigned char *)pInput;
+	unsigned char *pDstEnd = pDst + OutputSize;
+	unsigned char *pSrcEnd = pSrc + InputSize;
+
+	unsigned Bits = 0;
+	unsigned Bitcount = 0;
+
+	CNode *pEof = &m_aNodes[HUFFMAN_EOF_SYMBOL];
+	CNode *pNode = 0;
+
+	while(1)
+	{
+		// {A} try to load a node now, this will reduce dependency at location {D}
+		pNode = 0;
+		if(Bitcount >= HUFFMAN_LUTBITS)
+			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+
+		// {B} fill with new bits
+		while(Bitcount < 24 && pSrc != pSrcEnd)
+		{
+			Bits |= (*pSrc++) << Bitcount;
+			Bitcount += 8;
+		}
+
+		// {C} load symbol now if we didn't that earlier at location {A}
+		if(!pNode)
+			pNode = m_apDecodeLut[Bits & HUFFMAN_LUTMASK];
+
+		if(!pNode)
+			return -1;
+
+		// {D} check if we hit a symbol already
+		if(pNode->m_NumBits)
+		{
+			// remove the bits for that symbol
+			Bits >>= pNode->m_NumBits;
+			Bitcount -= pNode->m_NumBits;
+		}
+		else
+		{
+			// remove the bits that the lut checked up for us
+			Bits >>= HUFFMAN_LUTBITS;
+			Bitcount -= HUFFMAN_LUTBITS;
+
+			// walk the tree bit by bit
+			while(1)
+			{
+				// traverse tree
+				pNode = &m_aNodes[pNode->m_aLeafs[Bits & 1]];
+
+				// remove bit
+				Bitcount--;
+				Bits >>= 1;
+
+				// check if we hit a symbol
+				if(pNode->m_NumBits)
+					break;
+
+				// no more bits, decoding error
+				if(Bitcount == 0)
+					return -1;
+			}
+		}
+
+		// check for eof
+		if(pNode == pEof)
+			break;
+
+		// output character
+		if(pDst == pDstEnd)
+			return -1;
+		*pDst++ = pNode->m_Symbol;
+	}
+
+	// return the size of the decompressed buffer
+	return (int)(pDst - (const unsigned char *)pOutput);
+}
+
+class Huffman : public ::testing::Test
+{
+protected:
+	static CHuffman s_Huffman;
+	static CReferenceHuffman s_Reference;
+	unsigned m_Seed = 1;
+
+	static void SetUpTestCase()
+	{
+		s_Huffman.Init(s_aFreqTable);
+		s_Reference.Init(s_aFreqTable);
+	}
+
+	unsigned Random()
+	{
+		m_Seed = m_Seed * 1103515245 + 12345;
+		return m_Seed >> 8;
+	}
+
+	// mostly what packets look like: lots of zeros and small values, some noise
+	std::vector<unsigned char> MakeInput(int Size, int Kind)
+	{
+		std::vector<unsigned char> vData(Size);
+		for(auto &Byte : vData)
+		{
+			if(Kind == 0)
+				Byte = Random() % 4 ? 0 : Random() % 16;
+			else if(Kind == 1)
+				Byte = Random();
+			else
+				Byte = 255 - Random() % 3;
+		}
+		return vData;
+	}
+};
+
+CHuffman Huffman::s_Huffman;
+CReferenceHuffman Huffman::s_Reference;
+
+TEST_F(Huffman, CodeLength)
+{
+	// the encoder puts a code next to up to 31 bits into 64, the decoder reads 32 ahead
+	EXPECT_LE(s_Reference.MaxCodeLength(), 24u);
+}
+
+TEST_F(Huffman, SameAsReference)
+{
+	unsigned char aOut[4096], aRefOut[4096];
+	unsigned char aBack[4096], aRefBack[4096];
+	for(int i = 0; i < 3000; i++)
+	{
+		std::vector<unsigned char> vInput = MakeInput(Random() % 1400, i % 3);
+		const int Size = s_Huffman.Compress(vInput.data(), vInput.size(), aOut, sizeof(aOut));
+		const int RefSize = s_Reference.Compress(vInput.data(), vInput.size(), aRefOut, sizeof(aRefOut));
+		ASSERT_EQ(Size, RefSize);
+		ASSERT_EQ(mem_comp(aOut, aRefOut, Size), 0);
+
+		// fails at the same output size
+		for(int Limit = Size - 2; Limit <= Size + 1; Limit++)
+		{
+			if(Limit < 1)
+				continue;
+			EXPECT_EQ(s_Huffman.Compress(vInput.data(), vInput.size(), aOut, Limit) < 0, s_Reference.Compress(vInput.data(), vInput.size(), aRefOut, Limit) < 0) << Limit;
+		}
+
+		ASSERT_EQ(s_Huffman.Decompress(aRefOut, RefSize, aBack, sizeof(aBack)), (int)vInput.size());
+		ASSERT_EQ(mem_comp(aBack, vInput.data(), vInput.size()), 0);
+
+		// cut off, with too little room or just garbage
+		const int Cut = RefSize ? Random() % RefSize : 0;
+		const int Room = vInput.size() ? Random() % vInput.size() : 0;
+		std::vector<unsigned char> vGarbage = MakeInput(Random() % 64, 1);
+		const struct
+		{
+			const unsigned char *m_pData;
+			int m_Size;
+			int m_Room;
+		} aCases[] = {{aRefOut, Cut, (int)sizeof(aBack)}, {aRefOut, RefSize, Room}, {vGarbage.data(), (int)vGarbage.size(), (int)sizeof(aBack)}};
+		for(const auto &Case : aCases)
+		{
+			const int Result = s_Huffman.Decompress(Case.m_pData, Case.m_Size, aBack, Case.m_Room);
+			const int RefResult = s_Reference.Decompress(Case.m_pData, Case.m_Size, aRefBack, Case.m_Room);
+			ASSERT_EQ(Result, RefResult);
+			if(Result > 0)
+			{
+				ASSERT_EQ(mem_comp(aBack, aRefBack, Result), 0);
+			}
+		}
+	}
+}
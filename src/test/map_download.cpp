@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <engine/server/map_download.h>
+
+#include <vector>
+
+static const int64 FREQ = 1000;
+
+// sends and requests chunks one by one like a client with the given round trip
+static void Download(CMapDownloadWindow *pWindow, int *pNext, int *pSent, int NumRequests, int64 *pNow, int64 Rtt)
+{
+	for(int i = 0; i < NumRequests; i++)
+	{
+		while(*pSent < *pNext + pWindow->Size())
+			pWindow->OnSend((*pSent)++, *pNow);
+		*pNow += Rtt / maximum(pWindow->Size(), 1);
+		pWindow->OnRequest(++*pNext, *pNow);
+	}
+}
+
+TEST(MapDownloadWindow, Fixed)
+{
+	CMapDownloadWindow Window;
+	Window.Reset(15, 15, 0, FREQ);
+	int Next = 0, Sent = 0;
+	int64 Now = 0;
+	Download(&Window, &Next, &Sent, 100, &Now, 50);
+	EXPECT_EQ(Window.Size(), 15);
+	Window.OnLoss(Now);
+	EXPECT_EQ(Window.Size(), 15);
+	Download(&Window, &Next, &Sent, 100, &Now, 500);
+	EXPECT_EQ(Window.Size(), 15);
+}
+
+TEST(MapDownloadWindow, GrowsUpToMax)
+{
+	CMapDownloadWindow Window;
+	Window.Reset(4, 30, 0, FREQ);
+	int Next = 0, Sent = 0;
+	int64 Now = 0;
+
+	// doubles about every round trip at first
+	Download(&Window, &Next, &Sent, 4, &Now, 50);
+	EXPECT_EQ(Window.Size(), 8);
+	Download(&Window, &Next, &Sent, 100, &Now, 50);
+	EXPECT_EQ(Window.Size(), 30);
+	EXPECT_GT(Window.Rtt(), 0);
+}
+
+TEST(MapDownloadWindow, ShrinksOnDelay)
+{
+	CMapDownloadWindow Window;
+	Window.Reset(10, 30, 0, FREQ);
+	int Next = 0, Sent = 0;
+	int64 Now = 0;
+	Download(&Window, &Next, &Sent, 10, &Now, 40);
+	const int Grown = Window.Size();
+	EXPECT_GT(Grown, 10);
+
+	// a queue builds up, the round trip gets a lot longer
+	Download(&Window, &Next, &Sent, 60, &Now, 400);
+	EXPECT_LT(Window.Size(), Grown);
+	EXPECT_GE(Window.Size(), (int)CMapDownloadWindow::MIN_SIZE);
+
+	// once it's fast again it only grows by one per round trip
+	Download(&Window, &Next, &Sent, 200, &Now, 40);
+	const int Recovered = Window.Size();
+	Download(&Window, &Next, &Sent, Recovered, &Now, 40);
+	EXPECT_LE(Window.Size(), Recovered + 1);
+}
+
+TEST(MapDownloadWindow, Loss)
+{
+	CMapDownloadWindow Window;
+	Window.Reset(20, 30, 0, FREQ);
+	int Next = 0, Sent = 0;
+	int64 Now = 0;
+	Download(&Window, &Next, &Sent, 3, &Now, 60);
+	const int Before = Window.Size();
+
+	// halves, but only once for the losses of one round trip
+	Window.OnLoss(Now);
+	EXPECT_EQ(Window.Size(), Before / 2);
+	Window.OnLoss(Now + 1);
+	EXPECT_EQ(Window.Size(), Before / 2);
+
+	for(int i = 0; i < 10; i++)
+	{
+		Now += 1000;
+		Window.OnLoss(Now);
+	}
+	EXPECT_EQ(Window.Size(), (int)CMapDownloadWindow::MIN_SIZE);
+}
+
+// a 0.6 client that asks for the next chunk whenever the one before arrived
+static void DownloadMap(CMapDownload *pDownload, int NumChunks, bool Fast, int Window, int WindowMax, std::vector<int> *pSent, int *pMaxInFlight)
+{
+	int64 Now = 0;
+	int Received = 0;
+	std::vector<int> vInFlight;
+	auto Send = [&](int Chunk) {
+		pSent->push_back(Chunk);
+		vInFlight.push_back(Chunk);
+		*pMaxInFlight = maximum(*pMaxInFlight, (int)vInFlight.size());
+	};
+
+	pDownload->Reset();
+	pDownload->OnRequest(0, NumChunks, Fast, Window, WindowMax, Now, FREQ, Send);
+	while(!vInFlight.empty())
+	{
+		Now += 5;
+		const int Chunk = vInFlight.front();
+		vInFlight.erase(vInFlight.begin());
+		if(Chunk == Received && ++Received < NumChunks)
+			pDownload->OnRequest(Received, NumChunks, Fast, Window, WindowMax, Now, FREQ, Send);
+	}
+}
+
+TEST(MapDownload, FixedWindow)
+{
+	CMapDownload Download;
+	std::vector<int> vSent;
+	int MaxInFlight = 0;
+	DownloadMap(&Download, 100, true, 15, 15, &vSent, &MaxInFlight);
+
+	// every chunk once and in order, never more than the window ahead
+	ASSERT_EQ(vSent.size(), 100u);
+	for(int i = 0; i < 100; i++)
+		EXPECT_EQ(vSent[i], i);
+	EXPECT_EQ(MaxInFlight, 16);
+	EXPECT_EQ(Download.m_NextChunk, 100);
+	EXPECT_EQ(Download.m_ChunksSent, 100);
+}
+
+TEST(MapDownload, AdaptiveWindow)
+{
+	CMapDownload Download;
+	std::vector<int> vSent;
+	int MaxInFlight = 0;
+	DownloadMap(&Download, 500, true, 4, 30, &vSent, &MaxInFlight);
+
+	ASSERT_EQ(vSent.size(), 500u);
+	for(int i = 0; i < 500; i++)
+		EXPECT_EQ(vSent[i], i);
+	EXPECT_GT(MaxInFlight, 5);
+	EXPECT_LE(MaxInFlight, 31);
+}
+
+TEST(MapDownload, SmallMap)
+{
+	// the window is larger than the map, nothing past the end is sent
+	CMapDownload Download;
+	std::vector<int> vSent;
+	int MaxInFlight = 0;
+	DownloadMap(&Download, 3, true, 15, 15, &vSent, &MaxInFlight);
+	EXPECT_EQ(vSent, std::vector<int>({0, 1, 2}));
+}
+
+TEST(MapDownload, SlowDownload)
+{
+	CMapDownload Download;
+	std::vector<int> vSent;
+	int MaxInFlight = 0;
+	DownloadMap(&Download, 20, false, 15, 15, &vSent, &MaxInFlight);
+	ASSERT_EQ(vSent.size(), 20u);
+	EXPECT_EQ(MaxInFlight, 1);
+}
+
+TEST(MapDownload, Resend)
+{
+	CMapDownload Download;
+	std::vector<int> vSent;
+	auto Send = [&vSent](int Chunk) { vSent.push_back(Chunk); };
+	Download.Reset();
+	Download.OnRequest(0, 100, true, 15, 15, 0, FREQ, Send);
+	Download.OnRequest(1, 100, true, 15, 15, 10, FREQ, Send);
+	ASSERT_EQ(vSent.size(), 17u);
+
+	// a chunk asked for again is sent alone and the download doesn't move on
+	vSent.clear();
+	Download.OnRequest(1, 100, true, 15, 15, 20, FREQ, Send);
+	EXPECT_EQ(vSent, std::vector<int>({1}));
+	EXPECT_EQ(Download.m_NextChunk, 2);
+	EXPECT_EQ(Download.m_ChunksSent, 17);
+
+	vSent.clear();
+	Download.OnRequest(2, 100, true, 15, 15, 30, FREQ, Send);
+	EXPECT_EQ(vSent, std::vector<int>({17}));
+}
@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/parallel.h>
+
+#include <atomic>
+#include <vector>
+
+static void RunAll(CParallelFor *pParallel)
+{
+	for(int NumTasks : {0, 1, 3, 64, 1000})
+	{
+		std::vector<std::atomic<int>> aCalls(NumTasks);
+		for(auto &Calls : aCalls)
+			Calls = 0;
+
+		pParallel->Run(NumTasks, [&aCalls](int Task) { aCalls[Task]++; });
+
+		// every task ran exactly once before Run returned
+		for(int i = 0; i < NumTasks; i++)
+			EXPECT_EQ(aCalls[i].load(), 1) << "task " << i << " of " << NumTasks;
+	}
+}
+
+TEST(ParallelFor, CallerOnly)
+{
+	CParallelFor Parallel;
+	Parallel.Init(0);
+	RunAll(&Parallel);
+}
+
+TEST(ParallelFor, Threads)
+{
+	CParallelFor Parallel;
+	Parallel.Init(4);
+	EXPECT_EQ(Parallel.NumThreads(), 4);
+	for(int i = 0; i < 200; i++)
+		RunAll(&Parallel);
+}
@@ -0,0 +1,286 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+#include <engine/shared/snapshot.h>
+
+#include <vector>
+
+// fake snapshot data, every int holds its tick so a wrong holder is easy to spot
+static std::vector<int> SnapData(int Tick, int NumInts)
+{
+	return std::vector<int>(NumInts, Tick);
+}
+
+static bool CheckSnap(CSnapshotStorage *pStorage, int Tick, int NumInts)
+{
+	CSnapshot *pSnap = 0;
+	int64 Tagtime = 0;
+	if(pStorage->Get(Tick, &Tagtime, &pSnap, 0) != NumInts * (int)sizeof(int) || Tagtime != Tick * 10)
+		return false;
+	const int *pData = (const int *)pSnap;
+	for(int i = 0; i < NumInts; i++)
+		if(pData[i] != Tick)
+			return false;
+	return true;
+}
+
+TEST(SnapshotStorage, AddGetPurge)
+{
+	CSnapshotStorage Storage;
+	for(int Tick = 1; Tick <= 100; Tick++)
+	{
+		std::vector<int> Data = SnapData(Tick, 10 + Tick % 7);
+		Storage.Add(Tick, Tick * 10, Data.size() * sizeof(int), Data.data(), 0);
+	}
+	for(int Tick = 1; Tick <= 100; Tick++)
+		EXPECT_TRUE(CheckSnap(&Storage, Tick, 10 + Tick % 7)) << Tick;
+	EXPECT_EQ(Storage.Get(0, 0, 0, 0), -1);
+	EXPECT_EQ(Storage.Get(101, 0, 0, 0), -1);
+
+	Storage.PurgeUntil(50);
+	EXPECT_EQ(Storage.Get(49, 0, 0, 0), -1);
+	EXPECT_TRUE(CheckSnap(&Storage, 50, 10 + 50 % 7));
+
+	Storage.PurgeAll();
+	EXPECT_EQ(Storage.Get(50, 0, 0, 0), -1);
+}
+
+TEST(SnapshotStorage, SlidingWindow)
+{
+	// like the server, keep 150 ticks and vary the size so the ring wraps at odd places and grows
+	CSnapshotStorage Storage;
+	for(int Tick = 0; Tick < 5000; Tick++)
+	{
+		const int NumInts = 20 + (Tick * 37) % 400 + (Tick > 2500 ? 3000 : 0);
+		std::vector<int> Data = SnapData(Tick, NumInts);
+		Storage.PurgeUntil(Tick - 150);
+		Storage.Add(Tick, Tick * 10, Data.size() * sizeof(int), Data.data(), Tick % 2);
+
+		for(int Old : {Tick, Tick - 1, Tick - 75, Tick - 150})
+		{
+			if(Old < 0)
+				continue;
+			const int OldInts = 20 + (Old * 37) % 400 + (Old > 2500 ? 3000 : 0);
+			ASSERT_TRUE(CheckSnap(&Storage, Old, OldInts)) << "tick " << Old << " at " << Tick;
+		}
+		ASSERT_EQ(Storage.Get(Tick - 151, 0, 0, 0), -1);
+
+		CSnapshot *pAlt = 0;
+		Storage.Get(Tick, 0, 0, &pAlt);
+		EXPECT_EQ(pAlt != 0, Tick % 2 == 1);
+	}
+}
+
+TEST(SnapshotStorage, MaxTicks)
+{
+	// without purging, the slot of a tick MAX_TICKS later pushes out the old one and everything before it
+	CSnapshotStorage Storage;
+	std::vector<int> Data = SnapData(0, 4);
+	for(int Tick = 0; Tick <= CSnapshotStorage::MAX_TICKS + 10; Tick++)
+	{
+		Data.assign(4, Tick);
+		Storage.Add(Tick, Tick * 10, Data.size() * sizeof(int), Data.data(), 0);
+	}
+	EXPECT_EQ(Storage.Get(10, 0, 0, 0), -1);
+	EXPECT_TRUE(CheckSnap(&Storage, 11, 4));
+	EXPECT_TRUE(CheckSnap(&Storage, CSnapshotStorage::MAX_TICKS + 10, 4));
+}
+
+// CreateDelta as it was before the item index, to check the output stays the same
+static int ReferenceDelta(CSnapshot *pFrom, CSnapshot *pTo, void *pDstData, const int *pStaticSizes)
+{
+	struct CItemList
+	{
+		int m_Num;
+		int m_aKeys[64];
+		int m_aIndex[64];
+	};
+	static CItemList s_aHashlist[256];
+	auto GenerateHash = [](CSnapshot *pSnapshot) {
+		for(auto &List : s_aHashlist)
+			List.m_Num = 0;
+		for(int i = 0; i < pSnapshot->NumItems(); i++)
+		{
+			const int Key = pSnapshot->GetItem(i)->Key();
+			CItemList &List = s_aHashlist[((Key >> 12) & 0xf0) | (Key & 0xf)];
+			if(List.m_Num != 64)
+			{
+				List.m_aIndex[List.m_Num] = i;
+				List.m_aKeys[List.m_Num] = Key;
+				List.m_Num++;
+			}
+		}
+	};
+	auto Find = [](int Key) {
+		const CItemList &List = s_aHashlist[((Key >> 12) & 0xf0) | (Key & 0xf)];
+		for(int i = 0; i < List.m_Num; i++)
+			if(List.m_aKeys[i] == Key)
+				return List.m_aIndex[i];
+		return -1;
+	};
+
+	CSnapshotDelta::CData *pDelta = (CSnapshotDelta::CData *)pDstData;
+	int *pData = pDelta->m_aData;
+	pDelta->m_NumDeletedItems = 0;
+	pDelta->m_NumUpdateItems = 0;
+	pDelta->m_NumTempItems = 0;
+
+	GenerateHash(pTo);
+	for(int i = 0; i < pFrom->NumItems(); i++)
+	{
+		if(Find(pFrom->GetItem(i)->Key()) == -1)
+		{
+			pDelta->m_NumDeletedItems++;
+			*pData++ = pFrom->GetItem(i)->Key();
+		}
+	}
+
+	GenerateHash(pFrom);
+	for(int i = 0; i < pTo->NumItems(); i++)
+	{
+		const int ItemSize = pTo->GetItemSize(i);
+		CSnapshotItem *pCurItem = pTo->GetItem(i);
+		const int PastIndex = Find(pCurItem->Key());
+		const bool IncludeSize = !pStaticSizes[pCurItem->Type()];
+		if(PastIndex != -1)
+		{
+			int *pPast = pFrom->GetItem(PastIndex)->Data();
+			int *pCur = pCurItem->Data();
+			int *pDst = pData + (IncludeSize ? 3 : 2);
+			int Needed = 0;
+			for(int k = 0; k < ItemSize / 4; k++)
+			{
+				pDst[k] = pCur[k] - pPast[k];
+				Needed |= pDst[k];
+			}
+			if(!Needed)
+				continue;
+		}
+		else
+			mem_copy(pData + (IncludeSize ? 3 : 2), pCurItem->Data(), ItemSize);
+
+		*pData++ = pCurItem->Type();
+		*pData++ = pCurItem->ID();
+		if(IncludeSize)
+			*pData++ = ItemSize / 4;
+		pData += ItemSize / 4;
+		pDelta->m_NumUpdateItems++;
+	}
+
+	if(!pDelta->m_NumDeletedItems && !pDelta->m_NumUpdateItems)
+		return 0;
+	return (int)((char *)pData - (char *)pDstData);
+}
+
+enum
+{
+	NUM_TYPES = 8,
+};
+// sizes in ints, types without a static size send theirs along
+static const int s_aTypeSizes[NUM_TYPES] = {0, 10, 22, 3, 5, 7, 15, 1};
+static const int s_aStaticSizes[NUM_TYPES] = {0, 1, 1, 1, 0, 1, 0, 1};
+
+// a game-like sequence: a few hundred items that move a little every tick, some come and go.
+// Crowded puts more ids of one type in the same old hash bucket than it had room for, the
+// items that don't fit are sent whole but unpacked as diffs, so those don't survive a round trip
+static std::vector<std::vector<char>> MakeSnapshots(int NumTicks, bool Crowded)
+{
+	std::vector<std::vector<char>> vSnapshots;
+	static CSnapshotBuilder s_Builder;
+	for(int Tick = 0; Tick < NumTicks; Tick++)
+	{
+		s_Builder.Init();
+		for(int Type = 1; Type < NUM_TYPES; Type++)
+		{
+			const int Stride = Crowded && Type == 3 ? 16 : 1;
+			for(int ID = 0; ID < 100; ID++)
+			{
+				// items leave and return, the tick decides which ones are there
+				if((ID * 7 + Type * 3 + Tick / 5) % 11 == 0)
+					continue;
+				int *pItem = (int *)s_Builder.NewItem(Type, ID * Stride, s_aTypeSizes[Type] * sizeof(int));
+				if(!pItem)
+					break;
+				for(int k = 0; k < s_aTypeSizes[Type]; k++)
+				{
+					// only some fields and some items change from tick to tick
+					const bool Moves = (ID + k) % 3 == 0;
+					pItem[k] = ID * 1000 + k + (Moves ? Tick * (k + 1) : 0);
+				}
+			}
+		}
+		std::vector<char> &vData = vSnapshots.emplace_back(CSnapshot::MAX_SIZE);
+		vData.resize(s_Builder.Finish(vData.data()));
+	}
+	return vSnapshots;
+}
+
+TEST(SnapshotDelta, DiffItem)
+{
+	for(int Size = 0; Size <= 17; Size++)
+	{
+		std::vector<int> vPast(Size), vCurrent(Size), vOut(Size, -1);
+		for(int i = 0; i < Size; i++)
+		{
+			vPast[i] = i * 123457;
+			vCurrent[i] = vPast[i];
+		}
+		EXPECT_EQ(CSnapshotDelta::DiffItem(vPast.data(), vCurrent.data(), vOut.data(), Size), 0);
+
+		// a change in any lane has to show, also one that wraps around
+		for(int Changed = 0; Changed < Size; Changed++)
+		{
+			vCurrent = vPast;
+			vCurrent[Changed] = Changed % 2 ? vPast[Changed] + 5 : (int)0x80000000;
+			EXPECT_NE(CSnapshotDelta::DiffItem(vPast.data(), vCurrent.data(), vOut.data(), Size), 0);
+			for(int i = 0; i < Size; i++)
+				EXPECT_EQ(vOut[i], (int)((unsigned)vCurrent[i] - (unsigned)vPast[i]));
+		}
+	}
+}
+
+static void TestSameAsReference(bool Crowded)
+{
+	std::vector<std::vector<char>> vSnapshots = MakeSnapshots(200, Crowded);
+	CSnapshotDelta Delta;
+	for(int Type = 0; Type < NUM_TYPES; Type++)
+		if(s_aStaticSizes[Type])
+			Delta.SetStaticsize(Type, s_aTypeSizes[Type] * sizeof(int));
+
+	static char s_aDelta[CSnapshot::MAX_SIZE];
+	static char s_aReference[CSnapshot::MAX_SIZE];
+	static char s_aUnpacked[CSnapshot::MAX_SIZE];
+	for(size_t To = 1; To < vSnapshots.size(); To++)
+	{
+		// the usual one tick back and an old base like after loss
+		for(size_t From : {To - 1, To > 30 ? To - 30 : (size_t)0})
+		{
+			CSnapshot *pFrom = (CSnapshot *)vSnapshots[From].data();
+			CSnapshot *pTo = (CSnapshot *)vSnapshots[To].data();
+
+			const int Size = Delta.CreateDelta(pFrom, pTo, s_aDelta);
+			const int ReferenceSize = ReferenceDelta(pFrom, pTo, s_aReference, s_aStaticSizes);
+			ASSERT_EQ(Size, ReferenceSize) << From << " -> " << To;
+			ASSERT_EQ(mem_comp(s_aDelta, s_aReference, Size), 0) << From << " -> " << To;
+
+			if(!Crowded && Size)
+			{
+				const int UnpackedSize = Delta.UnpackDelta(pFrom, (CSnapshot *)s_aUnpacked, s_aDelta, Size);
+				ASSERT_GE(UnpackedSize, 0);
+				CSnapshot *pUnpacked = (CSnapshot *)s_aUnpacked;
+				ASSERT_EQ(pUnpacked->NumItems(), pTo->NumItems());
+				EXPECT_EQ(pUnpacked->Crc(), pTo->Crc()) << From << " -> " << To;
+			}
+		}
+	}
+}
+
+TEST(SnapshotDelta, SameAsReference)
+{
+	TestSameAsReference(false);
+}
+
+TEST(SnapshotDelta, SameAsReferenceCrowded)
+{
+	TestSameAsReference(true);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <engine/shared/spsc_queue.h>
+
+#include <thread>
+
+TEST(SpscQueue, FullAndEmpty)
+{
+	CSpscQueue<int, 4> Queue;
+	EXPECT_TRUE(Queue.Empty());
+	EXPECT_EQ(Queue.Front(), nullptr);
+
+	for(int i = 0; i < 4; i++)
+	{
+		int *pItem = Queue.BeginPush();
+		ASSERT_NE(pItem, nullptr);
+		*pItem = i;
+		Queue.EndPush();
+	}
+	EXPECT_EQ(Queue.BeginPush(), nullptr);
+
+	for(int i = 0; i < 4; i++)
+	{
+		ASSERT_NE(Queue.Front(), nullptr);
+		EXPECT_EQ(*Queue.Front(), i);
+		Queue.Pop();
+	}
+	EXPECT_TRUE(Queue.Empty());
+}
+
+TEST(SpscQueue, Threads)
+{
+	static CSpscQueue<int, 64> s_Queue;
+	const int NUM = 200000;
+
+	std::thread Producer([]() {
+		for(int i = 0; i < NUM; i++)
+		{
+			int *pItem;
+			while(!(pItem = s_Queue.BeginPush()))
+				std::this_thread::yield();
+			*pItem = i;
+			s_Queue.EndPush();
+		}
+	});
+
+	// everything arrives once and in order, checked after the producer is done
+	int Expected = 0;
+	int FirstWrong = -1;
+	int WrongItem = 0;
+	while(Expected < NUM)
+	{
+		int *pItem = s_Queue.Front();
+		if(!pItem)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		if(*pItem != Expected && FirstWrong == -1)
+		{
+			FirstWrong = Expected;
+			WrongItem = *pItem;
+		}
+		s_Queue.Pop();
+		Expected++;
+	}
+	Producer.join();
+	EXPECT_EQ(FirstWrong, -1) << "got " << WrongItem << " instead";
+	EXPECT_TRUE(s_Queue.Empty());
+}
@@ -0,0 +1,415 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/server/sql_connect_pool.h>
+#include <engine/shared/config.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+
+// Without TEST_SQL_HOST the pool tests run on SQLite. To test MySQL/MariaDB, start a server, e.g.
+// `docker run -e MARIADB_ROOT_PASSWORD=root -e MARIADB_DATABASE=2xp -p 3306:3306 mariadb`
+// and `TEST_SQL_HOST=tcp://127.0.0.1:3306 ./testrunner --gtest_filter=SqlPool.*`
+static const int TEST_POOL_SIZE = 4;
+
+static char s_aSqliteFile[64];
+
+static void RemoveSqliteFile()
+{
+	char aBuf[128];
+	fs_remove(s_aSqliteFile);
+	str_format(aBuf, sizeof(aBuf), "%s-wal", s_aSqliteFile);
+	fs_remove(aBuf);
+	str_format(aBuf, sizeof(aBuf), "%s-shm", s_aSqliteFile);
+	fs_remove(aBuf);
+}
+
+static bool ConfigureTestDatabase()
+{
+	g_Config.m_SvMySqlPoolSize = TEST_POOL_SIZE;
+	g_Config.m_SvMySqlQueueSize = 512;
+	g_Config.m_SvMySqlQueueOverflow = CConnectionPool::OVERFLOW_WAIT;
+
+	const char *pHost = getenv("TEST_SQL_HOST");
+	if(!pHost)
+	{
+		// the pool is created once per process, so all tests share the file
+		if(!s_aSqliteFile[0])
+		{
+			str_format(s_aSqliteFile, sizeof(s_aSqliteFile), "SqlPool-%d.tmp.sqlite", pid());
+			atexit(RemoveSqliteFile);
+		}
+		str_copy(g_Config.m_SvSqlBackend, "sqlite", sizeof(g_Config.m_SvSqlBackend));
+		str_copy(g_Config.m_SvSqliteFile, s_aSqliteFile, sizeof(g_Config.m_SvSqliteFile));
+		std::unique_ptr<ISqlBackend> pBackend(CreateSqliteBackend());
+		return pBackend != nullptr;
+	}
+
+	const char *pLogin = getenv("TEST_SQL_LOGIN");
+	const char *pPassword = getenv("TEST_SQL_PASSWORD");
+	const char *pDatabase = getenv("TEST_SQL_DATABASE");
+	str_copy(g_Config.m_SvMySqlHost, pHost, sizeof(g_Config.m_SvMySqlHost));
+	str_copy(g_Config.m_SvMySqlLogin, pLogin ? pLogin : "root", sizeof(g_Config.m_SvMySqlLogin));
+	str_copy(g_Config.m_SvMySqlPassword, pPassword ? pPassword : "root", sizeof(g_Config.m_SvMySqlPassword));
+	str_copy(g_Config.m_SvMySqlDatabase, pDatabase ? pDatabase : "2xp", sizeof(g_Config.m_SvMySqlDatabase));
+	str_copy(g_Config.m_SvSqlBackend, "mysql", sizeof(g_Config.m_SvSqlBackend));
+
+	// queries fail while the database is unreachable, make sure it will connect at all
+	try
+	{
+		std::unique_ptr<ISqlBackend> pBackend(CreateMySqlBackend());
+		std::unique_ptr<ISqlConnection> pConnection(pBackend->Connect());
+	}
+	catch(SQLException &)
+	{
+		return false;
+	}
+	return true;
+}
+
+// the configured backend, every query waits until TEST_POOL_SIZE of them are running at once
+class CBarrierBackend : public ISqlBackend
+{
+	class CConnection : public ISqlConnection
+	{
+		CBarrierBackend *m_pBackend;
+		std::unique_ptr<ISqlConnection> m_pConnection;
+
+	public:
+		CConnection(CBarrierBackend *pBackend, ISqlConnection *pConnection) :
+			m_pBackend(pBackend), m_pConnection(pConnection) {}
+
+		bool IsClosed() override { return m_pConnection->IsClosed(); }
+		void Ping() override { m_pConnection->Ping(); }
+		void Execute(const std::string &Query, ResultPtr *pResult) override { m_pConnection->Execute(Query, pResult); }
+		void ExecutePrepared(const std::string &Query, const SqlValues &vValues, ResultPtr *pResult) override
+		{
+			m_pBackend->Wait();
+			m_pConnection->ExecutePrepared(Query, vValues, pResult);
+		}
+	};
+
+	std::unique_ptr<ISqlBackend> m_pBackend;
+	std::mutex m_Lock;
+	std::condition_variable m_AllIn;
+
+public:
+	int m_InFlight;
+	int m_MaxInFlight;
+
+	CBarrierBackend() :
+		m_pBackend(str_comp(g_Config.m_SvSqlBackend, "sqlite") ? CreateMySqlBackend() : CreateSqliteBackend()), m_InFlight(0), m_MaxInFlight(0) {}
+
+	void Wait()
+	{
+		// a global query lock would keep every query waiting here alone until the timeout
+		std::unique_lock<std::mutex> Lock(m_Lock);
+		m_MaxInFlight = maximum(m_MaxInFlight, ++m_InFlight);
+		m_AllIn.notify_all();
+		m_AllIn.wait_for(Lock, std::chrono::seconds(5), [this]() { return m_MaxInFlight >= TEST_POOL_SIZE; });
+		m_InFlight--;
+	}
+
+	const char *Name() const override { return "barrier"; }
+	ISqlConnection *Connect() override { return new CConnection(this, m_pBackend->Connect()); }
+	void ThreadInit() override { m_pBackend->ThreadInit(); }
+	void ThreadEnd() override { m_pBackend->ThreadEnd(); }
+};
+
+TEST(SqlPool, ParallelConnections)
+{
+	if(!ConfigureTestDatabase())
+		GTEST_SKIP() << "the database is unreachable";
+
+	CBarrierBackend *pBackend = new CBarrierBackend();
+	{
+		CConnectionPool Pool(pBackend);
+		std::atomic<int> Done(0);
+		for(int i = 0; i < TEST_POOL_SIZE; i++)
+			Pool.PreparedSelect([&Done](ResultPtr pResult) { Done++; }, "SELECT ?;", i);
+
+		const int64 Timeout = time_get() + time_freq() * 30;
+		while(Done.load() < TEST_POOL_SIZE && time_get() < Timeout)
+			thread_sleep(1000);
+		ASSERT_EQ(Done.load(), TEST_POOL_SIZE);
+
+		// every connection of the pool ran a query at the same time
+		EXPECT_EQ(pBackend->m_MaxInFlight, TEST_POOL_SIZE);
+	}
+}
+
+TEST(SqlPool, PreparedStatements)
+{
+	if(!ConfigureTestDatabase())
+		GTEST_SKIP() << "the database is unreachable";
+
+	const char aData[] = {'\0', '\1', '\xff', 'x'};
+	int Rows = 0;
+
+	for(int i = 0; i < 3; i++)
+	{
+		// the same query text reuses the cached statement with new parameters
+		SJK.PreparedSelectSync([&](ResultPtr pResult) {
+			ASSERT_TRUE(pResult);
+			ASSERT_TRUE(pResult->next());
+			EXPECT_EQ(pResult->getInt(1), i);
+			EXPECT_EQ(pResult->getInt64(2), (int64)i << 40);
+			EXPECT_STREQ(pResult->getString(3).c_str(), "it's \"quoted\"");
+			std::string Blob(std::istreambuf_iterator<char>(*pResult->getBlob(4)), std::istreambuf_iterator<char>());
+			EXPECT_EQ(Blob, std::string(aData, sizeof(aData)));
+			Rows++;
+		}, "SELECT ?, ?, ?, ?;", i, (int64)i << 40, "it's \"quoted\"", SqlBlob(aData, sizeof(aData)));
+	}
+	EXPECT_EQ(Rows, 3);
+}
+
+TEST(SqlPool, WriteBehind)
+{
+	if(!ConfigureTestDatabase())
+		GTEST_SKIP() << "the database is unreachable";
+
+	g_Config.m_SvMySqlFlushInterval = 60000;
+	g_Config.m_SvMySqlFlushSize = 8192;
+	ASSERT_TRUE(SJK.PreparedUpdateSync("CREATE TABLE IF NOT EXISTS test_write_behind (id INT PRIMARY KEY, a INT, b VARCHAR(16));"));
+	ASSERT_TRUE(SJK.PreparedUpdateSync("DELETE FROM test_write_behind;"));
+
+	// 3 inserts and 101 updates end up as one INSERT and three UPDATEs
+	for(int i = 0; i < 3; i++)
+		SJK.BufferInsert("test_write_behind", "id, a, b", i, 0, "new");
+	for(int i = 0; i < 100; i++)
+		SJK.BufferUpdate("test_write_behind", "id", i % 3, "a", i);
+	SJK.BufferUpdate("test_write_behind", "id", 1, "b", "changed");
+	CConnectionPool::FlushWrites(true);
+
+	// the batch runs on a worker, wait until the last update of it arrived
+	const int aLastValue[] = {99, 97, 98};
+	const int64 Timeout = time_get() + time_freq() * 10;
+	int Rows = 0;
+	while(Rows != 3 && time_get() < Timeout)
+	{
+		thread_sleep(1000);
+		Rows = 0;
+		SJK.PreparedSelectSync([&](ResultPtr pResult) {
+			ASSERT_TRUE(pResult);
+			while(pResult->next())
+			{
+				const int ID = pResult->getInt(1);
+				if(pResult->getInt(2) == aLastValue[ID] && pResult->getString(3) == (ID == 1 ? "changed" : "new"))
+					Rows++;
+			}
+		}, "SELECT id, a, b FROM test_write_behind ORDER BY id;");
+	}
+	EXPECT_EQ(Rows, 3);
+	SJK.PreparedUpdateSync("DROP TABLE test_write_behind;");
+}
+
+TEST(SqlPool, DelayedQueries)
+{
+	if(!ConfigureTestDatabase())
+		GTEST_SKIP() << "the database is unreachable";
+
+	ASSERT_TRUE(SJK.PreparedUpdateSync("CREATE TABLE IF NOT EXISTS test_delayed (id INT PRIMARY KEY, a INT, b INT, c VARCHAR(32));"));
+	ASSERT_TRUE(SJK.PreparedUpdateSync("DELETE FROM test_delayed;"));
+	ASSERT_TRUE(SJK.PreparedUpdateSync("INSERT INTO test_delayed (id, a, b, c) VALUES (1, 0, 0, ''), (2, 0, 0, ''), (3, 0, 0, ''), (4, 0, 0, '');"));
+
+	// updates of the same row are merged into the first one, the last value of a column wins,
+	// cancelling one only takes back its own values
+	const int64 First = SJK.UDS(50, "test_delayed", "a = '1' WHERE id = '1'");
+	const int64 Second = SJK.UDS(5000, "test_delayed", "a = '2', b = 5 WHERE id = '1'");
+	const int64 Third = SJK.UDS(50, "test_delayed", "a = '3', c = 'it''s WHERE id = 2' WHERE id = '1'");
+	EXPECT_NE(First, 0);
+	EXPECT_NE(Second, First);
+	EXPECT_NE(Third, Second);
+	EXPECT_TRUE(SJK.CancelDelayed(Third));
+	EXPECT_FALSE(SJK.CancelDelayed(Third));
+	SJK.UDS(60, "test_delayed", "c = 'x WHERE id = 4' WHERE id = '1'");
+
+	// relative updates are never merged, every one of them counts
+	SJK.UDS(50, "test_delayed", "a = a + 1 WHERE id = '2'");
+	SJK.UDS(50, "test_delayed", "a = a + 1 WHERE id = '2'");
+	SJK.UDS(50, "test_delayed", "b = 7 WHERE id = '2'");
+
+	// cancelled queries never run
+	const int64 Cancelled = SJK.UDS(50, "test_delayed", "a = '7' WHERE id = '3'");
+	EXPECT_TRUE(SJK.CancelDelayed(Cancelled));
+	EXPECT_FALSE(SJK.CancelDelayed(Cancelled));
+	EXPECT_TRUE(SJK.CancelDelayed(SJK.DDS(50, "test_delayed", "WHERE id = '3'")));
+
+	// a UD sends the pending UDS along first
+	SJK.UDS(5000, "test_delayed", "a = 8, b = 9 WHERE id = '4'");
+	SJK.UD("test_delayed", "a = 10 WHERE id = '4'");
+
+	const int64 Timeout = time_get() + time_freq() * 10;
+	int Rows = 0;
+	while(Rows != 4 && time_get() < Timeout)
+	{
+		thread_sleep(1000);
+		Rows = 0;
+		SJK.PreparedSelectSync([&](ResultPtr pResult) {
+			ASSERT_TRUE(pResult);
+			while(pResult->next())
+			{
+				const int ID = pResult->getInt(1);
+				const int A = pResult->getInt(2), B = pResult->getInt(3);
+				const std::string C = pResult->getString(4).c_str();
+				if(ID == 1 && A == 2 && B == 5 && C == "x WHERE id = 4")
+					Rows++;
+				else if(ID == 2 && A == 2 && B == 7)
+					Rows++;
+				else if(ID == 3 && A == 0)
+					Rows++;
+				else if(ID == 4 && A == 10 && B == 9 && C.empty())
+					Rows++;
+			}
+		}, "SELECT id, a, b, c FROM test_delayed ORDER BY id;");
+	}
+	EXPECT_EQ(Rows, 4);
+	// the merged update ran after 50ms, not 5s
+	EXPECT_LT(time_get(), Timeout - time_freq() * 5);
+	EXPECT_FALSE(SJK.CancelDelayed(First));
+	EXPECT_FALSE(SJK.CancelDelayed(Second));
+	SJK.PreparedUpdateSync("DROP TABLE test_delayed;");
+}
+
+// SQLite that can be switched off, it fails like MySQL does
+class CFlakyBackend : public ISqlBackend
+{
+	class CConnection : public ISqlConnection
+	{
+		CFlakyBackend *m_pBackend;
+		std::unique_ptr<ISqlConnection> m_pConnection;
+
+		void Check()
+		{
+			if(m_pBackend->m_Down)
+				throw SQLException("server has gone away");
+		}
+
+	public:
+		CConnection(CFlakyBackend *pBackend, ISqlConnection *pConnection) :
+			m_pBackend(pBackend), m_pConnection(pConnection) {}
+
+		bool IsClosed() override { return m_pBackend->m_Down; }
+		void Ping() override
+		{
+			m_pBackend->m_NumPings++;
+			Check();
+			m_pConnection->Ping();
+		}
+		void Execute(const std::string &Query, ResultPtr *pResult) override
+		{
+			Check();
+			if(!pResult && !str_comp_nocase_num(Query.c_str(), "SELECT", 6))
+				throw SQLException("Statement returning result set");
+			m_pConnection->Execute(Query, pResult);
+		}
+		void ExecutePrepared(const std::string &Query, const SqlValues &vValues, ResultPtr *pResult) override
+		{
+			Check();
+			m_pConnection->ExecutePrepared(Query, vValues, pResult);
+		}
+	};
+
+public:
+	std::unique_ptr<ISqlBackend> m_pSqlite;
+	std::atomic<bool> m_Down;
+	std::atomic<int> m_NumPings;
+
+	CFlakyBackend() :
+		m_pSqlite(CreateSqliteBackend()), m_Down(true), m_NumPings(0) {}
+
+	const char *Name() const override { return "flaky"; }
+	ISqlConnection *Connect() override
+	{
+		if(m_Down)
+			throw SQLException("can't connect");
+		return new CConnection(this, m_pSqlite->Connect());
+	}
+};
+
+static bool HasTestRow(int ID)
+{
+	bool Found = false;
+	SJK.PreparedSelectSync([&Found](ResultPtr pResult) { Found = pResult && pResult->next(); }, "SELECT a FROM test_recovery WHERE id = ?;", ID);
+	return Found;
+}
+
+static bool WaitForTestRow(int ID)
+{
+	const int64 Timeout = time_get() + time_freq() * 10;
+	while(!HasTestRow(ID) && time_get() < Timeout)
+		thread_sleep(10000);
+	return HasTestRow(ID);
+}
+
+TEST(SqlPool, Recovery)
+{
+	if(!ConfigureTestDatabase())
+		GTEST_SKIP() << "the database is unreachable";
+	if(str_comp(g_Config.m_SvSqlBackend, "sqlite"))
+		GTEST_SKIP() << "outages are simulated on SQLite";
+
+	ASSERT_TRUE(SJK.PreparedUpdateSync("CREATE TABLE IF NOT EXISTS test_recovery (id INT PRIMARY KEY, a INT);"));
+	ASSERT_TRUE(SJK.PreparedUpdateSync("DELETE FROM test_recovery;"));
+
+	const int Keepalive = g_Config.m_SvMySqlKeepalive;
+	g_Config.m_SvMySqlKeepalive = 1;
+	{
+		CFlakyBackend *pBackend = new CFlakyBackend();
+		CConnectionPool Pool(pBackend);
+
+		// the database is down from the start, queries are held back
+		Pool.ID("test_recovery", "(id, a) VALUES (1, 1)");
+		thread_sleep(300000);
+		EXPECT_FALSE(HasTestRow(1));
+
+		// and run once it is back
+		pBackend->m_Down = false;
+		EXPECT_TRUE(WaitForTestRow(1));
+
+		// the keepalive pings the idle connections without breaking them
+		const int64 Timeout = time_get() + time_freq() * 10;
+		while(pBackend->m_NumPings < TEST_POOL_SIZE && time_get() < Timeout)
+			thread_sleep(10000);
+		EXPECT_GE(pBackend->m_NumPings.load(), TEST_POOL_SIZE);
+		Pool.ID("test_recovery", "(id, a) VALUES (2, 2)");
+		EXPECT_TRUE(WaitForTestRow(2));
+
+		// a failed ping drops the connection, the recovery thread finds the database down
+		pBackend->m_Down = true;
+		const int NumPings = pBackend->m_NumPings;
+		while(pBackend->m_NumPings == NumPings && time_get() < Timeout + time_freq() * 5)
+			thread_sleep(10000);
+		EXPECT_GT(pBackend->m_NumPings.load(), NumPings);
+		thread_sleep(200000);
+		Pool.ID("test_recovery", "(id, a) VALUES (3, 3)");
+		thread_sleep(300000);
+		EXPECT_FALSE(HasTestRow(3));
+
+		pBackend->m_Down = false;
+		EXPECT_TRUE(WaitForTestRow(3));
+	}
+	g_Config.m_SvMySqlKeepalive = Keepalive;
+	SJK.PreparedUpdateSync("DROP TABLE test_recovery;");
+}
+
+TEST(SqlPool, Stats)
+{
+	if(!ConfigureTestDatabase())
+		GTEST_SKIP() << "the database is unreachable";
+
+	for(int i = 0; i < 5; i++)
+		SJK.PreparedSelectSync([](ResultPtr pResult) {}, "SELECT ?;", i);
+
+	std::vector<std::string> vLines;
+	CConnectionPool::PrintStats([&vLines](const char *pLine) { vLines.emplace_back(pLine); });
+
+	ASSERT_EQ(vLines.size(), 6u);
+	EXPECT_EQ(vLines[0].find("backend="), 0u);
+	EXPECT_EQ(vLines[1].find("select: errors=0 n="), 0u);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <base/math.h>
+#include <base/system.h>
+#include <engine/shared/timer_wheel.h>
+
+#include <map>
+#include <vector>
+
+static void RunTimers(std::vector<CTimerWheel::FTimer> &vDue)
+{
+	for(auto &Func : vDue)
+		Func();
+	vDue.clear();
+}
+
+TEST(TimerWheel, FiresWhenDue)
+{
+	CTimerWheel Wheel(1000);
+	std::vector<CTimerWheel::FTimer> vDue;
+	std::vector<int64> vFired;
+
+	// one per level and a few on the level boundaries
+	const int64 aDelays[] = {0, 1, 5, 255, 256, 257, 1000, 16383, 16384, 20000, 1 << 20, (1 << 20) + 3};
+	for(int64 Delay : aDelays)
+		Wheel.Add(1000 + Delay, [&vFired, &Wheel]() { vFired.push_back(Wheel.Now()); });
+	EXPECT_EQ(Wheel.Num(), (int)(sizeof(aDelays) / sizeof(aDelays[0])));
+
+	// single steps, so every timer is seen on the tick it is due
+	for(int64 Now = 1000; Now <= 1000 + (1 << 20) + 3; Now++)
+	{
+		Wheel.Advance(Now, vDue);
+		RunTimers(vDue);
+	}
+	Wheel.Advance(1000 + (1 << 20) + 10, vDue);
+	RunTimers(vDue);
+
+	ASSERT_EQ(vFired.size(), sizeof(aDelays) / sizeof(aDelays[0]));
+	for(size_t i = 0; i < vFired.size(); i++)
+	{
+		// a timer that is due now fires on the next tick, the others exactly when due
+		const int64 Due = 1000 + maximum(aDelays[i], (int64)1);
+		EXPECT_EQ(vFired[i], Due) << "delay " << aDelays[i];
+	}
+	EXPECT_EQ(Wheel.Num(), 0);
+}
+
+TEST(TimerWheel, Order)
+{
+	CTimerWheel Wheel;
+	std::vector<CTimerWheel::FTimer> vDue;
+	std::multimap<int64, int> Expected;
+	std::vector<int> vFired;
+
+	unsigned Seed = 1;
+	for(int i = 0; i < 2000; i++)
+	{
+		Seed = Seed * 1103515245 + 12345;
+		const int64 Due = (Seed >> 8) % 100000;
+		Expected.emplace(maximum(Due, (int64)1), i);
+		Wheel.Add(Due, [&vFired, i]() { vFired.push_back(i); });
+	}
+
+	// one big jump fires everything in due order
+	Wheel.Advance(100000, vDue);
+	RunTimers(vDue);
+
+	ASSERT_EQ(vFired.size(), Expected.size());
+	size_t i = 0;
+	for(auto It = Expected.begin(); It != Expected.end(); ++It, ++i)
+	{
+		// timers that are due on the same tick keep the order they were added in
+		EXPECT_EQ(vFired[i], It->second);
+	}
+}
+
+TEST(TimerWheel, Cancel)
+{
+	CTimerWheel Wheel;
+	std::vector<CTimerWheel::FTimer> vDue;
+	int Fired = 0;
+
+	const int64 Near = Wheel.Add(10, [&Fired]() { Fired += 1; });
+	const int64 Far = Wheel.Add(50000, [&Fired]() { Fired += 10; });
+	Wheel.Add(20, [&Fired]() { Fired += 100; });
+
+	EXPECT_TRUE(Wheel.Cancel(Near));
+	EXPECT_FALSE(Wheel.Cancel(Near));
+	EXPECT_TRUE(Wheel.Cancel(Far));
+	EXPECT_EQ(Wheel.Num(), 1);
+
+	Wheel.Advance(60000, vDue);
+	RunTimers(vDue);
+	EXPECT_EQ(Fired, 100);
+	EXPECT_EQ(Wheel.Num(), 0);
+}
+
+TEST(TimerWheel, BeyondMaxDelay)
+{
+	CTimerWheel Wheel;
+	std::vector<CTimerWheel::FTimer> vDue;
+	bool Fired = false;
+
+	const int64 Due = (int64)CTimerWheel::MAX_DELAY + 17;
+	Wheel.Add(Due, [&Fired]() { Fired = true; });
+
+	Wheel.Advance(Due - 1, vDue);
+	EXPECT_TRUE(vDue.empty());
+	Wheel.Advance(Due, vDue);
+	RunTimers(vDue);
+	EXPECT_TRUE(Fired);
+}
+
+TEST(TimerWheel, TakeAll)
+{
+	CTimerWheel Wheel;
+	std::vector<CTimerWheel::FTimer> vDue;
+	std::vector<int> vFired;
+
+	Wheel.Add(300, [&vFired]() { vFired.push_back(2); });
+	Wheel.Add(5, [&vFired]() { vFired.push_back(1); });
+	Wheel.Add(70000, [&vFired]() { vFired.push_back(3); });
+
+	Wheel.TakeAll(vDue);
+	RunTimers(vDue);
+	EXPECT_EQ(vFired, std::vector<int>({1, 2, 3}));
+	EXPECT_EQ(Wheel.Num(), 0);
+
+	// nothing left in the slots either
+	Wheel.Advance(100000, vDue);
+	EXPECT_TRUE(vDue.empty());
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <base/system.h>
+
+#include <vector>
+
+static NETSOCKET OpenLoopback(NETADDR *pAddr)
+{
+	// the first free port
+	net_addr_from_str(pAddr, "127.0.0.1");
+	for(int Port = 28300; Port < 28400; Port++)
+	{
+		pAddr->port = Port;
+		NETSOCKET Socket = net_udp_create(*pAddr);
+		if(Socket.type)
+			return Socket;
+	}
+	NETSOCKET Invalid = {};
+	return Invalid;
+}
+
+static int RecvAll(NETSOCKET Socket, MMSGS *pMMSGS, std::vector<int> *pvReceived)
+{
+	unsigned char aBuffer[PACKETSIZE];
+	int Num = 0;
+	while(net_socket_read_wait(Socket, 100000) > 0)
+	{
+		NETADDR From;
+		unsigned char *pData;
+		int Bytes;
+		while((Bytes = net_udp_recv(Socket, &From, aBuffer, sizeof(aBuffer), pMMSGS, &pData)) > 0)
+		{
+			int Value;
+			mem_copy(&Value, pData, sizeof(Value));
+			EXPECT_EQ(Bytes, 100 + Value % 50);
+			pvReceived->push_back(Value);
+			Num++;
+		}
+	}
+	return Num;
+}
+
+TEST(Udp, SendQueue)
+{
+	net_init();
+	NETADDR SenderAddr, ReceiverAddr;
+	NETSOCKET Sender = OpenLoopback(&SenderAddr);
+	NETSOCKET Receiver = OpenLoopback(&ReceiverAddr);
+	ASSERT_TRUE(Sender.type && Receiver.type);
+	static MMSGS s_MMSGS;
+	net_init_mmsgs(&s_MMSGS);
+
+	static NETSENDQUEUE s_Queue;
+	net_udp_set_send_queue(&Sender, &s_Queue);
+
+	// more than fit in the queue, so it flushes once on its own
+	unsigned char aPacket[PACKETSIZE] = {0};
+	for(int i = 0; i < VLEN + 20; i++)
+	{
+		mem_copy(aPacket, &i, sizeof(i));
+		EXPECT_EQ(net_udp_send(Sender, &ReceiverAddr, aPacket, 100 + i % 50), 100 + i % 50);
+	}
+
+	std::vector<int> vReceived;
+#if defined(CONF_PLATFORM_LINUX)
+	EXPECT_EQ(RecvAll(Receiver, &s_MMSGS, &vReceived), VLEN);
+	EXPECT_EQ(net_udp_flush(Sender), 20);
+#endif
+	RecvAll(Receiver, &s_MMSGS, &vReceived);
+
+	ASSERT_EQ(vReceived.size(), (size_t)VLEN + 20);
+	for(int i = 0; i < VLEN + 20; i++)
+		EXPECT_EQ(vReceived[i], i);
+	EXPECT_EQ(net_udp_flush(Sender), 0);
+
+	net_udp_close(Sender);
+	net_udp_close(Receiver);
+}